@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "bamstream.h"
+#include "trace.h"
+#include "memtrack.h"
+
+static bamstream_st bs;
+
+static const uint32_t LIN_UNSET=0xffffffff;
+
+//! end of the alignment as used by the BAM index
+static inline uint32_t record_end(const bam1_core_t& c, const uint32_t *cigar)
+{
+  return c.n_cigar ? bam_calend(&c, cigar) : c.pos+1;
+}
+
+//! copy b to the store without name and tags, update the linear index
+static void bamstream_add(const bam1_t *b)
+{
+  int l_qname= msc::dumpBam ? b->core.l_qname : 0;
+  int32_t len= msc::dumpBam ? b->data_len : b->data_len-b->core.l_qname-b->l_aux;
+  size_t off=bs.data.size();
+  size_t rec=( sizeof(bam1_core_t)+sizeof(int32_t)+len+7 ) & ~(size_t)7;
+  bs.data.resize(off+rec);
+
+  bam1_core_t c=b->core;
+  c.l_qname=l_qname;
+  memcpy(&bs.data[off], &c, sizeof(bam1_core_t));
+  memcpy(&bs.data[off]+sizeof(bam1_core_t), &len, sizeof(int32_t));
+  memcpy(&bs.data[off]+sizeof(bam1_core_t)+sizeof(int32_t),
+	 b->data+b->core.l_qname-l_qname, len);
+
+  uint32_t idx=bs.offset.size();
+  bs.offset.push_back(off);
+
+  uint32_t w0=(uint32_t)c.pos >> BAMSTREAM_LINEAR_SHIFT;
+  uint32_t w1=( record_end(c, bam1_cigar(b))-1 ) >> BAMSTREAM_LINEAR_SHIFT;
+  if ( w1>=bs.lin.size() ) bs.lin.resize(w1+1, LIN_UNSET);
+  for(uint32_t w=w0; w<=w1; ++w)
+    if ( bs.lin[w]==LIN_UNSET ) bs.lin[w]=idx;
+  return;
+}
+
+void bamstream_clear()
+{
+  vector<uint8_t>().swap(bs.data);
+  vector<size_t>().swap(bs.offset);
+  vector<uint32_t>().swap(bs.lin);
+  bs.tid=-1;
+  mem_set(MEM_STREAM, 0);
+  return;
+}
+
+//! read the records of target ref
+static void bamstream_read(int ref)
+{
+  bamstream_clear();
+  bs.tid=ref;
+  if ( bs.next==NULL ) bs.next=bam_init1();
+
+  int last_tid=-1, last_pos=-1;
+  while ( !bs.eof ) {
+    if ( !bs.has_next ) {
+      if ( bam_read1(msc::fp_in->x.bam, bs.next)<0 ) { bs.eof=true; break; }
+      bs.has_next=true;
+      ++bs.nread;
+    }
+    const bam1_core_t& c=bs.next->core;
+    // unmapped reads without a position are at the end
+    if ( c.tid<0 ) { bs.eof=true; break; }
+    if ( c.tid<last_tid || (c.tid==last_tid && c.pos<last_pos) ) {
+      cerr << msc::bamFile << " is not sorted by coordinate at "
+	   << msc::bam_target_name[c.tid] << ":" << c.pos+1 << endl;
+      exit(0);
+    }
+    last_tid=c.tid;
+    last_pos=c.pos;
+    if ( c.tid>ref ) break;
+    if ( c.tid==ref ) bamstream_add(bs.next);
+    bs.has_next=false;
+    if ( bs.nread%1000000==0 )
+      cerr << "#streamed " << commify(bs.nread) << " reads at pos "
+	   << msc::bam_target_name[c.tid] << "@" << commify(c.pos) << endl;
+  }
+
+  // windows nothing ends in point to the next record that does
+  uint32_t n=bs.size();
+  for(size_t w=bs.lin.size(); w>0; --w) {
+    if ( bs.lin[w-1]==LIN_UNSET ) bs.lin[w-1]=n;
+    n=bs.lin[w-1];
+  }
+
+  cerr << "streamed " << commify(bs.size()) << " reads on "
+       << msc::bam_target_name[ref] << ", "
+       << commify(bs.data.size()>>20) << " MB" << endl;
+  mem_set(MEM_STREAM, bs.totalRAM());
+  return;
+}
+
+bool bamstream_load(int ref, int beg, int end)
+{
+  if ( ref<bs.tid ) {
+    cerr << "regions must follow the order of the stream, "
+	 << msc::bam_target_name[ref] << " was already passed" << endl;
+    return false;
+  }
+  if ( ref>bs.tid ) bamstream_read(ref);
+  
+  bam1_t *b=bam_init1();
+  region_iter_t iter=region_query(ref, beg, end);
+  bool have_reads= region_read(iter, b)>0;
+  region_destroy(iter);
+  bam_destroy1(b);
+  return have_reads;
+}
+
+region_iter_t region_query(int ref, int beg, int end)
+{
+  region_iter_t iter=new region_iter_st;
+  iter->iter=0;
+  iter->tid=ref;
+  iter->beg= beg<0 ? 0 : beg;
+  iter->end=end;
+  iter->i=bs.size();
+  iter->t0= trace_on() ? wall_time() : 0;
+  iter->nread=0;
+  if ( !msc::bamStream ) {
+    iter->iter=bam_iter_query(msc::bamidx, ref, beg, end);
+    return iter;
+  }
+  if ( ref!=bs.tid || end<iter->beg ) return iter;
+  size_t w=(size_t)iter->beg >> BAMSTREAM_LINEAR_SHIFT;
+  if ( w<bs.lin.size() ) iter->i=bs.lin[w];
+  return iter;
+}
+
+int region_read(region_iter_t iter, bam1_t *b)
+{
+  if ( !msc::bamStream ) {
+    int r=bam_iter_read(msc::fp_in->x.bam, iter->iter, b);
+    iter->nread+= r>0;
+    return r;
+  }
+
+  while ( iter->i<bs.size() ) {
+    size_t i=iter->i++;
+    const bam1_core_t& c=bs.core(i);
+    if ( c.pos>=iter->end ) {
+      iter->i=bs.size();
+      break;
+    }
+    const uint8_t *rec=bs.record(i);
+    uint32_t rend=record_end(c, (const uint32_t*)(rec+c.l_qname));
+    if ( rend<=(uint32_t)iter->beg ) continue;
+
+    int32_t len=bs.data_len(i);
+    b->core=c;
+    b->data_len=len;
+    if ( b->m_data<len ) {
+      b->m_data=len;
+      kroundup32(b->m_data);
+      b->data=(uint8_t*)realloc(b->data, b->m_data);
+    }
+    memcpy(b->data, rec, len);
+    b->l_aux=len-c.n_cigar*4-c.l_qname-c.l_qseq-(c.l_qseq+1)/2;
+    ++iter->nread;
+    return 4+sizeof(bam1_core_t)+len;
+  }
+  return -1;
+}
+
+void region_destroy(region_iter_t iter)
+{
+  if ( iter==NULL ) return;
+  if ( trace_on() && iter->tid>=0 && iter->tid<(int)msc::bam_target_name.size() )
+    trace_span("bam query", "io", iter->t0, wall_time(),
+	       msc::bam_target_name[iter->tid]+":"+to_string(iter->beg+1)+"-"+
+	       to_string(iter->end)+" "+to_string(iter->nread)+" reads");
+  if ( iter->iter ) bam_iter_destroy(iter->iter);
+  delete iter;
+  return;
+}
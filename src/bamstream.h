@@ -0,0 +1,92 @@
+#ifndef _BAMSTREAM_H
+#define _BAMSTREAM_H
+
+using namespace std;
+#include <vector>
+#include <inttypes.h>
+#include <bam.h>
+
+//! "-b -" reads a coordinate sorted BAM from stdin
+#define BAMSTREAM_STDIN "-"
+//! width of a window of the linear index, as in the BAM index
+#define BAMSTREAM_LINEAR_SHIFT 14
+
+/*!
+  @abstract  alignments of one target kept in memory while it is processed
+
+  a BAM read from a pipe has no index, so the records of the current
+  target are gathered in a single pass and queried from memory, the whole
+  target at once: memory grows with the largest contig and is counted as
+  MEM_STREAM against -M.  names and tags are dropped, except with -dump.  records keep the order of the
+  stream and lin[w] is the first record ending after window w, so a query
+  returns the same records in the same order as the BAM index.
+
+  @field  tid     target of the records, -1 before the first load
+  @field  data    bam1_core_t and data of each record
+  @field  offset  start of each record in data
+  @field  lin     linear index, first record ending after each window
+  @field  next    first record of a later target, read ahead
+  @field  nread   records read from the stream
+*/
+struct bamstream_st {
+  int tid;
+  vector<uint8_t> data;
+  vector<size_t> offset;
+  vector<uint32_t> lin;
+  bam1_t *next;
+  bool has_next;
+  bool eof;
+  size_t nread;
+
+  bamstream_st(): tid(-1), next(NULL), has_next(false), eof(false), nread(0) {};
+  size_t size() const { return offset.size(); }
+  size_t totalRAM() const {
+    return data.capacity()+offset.capacity()*sizeof(size_t)+lin.capacity()*sizeof(uint32_t);
+  }
+  const bam1_core_t& core(size_t i) const {
+    return *(const bam1_core_t*)(&data[offset[i]]);
+  }
+  const uint8_t* record(size_t i) const {
+    return &data[offset[i]] + sizeof(bam1_core_t) + sizeof(int32_t);
+  }
+  int32_t data_len(size_t i) const {
+    return *(const int32_t*)(&data[offset[i]] + sizeof(bam1_core_t));
+  }
+};
+
+/*!
+  @abstract  read the stream up to the end of target ref
+
+  records of targets before ref are skipped, targets must be requested
+  in the order of the stream. exits if the stream is not sorted.
+
+  @return    false if the stream has no record in ref:beg-end
+*/
+bool bamstream_load(int ref, int beg, int end);
+
+//! release the records of the current target
+void bamstream_clear();
+
+//! an index query or a query of the records in memory, t0 and nread
+//! are kept for -trace
+struct region_iter_st {
+  bam_iter_t iter;
+  int tid;
+  int beg;
+  int end;
+  size_t i;
+  double t0;
+  size_t nread;
+};
+typedef region_iter_st* region_iter_t;
+
+//! same as bam_iter_query(msc::bamidx, ref, beg, end)
+region_iter_t region_query(int ref, int beg, int end);
+
+//! same as bam_iter_read(msc::fp_in->x.bam, iter, b)
+int region_read(region_iter_t iter, bam1_t *b);
+
+//! release iter, the query is traced as one span from region_query()
+void region_destroy(region_iter_t iter);
+
+#endif
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "ref2bit.h"
+#include "matchreads.h"
+#include "batch.h"
+
+static int usage_batch(int argc, char* argv[])
+{
+  cerr << "Usage:\n"
+       << "  matchclips batch -list BAMLIST -O OUTDIR [-j INT] <options> -f REFFILE\n"
+       << "\n"
+       << "  -list STR  BAMLIST, one BAMFILE per line\n"
+       << "  -O  STR  OUTDIR, each BAMFILE writes OUTDIR/NAME" << BATCH_SUFFIX << " and its\n"
+       << "           messages to OUTDIR/NAME" << BATCH_SUFFIX << ".log, NAME the file name\n"
+       << "           of BAMFILE; OUTDIR/" << BATCH_LIST << " lists the outputs finished\n"
+       << "  -j  INT  BAMFILEs run at once, INT=cores/-t\n"
+       << "\n"
+       << "  <options> are those of matchclips and apply to every BAMFILE, the\n"
+       << "  calls are those of matchclips run on each BAMFILE alone. with -f2 the\n"
+       << "  packed REFFILE" << REF2BIT_SUFFIX << " is built once and shared by all runs.\n"
+       << "  -b, -o, -bn, --shard, -dump, -status, -metrics and -trace are not taken.\n"
+       << endl;
+  return 0;
+}
+
+//! errors exit(0) everywhere, a run that did not finish its BAM exits 1
+static bool b_finished=false;
+static void batch_worker_exit()
+{
+  if ( !b_finished ) _exit(1);
+}
+
+//! one BAM in a forked process, never returns
+static void batch_worker(const vector<string>& opts, const string& bam, const string& out)
+{
+  string log=out+".log";
+  int fd=open(log.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if ( fd<0 || dup2(fd, 2)<0 ) _exit(1);
+  close(fd);
+  atexit(batch_worker_exit);
+
+  vector<string> args(opts);
+  args.push_back("-o"); args.push_back(out);
+  args.push_back("-b"); args.push_back(bam);
+  vector<char*> argv(0);
+  for(size_t i=0; i<args.size(); ++i) argv.push_back( (char*)args[i].c_str() );
+  argv.push_back(NULL);
+
+  time_t begin_T, end_T;
+  time(&begin_T);
+  match_MS_SM_reads(argv.size()-1, &argv[0]);
+  cerr << procpidstatus(getpid(), "VmPeak");
+  time(&end_T);
+  cerr << "#Time elapsed: " << difftime(end_T, begin_T) << " seconds\n";
+  b_finished=true;
+  exit(0);
+}
+
+//! BAMFILEs of fn, the first column of each line
+static void read_bam_list(const string& fn, vector<string>& bams)
+{
+  ifstream FIN(fn.c_str());
+  if ( !FIN ) {
+    cerr << fn << " not found!" << endl;
+    exit(0);
+  }
+  bams.clear();
+  string line, bam;
+  while ( getline(FIN, line) ) {
+    if ( line=="" || line[0]=='#' ) continue;
+    if ( istringstream(line) >> bam ) bams.push_back(bam);
+  }
+  FIN.close();
+  return;
+}
+
+static string file_name(const string& fn)
+{
+  return fn.rfind('/')==string::npos ? fn : fn.substr(fn.rfind('/')+1);
+}
+
+static bool sort_by_size(const pair<off_t, size_t>& a, const pair<off_t, size_t>& b)
+{
+  if ( a.first != b.first ) return a.first > b.first;
+  return a.second < b.second;
+}
+
+void batch_run(int argc, char* argv[])
+{
+  msc::mycommand=argv[0];
+  for(int i=1; i<argc; ++i) msc::mycommand+=" "+string(argv[i]);
+
+  string listFile="", outDir="", refFile="";
+  int njob=0, nthread=1;
+  bool packed=false, compressed=false;
+  vector<string> opts(1, "matchclips");
+  for(int i=1; i<argc; ++i) {
+    string arg=argv[i];
+    if ( arg=="-list" && i+1<argc ) { listFile=argv[++i]; continue; }
+    if ( arg=="-O" && i+1<argc ) { outDir=argv[++i]; continue; }
+    if ( arg=="-j" && i+1<argc ) { njob=atoi(argv[++i]); continue; }
+    if ( arg=="-b" || arg=="-o" || arg=="-bn" || arg=="--shard" || arg=="-dump" ||
+	 arg=="-status" || arg=="-metrics" || arg=="-trace" ) {
+      cerr << arg << " is not taken by batch" << endl;
+      exit( usage_batch(argc, argv) );
+    }
+    if ( arg=="-f" && i+1<argc ) refFile=argv[i+1];
+    if ( arg=="-t" && i+1<argc ) nthread=max(1, atoi(argv[i+1]));
+    if ( arg=="-f2" ) packed=true;
+    if ( arg=="-oz" ) compressed=true;
+    opts.push_back(arg);
+  }
+  if ( listFile=="" || outDir=="" || refFile=="" ) exit( usage_batch(argc, argv) );
+  if ( njob<=0 ) njob=max(1L, sysconf(_SC_NPROCESSORS_ONLN)/nthread);
+
+  vector<string> bams(0);
+  read_bam_list(listFile, bams);
+  if ( bams.size()==0 ) {
+    cerr << "no BAMFILE in " << listFile << endl;
+    exit(0);
+  }
+
+  // every output is named after its BAM, and the largest BAMs run first
+  map<string, size_t> names;
+  vector<string> outs(0);
+  vector<pair<off_t, size_t> > order(0);
+  for(size_t k=0; k<bams.size(); ++k) {
+    struct stat st;
+    if ( stat(bams[k].c_str(), &st)!=0 ) {
+      cerr << bams[k] << " not found!" << endl;
+      exit(0);
+    }
+    string name=file_name(bams[k]);
+    if ( names.find(name)!=names.end() ) {
+      cerr << bams[k] << " and " << bams[names[name]] << " would write the same "
+	   << name << BATCH_SUFFIX << endl;
+      exit(0);
+    }
+    names[name]=k;
+    outs.push_back(outDir+"/"+name+BATCH_SUFFIX);
+    order.push_back( make_pair(st.st_size, k) );
+  }
+  sort(order.begin(), order.end(), sort_by_size);
+  if ( mkdir(outDir.c_str(), 0755)!=0 && errno!=EEXIST ) {
+    cerr << "cannot create " << outDir << endl;
+    exit(0);
+  }
+
+  // with -f2 the sidecar is built and mapped here once, the forked runs
+  // share the mapping instead of each building or mapping it
+  const vector<faientry_st>& fai=load_fai(refFile);
+  if ( packed && fai.size()>0 && ref2bit_find(refFile, fai[0].name)==NULL ) {
+    cerr << "#building " << refFile << REF2BIT_SUFFIX << endl;
+    if ( !ref2bit_build(refFile) )
+      cerr << "#failed to write " << refFile << REF2BIT_SUFFIX
+	   << ", each BAMFILE reads " << refFile << endl;
+    else ref2bit_find(refFile, fai[0].name);
+  }
+
+  cerr << bams.size() << " BAMFILEs, " << njob << " at once with "
+       << nthread << " threads each" << endl;
+
+  map<pid_t, size_t> running;
+  vector<bool> done(bams.size(), false);
+  size_t next=0, nfailed=0;
+  while ( next<order.size() || running.size()>0 ) {
+    if ( next<order.size() && (int)running.size()<njob ) {
+      size_t k=order[next++].second;
+      cerr.flush();
+      fflush(NULL);
+      pid_t pid=fork();
+      if ( pid<0 ) {
+	cerr << "cannot fork for " << bams[k] << endl;
+	exit(0);
+      }
+      if ( pid==0 ) batch_worker(opts, bams[k], outs[k]);
+      running[pid]=k;
+      cerr << "started\t" << bams[k] << endl;
+      continue;
+    }
+    int status=0;
+    pid_t pid=wait(&status);
+    if ( pid<0 ) break;
+    if ( running.find(pid)==running.end() ) continue;
+    size_t k=running[pid];
+    running.erase(pid);
+    done[k]= WIFEXITED(status) && WEXITSTATUS(status)==0;
+    if ( !done[k] ) ++nfailed;
+    cerr << ( done[k] ? "finished\t" : "failed\t" ) << bams[k] << "\t"
+	 << outs[k] << ".log" << endl;
+  }
+
+  string listOut=outDir+"/"+BATCH_LIST;
+  ofstream FOUT(listOut.c_str());
+  for(size_t k=0; k<bams.size(); ++k)
+    if ( done[k] ) FOUT << outs[k] << ( compressed ? ".gz" : "" ) << "\n";
+  FOUT.close();
+  if ( !FOUT ) cerr << "cannot write " << listOut << endl;
+
+  cerr << bams.size()-nfailed << " of " << bams.size() << " BAMFILEs finished, listed in "
+       << listOut << endl;
+  return;
+}
@@ -0,0 +1,26 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+using namespace std;
+#include <string>
+#include <vector>
+
+//! each BAM of a batch writes OUTDIR/NAME+BATCH_SUFFIX, NAME the BAM file name
+#define BATCH_SUFFIX ".mc"
+
+//! the outputs of the BAMs finished are listed in OUTDIR/BATCH_LIST, as
+//! read by cnvtable -cnvf
+#define BATCH_LIST "cnvf.txt"
+
+/*!
+  @abstract  matchclips batch -list BAMLIST -O OUTDIR [-j INT] <options> -f REFFILE
+
+  every BAM of BAMLIST is run as by matchclips <options> -b BAM -o
+  OUTDIR/NAME.mc, with its messages in OUTDIR/NAME.mc.log. with -f2 the
+  packed reference REFFILE.mc2bit is built once and every run maps the
+  same copy. -j runs of -t threads each are kept going, the largest BAMs
+  first. no update check is made for the runs.
+*/
+void batch_run(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,184 @@
+#!/usr/bin/perl
+use warnings;
+use strict;
+use Carp;
+use JSON::PP;
+
+## end to end benchmark: simulate a BAM with known variations with
+## mcbench simbam, run matchclips on it with several thread counts and
+## report throughput, stage times, peak memory, recall and precision
+
+my @bases=split(/\//, $0);
+my $me=$bases[-1];
+my $bindir= @bases>1 ? join("/", @bases[0..$#bases-1]) : ".";
+
+my $dir="benchsv";
+my @threads=(1, 2, 4);
+my $window=10;
+my $extra="";
+my $nshard=0;
+my @simopt=();
+while ( @ARGV ) {
+    my $a=shift @ARGV;
+    if ( $a eq "-h" ) { usage(); }
+    elsif ( $a eq "-o" ) { $dir=shift @ARGV; }
+    elsif ( $a eq "-t" ) { @threads=split(/,/, shift @ARGV); }
+    elsif ( $a eq "-w" ) { $window=shift @ARGV; }
+    elsif ( $a eq "-x" ) { $extra=shift @ARGV; }
+    elsif ( $a eq "-shard" ) { $nshard=shift @ARGV; }
+    elsif ( $a =~ /^-[fnLclisdumMeS]$/ ) { push @simopt, $a, shift @ARGV; }
+    else { usage(); }
+}
+
+my $mcbench="$bindir/mcbench";
+my $matchclips="$bindir/matchclips";
+-x $mcbench or die "$mcbench not found, run make bench\n";
+-x $matchclips or die "$matchclips not found, run make\n";
+mkdir $dir unless -d $dir;
+
+my $prefix="$dir/sim";
+run("$mcbench simbam -o $prefix @simopt 2> $prefix.err");
+
+## truth, the reference and the number of reads are in the header
+my ($ref, $nread)=("", 0);
+my @truth=();
+open (FIN, "$prefix.truth.txt") or die "$prefix.truth.txt not found $!\n";
+while (<FIN>) {
+    chomp;
+    if ( /^#reference\t(.*)$/ ) { $ref=$1; next; }
+    if ( /^#reads\t(\d+)$/ ) { $nread=$1; next; }
+    next if /^#/;
+    my @c=split(/\t/);
+    push @truth, [ @c[0..3] ];
+}
+close(FIN);
+print STDERR "#", scalar(@truth), " variations, $nread reads in $prefix.bam\n";
+
+my @stages=qw(reference ingest pair_clustering exhaustive_matching validation output);
+print join("\t", "threads", "wall_s", "reads/s", (map { $_."_s" } @stages),
+	   "peak_rss_MB", "calls", "recall", "precision"), "\n";
+foreach my $t (@threads) {
+    my $out="$dir/t$t";
+    run("$matchclips -t $t -f $ref -b $prefix.bam -o $out.txt -metrics $out.json $extra 2> $out.err");
+    open (FIN, "$out.json") or die "$out.json not found $!\n";
+    my $m=decode_json( join("", <FIN>) );
+    close(FIN);
+    my @calls=read_calls("$out.txt");
+    my ($recall, $precision)=compare(\@truth, \@calls);
+    my $wall=$m->{wall_seconds};
+    printf("%d\t%.2f\t%.0f", $t, $wall, $wall>0 ? $nread/$wall : 0);
+    printf("\t%.2f", $m->{stage_seconds}{$_}) foreach (@stages);
+    printf("\t%.1f\t%d\t%.3f\t%.3f\n", $m->{vm_hwm_kb}/1024, scalar(@calls),
+	   $recall, $precision);
+}
+
+## merge check: the calls of --shard i/N merged must be those of the
+## first run above, also for variations across a cut
+if ( $nshard>0 ) {
+    my $t=$threads[0];
+    my @shards=();
+    for(my $i=1; $i<=$nshard; $i++) {
+	my $out="$dir/shard$i";
+	run("$matchclips -t $t -f $ref -b $prefix.bam --shard $i/$nshard -o $out $extra 2> $out.err");
+	push @shards, $out;
+    }
+    run("$matchclips merge -o $dir/merged.txt @shards 2> $dir/merged.err");
+    my @cuts=();
+    open (FIN, "$dir/shard1.err") or die "$dir/shard1.err not found $!\n";
+    while (<FIN>) { push @cuts, [ $1, $2 ] if ( /^cut\t(.*):(\d+)/ ); }
+    close(FIN);
+    my $across=0;
+    foreach my $v (@truth) {
+	foreach my $c (@cuts) {
+	    if ( $v->[0] eq $c->[0] && $v->[1]<$c->[1] && $v->[2]>=$c->[1] ) { $across++; last; }
+	}
+    }
+    my $same=1;
+    foreach my $f ("txt", "txt.weak") {
+	my @a=grep { !/^##/ } read_lines("$dir/t$t.$f");
+	my @b=grep { !/^##/ } read_lines("$dir/merged.$f");
+	$same=0 if ( join("", @a) ne join("", @b) );
+    }
+    print join("\t", "shards", "cuts", "variations_across_cuts", "merged"), "\n";
+    print join("\t", $nshard, scalar(@cuts), $across, $same ? "same" : "DIFF"), "\n";
+    exit(1) unless $same;
+}
+
+exit(0);
+
+sub read_lines {
+    my $fn=shift;
+    open (FIN, $fn) or die "$fn not found $!\n";
+    my @lines=<FIN>;
+    close(FIN);
+    return @lines;
+}
+
+sub run {
+    my $cmd=shift;
+    print STDERR "#$cmd\n";
+    system($cmd)==0 or die "failed: $cmd\n";
+}
+
+sub read_calls {
+    my $fn=shift;
+    my @calls=();
+    open (FIN, $fn) or die "$fn not found $!\n";
+    while (<FIN>) {
+	next if /^#/;
+	chomp;
+	my @c=split(/\t/);
+	push @calls, [ @c[0..3] ] if ( @c>=4 );
+    }
+    close(FIN);
+    return @calls;
+}
+
+## a call finds a variation of the same type whose ends are within $window
+sub compare {
+    my ($truth, $calls)=@_;
+    my %found=();
+    my $good=0;
+    foreach my $c (@$calls) {
+	my $hit=0;
+	for(my $i=0; $i<@$truth; $i++) {
+	    my $v=$truth->[$i];
+	    next if ( $v->[0] ne $c->[0] || $v->[3] ne $c->[3] );
+	    next if ( abs($v->[1]-$c->[1])>$window || abs($v->[2]-$c->[2])>$window );
+	    $found{$i}=1;
+	    $hit=1;
+	}
+	$good+=$hit;
+    }
+    my $recall= @$truth ? scalar(keys %found)/@$truth : 0;
+    my $precision= @$calls ? $good/@$calls : 0;
+    return ($recall, $precision);
+}
+
+sub usage {
+    print STDERR <<EOF;
+$me simulates a BAM with known deletions and duplications and runs
+matchclips on it with several thread counts. A tab separated table of
+wall time, reads per second, stage times from -metrics, peak RSS, and
+recall and precision of the calls in the main output is printed.
+
+Usage:
+  $me [options]
+
+Options:
+  -o  DIR  working directory, default benchsv
+  -t  LIST threads, default 1,2,4
+  -w  INT  a call matches a variation if both ends are within INT, default 10
+  -x  STR  more matchclips options, quoted
+  -shard INT  also run --shard i/INT with the first thread count, merge
+           the shards and check the calls are those of the single run,
+           exits 1 if not
+  -f -n -L -c -l -i -s -d -u -m -M -e -S are passed to mcbench simbam
+
+Examples:
+  $me -c 50 -t 1,4
+  $me -f hg19.fasta -n 1 -c 30 -x "-f2"
+  $me -n 1 -L 4000000 -d 4 -u 2 -m 150000 -M 500000 -t 1 -shard 4 -x "-L 10000"
+EOF
+    exit(0);
+}
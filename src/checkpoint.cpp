@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "checkpoint.h"
+
+static string c_file="";
+static FILE *c_fp=NULL;
+
+//! a journal is only resumed by a run with the same header
+static string checkpoint_header(const vector<string>& outputs)
+{
+  ostringstream os;
+  os << CHECKPOINT_MAGIC << "\n"
+     << "#bam\t" << msc::bamFile << "\n"
+     << "#reference\t" << msc::refFile << "\n"
+     << ( msc::normalFile!="" ? "#normal\t"+msc::normalFile+"\n" : "" )
+     << "#regions";
+  for(size_t i=0; i<msc::bamRegion.size(); ++i) os << "\t" << msc::bamRegion[i];
+  os << "\n#options\t-e " << msc::errMatch << " -l " << msc::minOverlap
+     << " -s " << msc::minSNum << " -q " << msc::minMAPQ << " -Q " << msc::minBASEQ
+     << " -L " << ( msc::search_length_set_by_user ? msc::maxDistance : -1 )
+     << " -pe " << ( msc::bam_pe_set_by_user ? msc::bam_pe_insert : -1 )
+     << " " << ( msc::bam_pe_set_by_user ? msc::bam_pe_insert_sd : -1 )
+     << ( msc::bam_pe_disabled ? " -se" : "" )
+     << ( msc::bam_pe_region ? " -pr" : "" )
+     << ( msc::noSecondary ? "" : " -2" )
+     << " -M " << msc::memBudget << "\n"
+     << "#outputs";
+  for(size_t i=0; i<outputs.size(); ++i) os << "\t" << outputs[i];
+  os << "\n";
+  return os.str();
+}
+
+static string checkpoint_line(const ckptregion_st& r)
+{
+  ostringstream os;
+  os << "region\t" << r.region << "\t" << r.name << "\t"
+     << ( r.pe_target=="" ? "." : r.pe_target ) << "\t"
+     << r.pe_insert << "\t" << r.pe_insert_sd;
+  for(size_t i=0; i<r.offset.size(); ++i) os << "\t" << r.offset[i];
+  os << "\n";
+  return os.str();
+}
+
+//! finished regions of fn, false if it is not a journal of this run
+static bool checkpoint_read(const string& fn, const string& header, size_t noutput,
+			    vector<ckptregion_st>& done)
+{
+  done.clear();
+  ifstream FIN(fn.c_str());
+  if ( !FIN ) return false;
+  string all( (istreambuf_iterator<char>(FIN)), istreambuf_iterator<char>() );
+  FIN.close();
+  if ( all.compare(0, header.size(), header)!=0 ) return false;
+
+  size_t p=header.size();
+  for(size_t q; (q=all.find('\n', p))!=string::npos; p=q+1) {
+    istringstream is( all.substr(p, q-p) );
+    string tag;
+    ckptregion_st r;
+    if ( !(is >> tag >> r.region >> r.name >> r.pe_target >> r.pe_insert >> r.pe_insert_sd) ||
+	 tag!="region" ) continue;
+    if ( r.pe_target=="." ) r.pe_target="";
+    long off;
+    while ( is >> off ) r.offset.push_back(off);
+    if ( r.offset.size()!=noutput ) continue;
+    if ( r.region<0 || r.region>=(int)msc::bamRegion.size() ||
+	 msc::bamRegion[r.region]!=r.name ) continue;
+    done.push_back(r);
+  }
+  return true;
+}
+
+static void checkpoint_fail()
+{
+  cerr << "cannot write " << c_file << endl;
+  exit(0);
+}
+
+void checkpoint_open(const string& fn, const vector<string>& outputs, bool resume,
+		     vector<ckptregion_st>& done)
+{
+  c_file=fn;
+  string header=checkpoint_header(outputs);
+  done.clear();
+
+  if ( resume ) {
+    if ( !checkpoint_read(fn, header, outputs.size(), done) )
+      cerr << "no checkpoint of this run in " << fn << ", starting from the first region" << endl;
+    // the outputs must still hold what the journal says was written
+    if ( !done.empty() ) {
+      const vector<long>& off=done.back().offset;
+      for(size_t i=0; i<outputs.size(); ++i) {
+	struct stat st;
+	bool ok= off[i]<0 || ( stat(outputs[i].c_str(), &st)==0 && st.st_size>=off[i] );
+	if ( ok ) continue;
+	cerr << outputs[i] << " is shorter than in " << fn
+	     << ", starting from the first region" << endl;
+	done.clear();
+	break;
+      }
+    }
+    for(size_t i=0; i<outputs.size() && !done.empty(); ++i) {
+      long off=done.back().offset[i];
+      if ( off>=0 && truncate(outputs[i].c_str(), off)!=0 ) {
+	cerr << "cannot truncate " << outputs[i] << endl;
+	exit(0);
+      }
+    }
+    if ( !done.empty() )
+      cerr << "resuming after " << done.size() << " finished regions of " << fn << endl;
+  }
+
+  // rewritten with the regions kept, so a second crash resumes as well
+  string tmp=fn+".tmp";
+  c_fp=fopen(tmp.c_str(), "w");
+  if ( c_fp==NULL ) checkpoint_fail();
+  fputs(header.c_str(), c_fp);
+  for(size_t i=0; i<done.size(); ++i) fputs(checkpoint_line(done[i]).c_str(), c_fp);
+  if ( fflush(c_fp)!=0 ) checkpoint_fail();
+  fsync(fileno(c_fp));
+  if ( rename(tmp.c_str(), fn.c_str())!=0 ) checkpoint_fail();
+  return;
+}
+
+void checkpoint_region(const ckptregion_st& r)
+{
+  if ( c_fp==NULL ) return;
+  fputs(checkpoint_line(r).c_str(), c_fp);
+  if ( fflush(c_fp)!=0 ) checkpoint_fail();
+  fsync(fileno(c_fp));
+  return;
+}
+
+void checkpoint_close()
+{
+  if ( c_fp==NULL ) return;
+  if ( fclose(c_fp)!=0 ) checkpoint_fail();
+  c_fp=NULL;
+  return;
+}
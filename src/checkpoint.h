@@ -0,0 +1,52 @@
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+using namespace std;
+#include <string>
+#include <vector>
+
+//! the journal starts with this line
+#define CHECKPOINT_MAGIC "##matchclips checkpoint"
+
+/*!
+  @abstract a region whose calls are on disk, one line of the journal
+
+  @field  region       index in msc::bamRegion
+  @field  name         region string, checked on resume
+  @field  offset       size of each output file after the region
+  @field  pe_target    contig whose insert model is shared with small
+                       contigs, "" if none yet
+  @field  pe_insert, pe_insert_sd  the shared insert model
+*/
+struct ckptregion_st {
+  int region;
+  string name;
+  vector<long> offset;
+  string pe_target;
+  int pe_insert;
+  int pe_insert_sd;
+  ckptregion_st(): region(-1), name(""), offset(0), pe_target(""),
+		   pe_insert(0), pe_insert_sd(0) {};
+};
+
+/*!
+  @abstract  open the journal fn of a run writing the files outputs
+
+  the journal names the BAM, the reference, the regions and the outputs
+  of the run, each finished region is appended as one line after its
+  calls are flushed to disk. a line cut by a crash is ignored.
+
+  with resume the finished regions of the journal are returned in done
+  and every output is truncated to its offset after the last of them; a
+  journal of another run or outputs shorter than their offsets start the
+  run again. the journal is then rewritten with done.
+*/
+void checkpoint_open(const string& fn, const vector<string>& outputs, bool resume,
+		     vector<ckptregion_st>& done);
+
+//! record r as finished, the offsets must be on disk already
+void checkpoint_region(const ckptregion_st& r);
+
+void checkpoint_close();
+
+#endif
@@ -12,6 +12,7 @@
 using namespace std;
 
 #include "functions.h"
+#include "tabix.h"
 
 struct cnv_st {
   string RNAME;
@@ -152,10 +153,13 @@ void subsetcnv(string& region, vector<string>& samplecnvfile, vector<string>& sa
     }
     
     cout << "#" << sampleid[i] << "\t" << samplecnvfile[i] << endl;
-    ifstream FIN(samplecnvfile[i].c_str()) ;
-    while ( !FIN.eof() ) {
-      string tmps,tmps1;
-      getline(FIN,tmps);
+    // an indexed file is only read around the region, others line by line
+    vector<string> lines(0);
+    bool indexed=tabix_query(samplecnvfile[i], rcnv.RNAME, rcnv.P1-1, rcnv.P2, lines);
+    textfile_t FIN= indexed ? NULL : text_open(samplecnvfile[i]);
+    string tmps;
+    for(size_t l=0; indexed ? l<lines.size() : text_getline(FIN, tmps); ++l) {
+      if ( indexed ) tmps=lines[l];
       if ( tmps[0] == '#' || tmps.length() <2 ) continue;
       istringstream iss(tmps);
       iss >> icnv.RNAME >> icnv.P1 >> icnv.P2 >> icnv.type;
@@ -164,7 +168,7 @@ void subsetcnv(string& region, vector<string>& samplecnvfile, vector<string>& sa
 	   rOverlap*(double)max(icnv.P2-icnv.P1, rcnv.P2-rcnv.P1)  ) 
 	cout << tmps << endl;
     }
-    FIN.close();
+    text_close(FIN);
     
   }
   
@@ -182,7 +186,8 @@ int usage_check_sample_table(int argc, char* argv[]) {
        << "  -l    INT  minimum length to include, INT=3 \n"
        << "  -L    INT  maximum length to include, INT=10000000 \n"
        << "  -t    STR  only process STR type of CNVs\n"
-       << "  -R    STR  subset cnvs in region STR\n"
+       << "  -R    STR  subset cnvs in region STR, files with a tabix index are\n"
+       << "             only read around STR\n"
        << "  -chr       1-22XY are treated as chr[1-22XY]\n"
        << "  -O  FLOAT  minimum reciprocal overlap ratio [0.0, 1.0], FLOAT=0.5\n"
        << "  -o    STR  outputfile, STR=STDOUT \n"
@@ -191,6 +196,7 @@ int usage_check_sample_table(int argc, char* argv[]) {
        << "\nNote :\n"
        << "  If the list of filenames is long, it is necessary to put them in a file,\n"
        << "  and use the -cnvf option. Each line should contain 1(filename) string \nor 2(filename idname) strings.\n"
+       << "  Files may be plain text or bgzipped, as written by matchclips -oz.\n"
        << endl;
   
   return(0);
@@ -300,11 +306,10 @@ int check_sample_table(int argc, char* argv[])
       exit(0); 
     }
     
-    ifstream FIN(samplecnvfile[i].c_str()) ;
+    textfile_t FIN=text_open(samplecnvfile[i]);
     vector<cnv_st> cnvlist(0);
-    while ( !FIN.eof() ) {
-      string tmps,tmps1;
-      getline(FIN,tmps);
+    string tmps;
+    while ( text_getline(FIN, tmps) ) {
       if ( tmps[0] == '#' || tmps.length() <2 ) continue;
       istringstream iss(tmps);
       iss >> icnv.RNAME >> icnv.P1 >> icnv.P2 >> icnv.type;
@@ -322,7 +327,7 @@ int check_sample_table(int argc, char* argv[])
       
       cnvlist.push_back(icnv);
     }
-    FIN.close();
+    text_close(FIN);
     
     sort(cnvlist.begin(), cnvlist.end(), comp_cnv_st);
     cerr << "#" << sampleid[i] << "\t" << cnvlist.size() << endl;
@@ -369,11 +374,10 @@ int check_sample_table(int argc, char* argv[])
   for(size_t i=0;i<samplecnvfile.size();++i) {
     
     cerr << i << "\t" << samplecnvfile[i] << endl;
-    ifstream FIN(samplecnvfile[i].c_str()) ;
+    textfile_t FIN=text_open(samplecnvfile[i]);
     vector<cnv_st> cnvlist(0);
-    while ( !FIN.eof() ) {
-      string tmps,tmps1;
-      getline(FIN,tmps);
+    string tmps;
+    while ( text_getline(FIN, tmps) ) {
       if ( tmps[0] == '#' || tmps.length() <2 ) continue;
       istringstream iss(tmps);
       if (!( iss >> icnv.RNAME >> icnv.P1 >> icnv.P2 >> icnv.type) ) continue;
@@ -392,6 +396,7 @@ int check_sample_table(int argc, char* argv[])
       
       cnvlist.push_back(icnv);
     }
+    text_close(FIN);
     sort(cnvlist.begin(), cnvlist.end(), comp_cnv_st);
     
     size_t istart=0;
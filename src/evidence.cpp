@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "samfunctions.h"
+#include "matchreads.h"
+#include "readstore.h"
+#include "pairset.h"
+#include "preprocess.h"
+#include "evidence.h"
+
+/*
+ * file layout, native byte order, every section is padded to 8 bytes
+ *   header, EVIDENCE_HEADER bytes
+ *     magic[8] bamstamp[64] refstamp[64]
+ *     int32 tid beg end reflen bam_beg bam_end min_snum min_pair
+ *     double isize isize2 isize_c
+ *     uint64 rd_bytes npairs nreads[2] rec_bytes[2]
+ *   read depth, zigzag varint of the difference to the previous base
+ *   pairs, int32 F2[n] R1[n] isize[n], uint8 flag[n] mapq[n]
+ *   for M...S then S...M reads
+ *     evread_st[n]
+ *     records of readstore_st::raw(), one after the other
+ */
+
+struct evread_st {
+  int32_t pos;
+  int32_t sbeg;
+  uint16_t S;
+  uint16_t S0;
+  uint16_t l_qseq;
+  uint16_t n_cigar;
+  uint16_t nN;
+  uint8_t mapq;
+  uint8_t enc;
+  uint8_t bq25;
+  uint8_t pad[3];
+};
+
+struct evheader_st {
+  char magic[8];
+  char bamstamp[EVIDENCE_STAMP];
+  char refstamp[EVIDENCE_STAMP];
+  int32_t tid, beg, end, reflen, bam_beg, bam_end, min_snum, min_pair;
+  double isize, isize2, isize_c;
+  uint64_t rd_bytes, npairs, nreads[2], rec_bytes[2];
+};
+
+static size_t align8(size_t n) { return (n+7) & ~(size_t)7; }
+
+evidence_st::evidence_st(): bam_beg(0), bam_end(0), isize(0), isize2(0), isize_c(0),
+			    min_snum(0), min_pair(0)
+{
+}
+
+void evidence_st::clear()
+{
+  bam_beg=bam_end=0;
+  isize=isize2=isize_c=0;
+  pairs.clear();
+  vector<int32_t> (0).swap(pair_isize);
+  vector<uint8_t> (0).swap(pair_mapq);
+  for(int k=0; k<2; ++k) {
+    reads[k].clear();
+    vector<uint16_t> (0).swap(S0[k]);
+    vector<uint16_t> (0).swap(nN[k]);
+    vector<uint8_t> (0).swap(bq25[k]);
+  }
+}
+
+void evidence_st::add_read(const bam1_t *b, const POSCIGAR_st& bm, const RSAI_st& iread,
+			   const refseq_st& FASTA)
+{
+  int k= iread.sbeg > iread.pos ? 0 : 1;
+  if ( !reads[k].add(b, bm, FASTA) ) return;
+  S0[k].push_back(iread.S0);
+  nN[k].push_back(iread.nN);
+  bq25[k].push_back(iread.bq25);
+}
+
+string evidence_file(int ref, int beg, int end)
+{
+  string bam=msc::bamFile;
+  size_t p=bam.rfind('/');
+  if ( p!=string::npos ) bam=bam.substr(p+1);
+  string region=msc::bam_target_name[ref];
+  if ( beg>0 || end<(int)msc::fp_in->header->target_len[ref] )
+    region+="_"+to_string(beg)+"_"+to_string(end);
+  return msc::evidenceDir+"/"+bam+"."+region+EVIDENCE_SUFFIX;
+}
+
+//! the thresholds of this run on a read saved at the loosest filter
+static bool evidence_keep_read(int mapq, int S, int S0, int nN, int bq25)
+{
+  RSAI_st iread;
+  iread.q1=mapq;
+  iread.S=S;
+  iread.S0=S0;
+  iread.nN=nN;
+  iread.bq25=bq25;
+  return is_keep_read_threshold(iread);
+}
+
+void evidence_apply(const evidence_st& ev, int min_pair_length,
+		    pairset_st& pairs, readstore_st& r_MS, readstore_st& r_SM)
+{
+  for(size_t i=0; i<ev.pairs.size(); ++i)
+    if ( ev.pair_isize[i]>=min_pair_length && ev.pair_mapq[i]>=msc::minMAPQ )
+      pairs.push_back(ev.pairs.F2[i], ev.pairs.F2_acurate(i),
+		      ev.pairs.R1[i], ev.pairs.R1_acurate(i));
+  readstore_st *r[2]={ &r_MS, &r_SM };
+  for(int k=0; k<2; ++k) {
+    const readstore_st& s=ev.reads[k];
+    for(size_t i=0; i<s.size(); ++i)
+      if ( evidence_keep_read(s.mapq[i], s.S[i], ev.S0[k][i], ev.nN[k][i], ev.bq25[k][i]) )
+	r[k]->add_raw(s, i);
+  }
+  return;
+}
+
+//! zeros after n bytes up to the next multiple of 8
+static bool write_pad(FILE *fp, size_t n)
+{
+  static const char zero[8]={0};
+  return fwrite(zero, 1, align8(n)-n, fp)==align8(n)-n;
+}
+
+static bool write_block(FILE *fp, const void *p, size_t n)
+{
+  if ( n>0 && fwrite(p, 1, n, fp)!=n ) return false;
+  return write_pad(fp, n);
+}
+
+static void set_stamp(char *dst, const string& stamp)
+{
+  memset(dst, 0, EVIDENCE_STAMP);
+  strncpy(dst, stamp.c_str(), EVIDENCE_STAMP-1);
+}
+
+bool evidence_save(const string& fn, int ref, int beg, int end,
+		   const evidence_st& ev, const vector<int32_t>& rd)
+{
+  mkdir(msc::evidenceDir.c_str(), 0777);
+
+  // read depth as zigzag varint of differences, mostly 1 byte per base
+  vector<uint8_t> rdz(0);
+  rdz.reserve(rd.size()+16);
+  int32_t last=0;
+  for(size_t i=0; i<rd.size(); ++i) {
+    int32_t d=rd[i]-last;
+    last=rd[i];
+    uint32_t z=( (uint32_t)d<<1 ) ^ (uint32_t)(d>>31);
+    while ( z>=0x80 ) { rdz.push_back( (z&0x7f)|0x80 ); z>>=7; }
+    rdz.push_back(z);
+  }
+
+  evheader_st h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, EVIDENCE_MAGIC, strlen(EVIDENCE_MAGIC));
+  set_stamp(h.bamstamp, file_stamp(msc::bamFile));
+  set_stamp(h.refstamp, file_stamp(msc::refFile));
+  h.tid=ref;
+  h.beg=beg;
+  h.end=end;
+  h.reflen=rd.size();
+  h.bam_beg=ev.bam_beg;
+  h.bam_end=ev.bam_end;
+  h.min_snum=ev.min_snum;
+  h.min_pair=ev.min_pair;
+  h.isize=ev.isize;
+  h.isize2=ev.isize2;
+  h.isize_c=ev.isize_c;
+  h.rd_bytes=rdz.size();
+  h.npairs=ev.pairs.size();
+  for(int k=0; k<2; ++k) {
+    h.nreads[k]=ev.reads[k].size();
+    for(size_t i=0; i<ev.reads[k].size(); ++i) h.rec_bytes[k]+=ev.reads[k].raw_size(i);
+  }
+
+  ostringstream tmpfn;
+  tmpfn << fn << "." << getpid();
+  FILE *fp=fopen(tmpfn.str().c_str(), "wb");
+  if ( fp==NULL ) return false;
+  char hbuf[EVIDENCE_HEADER];
+  memset(hbuf, 0, EVIDENCE_HEADER);
+  memcpy(hbuf, &h, sizeof(h));
+  bool ok=write_block(fp, hbuf, EVIDENCE_HEADER);
+  ok = ok && write_block(fp, rdz.size()>0 ? &rdz[0] : NULL, rdz.size());
+  size_t n=ev.pairs.size();
+  ok = ok && write_block(fp, n>0 ? &ev.pairs.F2[0] : NULL, n*4);
+  ok = ok && write_block(fp, n>0 ? &ev.pairs.R1[0] : NULL, n*4);
+  ok = ok && write_block(fp, n>0 ? &ev.pair_isize[0] : NULL, n*4);
+  ok = ok && write_block(fp, n>0 ? &ev.pairs.flag[0] : NULL, n);
+  ok = ok && write_block(fp, n>0 ? &ev.pair_mapq[0] : NULL, n);
+  for(int k=0; k<2 && ok; ++k) {
+    const readstore_st& s=ev.reads[k];
+    vector<evread_st> er(s.size());
+    for(size_t i=0; i<s.size(); ++i) {
+      memset(&er[i], 0, sizeof(evread_st));
+      er[i].pos=s.pos[i];
+      er[i].sbeg=s.sbeg[i];
+      er[i].S=s.S[i];
+      er[i].S0=ev.S0[k][i];
+      er[i].l_qseq=s.l_qseq[i];
+      er[i].n_cigar=s.n_cigar[i];
+      er[i].nN=ev.nN[k][i];
+      er[i].mapq=s.mapq[i];
+      er[i].enc=s.enc[i];
+      er[i].bq25=ev.bq25[k][i];
+    }
+    ok = ok && write_block(fp, er.size()>0 ? &er[0] : NULL, er.size()*sizeof(evread_st));
+    for(size_t i=0; i<s.size() && ok; ++i)
+      ok = fwrite(s.raw(i), 1, s.raw_size(i), fp)==s.raw_size(i);
+    ok = ok && write_pad(fp, h.rec_bytes[k]);
+  }
+  if ( fclose(fp)!=0 ) ok=false;
+  if ( !ok || rename(tmpfn.str().c_str(), fn.c_str())!=0 ) {
+    remove(tmpfn.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool evidence_load(const string& fn, int ref, int beg, int end, int min_pair_length,
+		   evidence_st& ev, vector<int32_t>& rd,
+		   pairset_st& pairs, readstore_st& r_MS, readstore_st& r_SM)
+{
+  int fd=open(fn.c_str(), O_RDONLY);
+  if ( fd<0 ) return false;
+  off_t flen=lseek(fd, 0, SEEK_END);
+  if ( flen<EVIDENCE_HEADER ) { close(fd); return false; }
+  void *m=mmap(NULL, flen, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( m==MAP_FAILED ) return false;
+  madvise(m, flen, MADV_SEQUENTIAL);
+  const uint8_t *base=(const uint8_t*)m;
+
+  evheader_st h;
+  memcpy(&h, base, sizeof(h));
+  char bamstamp[EVIDENCE_STAMP], refstamp[EVIDENCE_STAMP];
+  set_stamp(bamstamp, file_stamp(msc::bamFile));
+  set_stamp(refstamp, file_stamp(msc::refFile));
+
+  // sizes are checked before anything is read
+  size_t o=EVIDENCE_HEADER;
+  size_t o_rd=o;       o+=align8(h.rd_bytes);
+  size_t o_pair=o;     o+=3*align8(h.npairs*4)+2*align8(h.npairs);
+  size_t o_read[2];
+  for(int k=0; k<2; ++k) {
+    o_read[k]=o;
+    o+=align8(h.nreads[k]*sizeof(evread_st))+align8(h.rec_bytes[k]);
+  }
+  bool ok = memcmp(h.magic, EVIDENCE_MAGIC, strlen(EVIDENCE_MAGIC))==0 &&
+    memcmp(h.bamstamp, bamstamp, EVIDENCE_STAMP)==0 &&
+    memcmp(h.refstamp, refstamp, EVIDENCE_STAMP)==0 &&
+    h.tid==ref && h.beg==beg && h.end==end && o==(size_t)flen &&
+    h.min_snum<=msc::minSNum && h.min_pair<=min_pair_length;
+  if ( !ok ) {
+    munmap(m, flen);
+    return false;
+  }
+
+  ev.bam_beg=h.bam_beg;
+  ev.bam_end=h.bam_end;
+  ev.isize=h.isize;
+  ev.isize2=h.isize2;
+  ev.isize_c=h.isize_c;
+  ev.min_snum=h.min_snum;
+  ev.min_pair=h.min_pair;
+
+  rd.assign(h.reflen, 0);
+  const uint8_t *z=base+o_rd, *zend=z+h.rd_bytes;
+  int32_t last=0;
+  for(size_t i=0; i<rd.size() && z<zend; ++i) {
+    uint32_t v=0;
+    for(int s=0; z<zend; s+=7) {
+      v |= (uint32_t)(*z & 0x7f) << s;
+      if ( !(*z++ & 0x80) ) break;
+    }
+    last+=(int32_t)( (v>>1) ^ (~(v&1)+1) );
+    rd[i]=last;
+  }
+
+  size_t n=h.npairs;
+  const int32_t *F2=(const int32_t*)(base+o_pair);
+  const int32_t *R1=(const int32_t*)(base+o_pair+align8(n*4));
+  const int32_t *isz=(const int32_t*)(base+o_pair+2*align8(n*4));
+  const uint8_t *flag=base+o_pair+3*align8(n*4);
+  const uint8_t *mq=flag+align8(n);
+  for(size_t i=0; i<n; ++i)
+    if ( isz[i]>=min_pair_length && mq[i]>=msc::minMAPQ )
+      pairs.push_back(F2[i], flag[i] & PAIR_F2_ACURATE, R1[i], flag[i] & PAIR_R1_ACURATE);
+
+  readstore_st *r[2]={ &r_MS, &r_SM };
+  for(int k=0; k<2; ++k) {
+    const evread_st *er=(const evread_st*)(base+o_read[k]);
+    const uint8_t *rec=base+o_read[k]+align8(h.nreads[k]*sizeof(evread_st));
+    if ( r[k]->tid<0 && h.nreads[k]>0 ) r[k]->tid=ref;
+    for(size_t i=0; i<h.nreads[k]; ++i) {
+      if ( evidence_keep_read(er[i].mapq, er[i].S, er[i].S0, er[i].nN, er[i].bq25) )
+	r[k]->add_raw(er[i].pos, er[i].sbeg, er[i].S, er[i].l_qseq, er[i].n_cigar,
+		      er[i].mapq, er[i].enc, rec);
+      rec+=readstore_st::raw_size(er[i].n_cigar, er[i].l_qseq, er[i].enc);
+    }
+  }
+
+  munmap(m, flen);
+  return true;
+}
@@ -0,0 +1,84 @@
+#ifndef _EVIDENCE_H
+#define _EVIDENCE_H
+
+using namespace std;
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include "readstore.h"
+#include "pairset.h"
+
+//! evidence of a region is saved in DIR/BAMNAME.REGION+EVIDENCE_SUFFIX
+#define EVIDENCE_SUFFIX ".mcev"
+#define EVIDENCE_MAGIC "MCEV1"
+#define EVIDENCE_HEADER 256
+#define EVIDENCE_STAMP 64
+//! loosest -s kept in an evidence file
+#define EVIDENCE_MIN_SNUM 5
+//! discordant pairs are kept down to insert+EVIDENCE_PAIR_SD*sd
+#define EVIDENCE_PAIR_SD 3
+
+/*!
+  @abstract everything prepare_pairend_matchclip_data() takes from the BAM
+
+  soft clipped reads and discordant pairs are kept at the loosest filter,
+  mapq 0, -s EVIDENCE_MIN_SNUM, no base quality and pairs down to
+  min_pair, together with the fields needed to apply the filters of a
+  later run in memory, see is_keep_read_threshold(). the read depth
+  does not depend on the filters and is msc::rd.
+
+  @field  bam_beg     position of the first read in the region
+  @field  bam_end     position of the last read in the region
+  @field  isize       sum of proper pair inserts, for the insert re-estimate
+  @field  min_snum    shortest S part kept
+  @field  min_pair    shortest discordant insert kept
+  @field  reads       M...S reads in reads[0], S...M reads in reads[1]
+*/
+struct evidence_st {
+  int bam_beg;
+  int bam_end;
+  double isize;
+  double isize2;
+  double isize_c;
+  int min_snum;
+  int min_pair;
+  pairset_st pairs;
+  vector<int32_t> pair_isize;
+  vector<uint8_t> pair_mapq;
+  readstore_st reads[2];
+  vector<uint16_t> S0[2];
+  vector<uint16_t> nN[2];
+  vector<uint8_t> bq25[2];
+
+  evidence_st();
+  void clear();
+  //! iread is filled by is_keep_read_structure()
+  void add_read(const bam1_t *b, const POSCIGAR_st& bm, const RSAI_st& iread,
+		const refseq_st& FASTA);
+};
+
+//! evidence file of region ref:beg-end of msc::bamFile in msc::evidenceDir
+string evidence_file(int ref, int beg, int end);
+
+//! copy the pairs and reads that pass the filters of this run
+void evidence_apply(const evidence_st& ev, int min_pair_length,
+		    pairset_st& pairs, readstore_st& r_MS, readstore_st& r_SM);
+
+//! write ev and the read depth rd to fn, false if it can not be written
+bool evidence_save(const string& fn, int ref, int beg, int end,
+		   const evidence_st& ev, const vector<int32_t>& rd);
+
+/*!
+  @abstract  map the evidence of ref:beg-end and apply the filters of this run
+
+  only the scalar fields of ev are filled, pairs and reads passing the
+  filters go to pairs, r_MS and r_SM and the read depth to rd.
+
+  @return    false if fn is missing, was made from another BAM or reference,
+             or was saved with filters stricter than this run
+*/
+bool evidence_load(const string& fn, int ref, int beg, int end, int min_pair_length,
+		   evidence_st& ev, vector<int32_t>& rd,
+		   pairset_st& pairs, readstore_st& r_MS, readstore_st& r_SM);
+
+#endif
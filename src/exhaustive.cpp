@@ -23,6 +23,13 @@ using namespace std;
 #include "functions.h"
 #include "matchreads.h"
 
+#include "readstore.h"
+#include "pairset.h"
+#include "bamstream.h"
+#include "metrics.h"
+#include "trace.h"
+#include "memtrack.h"
+#include "progress.h"
 #include "preprocess.h"
 #include "pairguide.h"
 #include "exhaustive.h"
@@ -218,14 +225,13 @@ void reduce_matched_break_points(vector<ED_st>& bp, vector<pairinfo_st>& mcbp)
   return;
 }
 
-void compact_reads(vector<bam1_t>& bset)
+void compact_reads(readstore_st& bset)
 {
   /*
     for(size_t i=1; i<bset.size(); ++i) {
-    bool saveaspre=( get_qseq(&bset[i]) == get_qseq(&bset[i-1]) );
-    cerr << b_MS[i].core.pos << "\t" 
-    << get_cigar(&b_MS[i]) << "\t" 
-    << get_qseq(&b_MS[i]) << "\t"
+    bool saveaspre=( bset.get_qseq(i) == bset.get_qseq(i-1) );
+    cerr << bset.pos[i] << "\t" 
+    << bset.get_qseq(i) << "\t"
 	 << saveaspre
 	 << endl;
   }
@@ -234,9 +240,9 @@ void compact_reads(vector<bam1_t>& bset)
   
   vector<size_t> posidx(0);
   vector<int> poss(0);
-  poss.push_back(bset[0].core.pos);
+  poss.push_back(bset.pos[0]);
   for(size_t i=0; i<bset.size(); ++i) {
-    int pos=bset[i].core.pos;
+    int pos=bset.pos[i];
     if ( pos==poss.back() ) continue;
     poss.push_back(pos);
   }
@@ -246,11 +252,11 @@ void compact_reads(vector<bam1_t>& bset)
     posidx.clear();
     map <string, size_t> qseqmap; qseqmap.clear();
     for(size_t j=jstart; j<bset.size(); ++j) {
-      if ( bset[j].core.pos>poss[i] ) break;
+      if ( bset.pos[j]>poss[i] ) break;
       jstart=j;
-      if ( bset[j].core.pos<poss[i] ) continue;
+      if ( bset.pos[j]<poss[i] ) continue;
       posidx.push_back(j);
-      string qseq=get_qseq( &bset[j] );
+      string qseq=bset.get_qseq(j);
       if ( qseqmap.find( qseq ) == qseqmap.end() ) qseqmap[qseq]=1; 
       else qseqmap[qseq]+=1;
     }
@@ -293,16 +299,17 @@ void sampleidx(size_t N, size_t NS, vector<size_t>& id)
 // check_length < 0, check matching among all reads 
 void match_reads_for_exhaustive_search(int thread_id,
 				       int NUM_THREADS,
-				       vector<bam1_t>& b_MS,
-				       vector<bam1_t>& b_SM,
-				       string& FASTA, 
+				       readstore_st& r_MS,
+				       readstore_st& r_SM,
+				       const refseq_st& FASTA, 
 				       int check_length,
 				       vector<ED_st>& ibp)
 //				       vector<ED_st>& bp)
 {
-  ibp.clear();
+  // ibp is shared by all threads and cleared by multithreads_read_matching(),
+  // clearing it here dropped what the threads done first had flushed
   // bp.clear();
-  if ( b_MS.size()<1 || b_SM.size()<1 || FASTA.size()<2 ) return;
+  if ( r_MS.size()<1 || r_SM.size()<1 || FASTA.size()<2 ) return;
   if ( check_length==0 ) return;
   if ( NUM_THREADS<1 ) {
     cerr << "thread error NUM_THREADS=" << NUM_THREADS << endl;
@@ -311,36 +318,41 @@ void match_reads_for_exhaustive_search(int thread_id,
   
   if ( thread_id==0 ) {
     cerr << "matching " 
-	 << b_MS.size() << " X " << b_SM.size()
+	 << r_MS.size() << " X " << r_SM.size()
 	 << " reads within range " << check_length << endl;
   }
 
-  //compact_reads(b_MS); return; 
+  //compact_reads(r_MS); return; 
   // reduce repeated reads
   // not useful, only reduced a few
   
   string readMS,readSM;
+  vector<int> p_err(0); // positions on F2 where mismatch happens
   
   int minOver=msc::minOverlap;
   int maxErr=msc::errMatch;
   size_t m_count=0;
+  // added to the metrics once the thread is done
+  long n_overlap=0, n_hit=0, n_err=0, n_bp=0, n_ed=0, n_adjacent=0;
 
+  // results are flushed to the shared list at 3/4 of bpreserve, the buffer
+  // grows on demand so that small contigs do not pay for a large one
   size_t bpreserve=1000000;
-  vector<ED_st> bp(0); bp.reserve(bpreserve);
+  vector<ED_st> bp(0);
   
   // get indice of reads to be matched; limit reads to msc::maxNR
   vector<size_t> ii,kk;
   if ( check_length<0 ) {     // only skip when in all match mode
-    sampleidx(b_MS.size(), msc::maxMR, ii);
-    sampleidx(b_SM.size(), msc::maxMR, kk);
-    ED_st::linc=max( 1.0, (double)b_MS.size()/(double)msc::maxMR );
-    ED_st::rinc=max( 1.0, (double)b_SM.size()/(double)msc::maxMR );
-    if ( (ii.size()<b_MS.size() || kk.size()<b_SM.size() ) && thread_id==0 ) 
+    sampleidx(r_MS.size(), msc::maxMR, ii);
+    sampleidx(r_SM.size(), msc::maxMR, kk);
+    ED_st::linc=max( 1.0, (double)r_MS.size()/(double)msc::maxMR );
+    ED_st::rinc=max( 1.0, (double)r_SM.size()/(double)msc::maxMR );
+    if ( (ii.size()<r_MS.size() || kk.size()<r_SM.size() ) && thread_id==0 ) 
       cerr << "sampleing " << ii.size() << " x " << kk.size() << " reads" << endl;
   }
   else {
-    sampleidx(b_MS.size(), b_MS.size(), ii);
-    sampleidx(b_SM.size(), b_SM.size(), kk);
+    sampleidx(r_MS.size(), r_MS.size(), ii);
+    sampleidx(r_SM.size(), r_SM.size(), kk);
     ED_st::linc=1.0;
     ED_st::rinc=1.0;
   }
@@ -349,50 +361,53 @@ void match_reads_for_exhaustive_search(int thread_id,
   size_t istart=thread_id*ndiv;
   size_t iend=min(thread_id*ndiv+ndiv, ii.size());
   
-  int imm=b_MS[istart].core.pos/1000000;
+  int imm= istart<iend ? r_MS.pos[ii[istart]]/1000000 : 0;
   size_t kstart=0;
   
   for(size_t si=istart; si<iend; ++si) {
     size_t i=ii[si];
-    if ( b_MS[i].core.pos /1000000 > imm ) {
-      imm=b_MS[i].core.pos /1000000 ;
+    if ( thread_id==0 ) progress_position(r_MS.pos[i]);
+    if ( r_MS.pos[i] /1000000 > imm ) {
+      imm=r_MS.pos[i] /1000000 ;
       pthread_mutex_lock(&nout);
       cerr << "#thread " << thread_id << "\t" 
-	   << string(msc::fp_in->header->target_name[ b_MS[i].core.tid ]) 
-	   << "@" << commify( b_MS[i].core.pos ) 
+	   << string(msc::fp_in->header->target_name[ r_MS.tid ]) 
+	   << "@" << commify( r_MS.pos[i] ) 
 	   << endl; 
       pthread_mutex_unlock(&nout);
     }
     
-    readMS=get_qseq( &b_MS[i] );
+    r_MS.get_qseq(i, readMS);
     
     for(size_t sk=kstart; sk<kk.size(); ++sk ) {
       size_t k=kk[sk];
       if ( check_length > 0 ) {
-	if ( b_SM[k].core.pos + check_length < b_MS[i].core.pos ) {
+	if ( r_SM.pos[k] + check_length < r_MS.pos[i] ) {
 	  kstart=sk+1;
 	  continue;
 	}
-	if ( b_SM[k].core.pos  > b_MS[i].core.pos + check_length ) break;
+	if ( r_SM.pos[k]  > r_MS.pos[i] + check_length ) break;
       }
       
-      readSM=get_qseq( &b_SM[k] );
+      r_SM.get_qseq(k, readSM);
       
       int p1=-1; // 0 based position on F2 where strings begin overlap
-      vector<int> p_err(0); // positions on F2 where mismatch happens
       bool match=false;
       match=string_overlap(readMS, readSM, minOver, maxErr, p1, p_err);
+      ++n_overlap;
       if ( p1<0 || !match ) continue;
+      ++n_hit;
       int cl=readMS.length() > p1+readSM.length() ?   // overlap length
 	readSM.length() : readMS.length() - p1 ;
-      if ( (int)p_err.size()*12 > cl ) continue;
+      if ( (int)p_err.size()*12 > cl ) { ++n_err; continue; }
       
       int F2, R1, e_dis;
       ED_st ipair;
-      get_break_points(FASTA, &b_MS[i], &b_SM[k], p1, p_err, F2, R1, e_dis);
+      get_break_points(FASTA, r_MS, i, r_SM, k, p1, F2, R1, e_dis);
+      ++n_bp;
       int ml=p1+readSM.length();                      // merged length
-      if ( e_dis*15 > ml ) continue;
-      if ( R1-F2==1 ) continue;         // overlapped reads 
+      if ( e_dis*15 > ml ) { ++n_ed; continue; }
+      if ( R1-F2==1 ) { ++n_adjacent; continue; }         // overlapped reads 
       
       size_t pre_found=0;
       if ( check_length < 0 ) pre_found=0;
@@ -420,7 +435,7 @@ void match_reads_for_exhaustive_search(int thread_id,
       
       if ( bp.size()>bpreserve/4*3 ) {
 	sort(bp.begin(), bp.end(), sort_bp);
-	pthread_mutex_lock(&nout);
+	trace_lock(&nout, "wait nout");
 	ibp.insert(ibp.end(), bp.begin(), bp.end() );
 	pthread_mutex_unlock(&nout);
 	m_count+=bp.size();
@@ -444,7 +459,7 @@ void match_reads_for_exhaustive_search(int thread_id,
   
   if ( bp.size()>0 ) {
     sort(bp.begin(), bp.end(), sort_bp);
-    pthread_mutex_lock(&nout);
+    trace_lock(&nout, "wait nout");
     ibp.insert(ibp.end(), bp.begin(), bp.end() );
     pthread_mutex_unlock(&nout);
     m_count+=bp.size();
@@ -454,6 +469,14 @@ void match_reads_for_exhaustive_search(int thread_id,
   // write_ED_st_to_file(bp, tmpfile(thread_id) );
   // bp.clear();
   
+  metric_add(MC_OVERLAP_CALLS, n_overlap);
+  metric_add(MC_OVERLAP_HITS, n_hit);
+  metric_add(MC_OVERLAP_REJECT_ERRORS, n_err);
+  metric_add(MC_BREAKPOINT_CALLS, n_bp);
+  metric_add(MC_BREAKPOINT_REJECT_ED, n_ed);
+  metric_add(MC_BREAKPOINT_REJECT_ADJACENT, n_adjacent);
+  metric_add(MC_MATCHED_PAIRS, n_bp-n_ed-n_adjacent);
+  
   pthread_mutex_lock(&nout);
   cerr << "thread " << thread_id << " returned " << m_count << endl;
   pthread_mutex_unlock(&nout);
@@ -469,81 +492,36 @@ void* multithreads_search_wrapper(void* threadarg)
   
   int thread_id = my_data->thread_id;
   int NUM_THREADS = my_data->NUM_THREADS;
-  vector<bam1_t>* b_MS = my_data->b_MS;
-  vector<bam1_t>* b_SM = my_data->b_SM;
-  string* FASTA = my_data->FASTA;
+  readstore_st* r_MS = my_data->r_MS;
+  readstore_st* r_SM = my_data->r_SM;
+  const refseq_st* FASTA = my_data->FASTA;
   int check_length = my_data->check_length;
   vector<ED_st>* bp = my_data->bp;
   
+  trace_lane(thread_id+1);
+  double t0=wall_time();
   match_reads_for_exhaustive_search(thread_id,
 				    NUM_THREADS,
-				    *b_MS,
-				    *b_SM,
+				    *r_MS,
+				    *r_SM,
 				    *FASTA, 
 				    check_length,
 				    *bp );
+  if ( trace_on() ) 
+    trace_span("matching", "task", t0, wall_time(),
+	       to_string(r_MS->size())+" x "+to_string(r_SM->size()));
   
   pthread_exit((void*) 0);
 }
 
-void* multithreads_calibrate_wrapper(void* threadarg)
-{
-  struct exhaustive_search_thread_data_t *my_data = 
-    (struct exhaustive_search_thread_data_t *) threadarg;
-  
-  int me = my_data->thread_id;
-  int NT = my_data->NUM_THREADS;
-  vector<bam1_t>* b_MS = my_data->b_MS;
-  vector<bam1_t>* b_SM = my_data->b_SM;
-  string* FASTA = my_data->FASTA;
-  
-  for(size_t i=me; i<(*b_MS).size(); i+=NT) calibrate_cigar_pos((*FASTA), &(*b_MS)[i]);
-  for(size_t i=me; i<(*b_SM).size(); i+=NT) calibrate_cigar_pos((*FASTA), &(*b_SM)[i]);
-  
-  pthread_exit((void*) 0);
-}
-
-void multithreads_calibrate(vector<bam1_t>& b_MS, vector<bam1_t>& b_SM, string& FASTA) 
-{
-  if ( FASTA.size()<2 ) return;
-  
-  pthread_attr_t attr;
-  vector<pthread_t> thread_ca(msc::numThreads);
-  vector<exhaustive_search_thread_data_t> thread_ca_arg(msc::numThreads);
-  
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-  
-  for(int i=0; i< msc::numThreads; ++i) {
-    thread_ca_arg[i].thread_id=i;
-    thread_ca_arg[i].NUM_THREADS=msc::numThreads;
-    thread_ca_arg[i].b_MS = &b_MS;
-    thread_ca_arg[i].b_SM = &b_SM;
-    thread_ca_arg[i].FASTA = &FASTA;
-    int rc = pthread_create(&thread_ca[i], 
-			    &attr, 
-			    multithreads_calibrate_wrapper, 
-			    &thread_ca_arg[i] );
-    if (rc) {
-      cerr << "ERROR; return code from pthread_create() is " << rc << endl; 
-      exit(-1);
-    }
-  }
-  for (int i=0; i<msc::numThreads; i++) pthread_join(thread_ca[i], NULL);
-
-  return;
-}
-
-
-void multithreads_read_matching(vector<bam1_t>& b_MS,
-				vector<bam1_t>& b_SM,
-				string& FASTA, 
+//! reads in r_MS and r_SM are calibrated when saved in the store
+void multithreads_read_matching(readstore_st& r_MS,
+				readstore_st& r_SM,
+				const refseq_st& FASTA, 
 				int check_length,
 				vector<ED_st>& bp)
 {
-  if ( b_MS.size()<1 || b_SM.size()<1 || FASTA.size()<5 ) return;
-  
-  multithreads_calibrate(b_MS, b_SM, FASTA) ;
+  if ( r_MS.size()<1 || r_SM.size()<1 || FASTA.size()<5 ) return;
   
   pthread_attr_t attr;
   vector<pthread_t> thread_es(msc::numThreads);
@@ -553,13 +531,13 @@ void multithreads_read_matching(vector<bam1_t>& b_MS,
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
   
   bp.clear();
-  bp.reserve(4000000);
+  bp.reserve( min((size_t)4000000, r_MS.size()+r_SM.size()) );
   
   for(int i=0; i< msc::numThreads; ++i) {
     thread_es_arg[i].thread_id=i;
     thread_es_arg[i].NUM_THREADS=msc::numThreads;
-    thread_es_arg[i].b_MS = &b_MS;
-    thread_es_arg[i].b_SM = &b_SM;
+    thread_es_arg[i].r_MS = &r_MS;
+    thread_es_arg[i].r_SM = &r_SM;
     thread_es_arg[i].FASTA = &FASTA;
     thread_es_arg[i].check_length = check_length;
     thread_es_arg[i].bp = &bp;
@@ -579,23 +557,22 @@ void multithreads_read_matching(vector<bam1_t>& b_MS,
   return;
 }
 
-void get_softclip_reads(int ref, int beg, int end, string& FASTA,
-			vector<bam1_t>& b_MS, vector<bam1_t>& b_SM) 
+void get_softclip_reads(int ref, int beg, int end, const refseq_st& FASTA,
+			readstore_st& r_MS, readstore_st& r_SM) 
 {
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
-  bam1_t ibam;
+  region_iter_t iter=0;
   
-  msc::bdata.reserve(300000000);
-  b_MS.clear();
-  b_SM.clear();
+  r_MS.clear();
+  r_SM.clear();
   
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
+  iter = region_query(ref, beg, end);
   size_t count=0;
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  while( region_read(iter, b)>0 ) {
     if ( b->core.tid != msc::bam_ref ) break;
     if ( b->core.pos > end ) break;
     RSAI_st iread;
+    POSCIGAR_st bm;
     
     count++;
     if ( count%1000000==0 ) 
@@ -604,7 +581,7 @@ void get_softclip_reads(int ref, int beg, int end, string& FASTA,
 	   << "@" << commify(b->core.pos) 
 	   << endl;
     
-    if ( ! is_keep_read(b, FASTA, iread) ) continue;
+    if ( ! is_keep_read(b, FASTA, iread, bm) ) continue;
     
     if ( msc::dumpBam ) {
       bam_aux_append(b, "ns", 'i', 4, (uint8_t*)&iread.S);
@@ -613,43 +590,50 @@ void get_softclip_reads(int ref, int beg, int end, string& FASTA,
       continue;
     }
     
-    _save_read_in_vector(b, ibam, msc::bdata);
-
-    if ( iread.sbeg > iread.pos ) b_MS.push_back(ibam); // type M...S
-    else b_SM.push_back(ibam);  // type S...M
+    if ( iread.sbeg > iread.pos ) r_MS.add(b, bm, FASTA); // type M...S
+    else r_SM.add(b, bm, FASTA);  // type S...M
     
   }
   bam_destroy1(b);
-  bam_iter_destroy(iter);
+  region_destroy(iter);
   
-  cerr << b_MS.size() << "\t" << b_SM.size() << "\t" << msc::bdata.size() << endl;
+  cerr << r_MS.size() << "\t" << r_SM.size() << "\t" << r_MS.data_size()+r_SM.data_size() << endl;
   
   return;
 }
 
-void exhaustive_search(vector<bam1_t>& b_MS, vector<bam1_t>& b_SM,
-		       int min_pair_length, string& FASTA,
+void exhaustive_search(readstore_st& r_MS, readstore_st& r_SM,
+		       int min_pair_length, const refseq_st& FASTA,
 		       vector<pairinfo_st>& mcbp) 
 {
   mcbp.clear();
   
   vector<ED_st> bp(0);
   
-  multithreads_read_matching(b_MS, b_SM, FASTA, min_pair_length, bp);
+  progress_stage(MS_EXHAUSTIVE);
+  double t0=wall_time();
+  multithreads_read_matching(r_MS, r_SM, FASTA, min_pair_length, bp);
+  mem_set(MEM_MATCHES, totalRAM(bp));
   reduce_matched_break_points(bp, mcbp);
+  metric_add(MC_CLIP_CANDIDATES, mcbp.size());
+  metric_time(MS_EXHAUSTIVE, wall_time()-t0);
   cerr << "Done softclips matching\n" << endl;
+  t0=wall_time();
   
   // release memory
   vector<ED_st>(0).swap(bp); 
-  vector<uint8_t> (0).swap(msc::bdata);
-  vector<bam1_t> (0).swap(b_MS);
-  vector<bam1_t> (0).swap(b_SM);
+  r_MS.reset();
+  r_SM.reset();
+  mem_set(MEM_MATCHES, 0);
+  mem_set(MEM_READS, r_MS.totalRAM()+r_SM.totalRAM());
   
   // increase overlap length
   int old_minOverlap = msc::minOverlap;
   msc::minOverlap += msc::minOverlapPlus;  
   
+  progress_stage(MS_VALIDATION);
   for(int i=0; i<(int)mcbp.size(); ++i) {
+    progress_candidates(i, mcbp.size());
     pairinfo_st ibp=mcbp[i];
     
     stat_region(ibp, FASTA, msc::bam_l_qseq);
@@ -661,10 +645,14 @@ void exhaustive_search(vector<bam1_t>& b_MS, vector<bam1_t>& b_SM,
     // if ( mcbp[i].rpscore>=2 && mcbp[i].sr_count>=9 ) continue;
     // too short for reads matching
     if ( abs(mcbp[i].F2-mcbp[i].R1)<msc::bam_l_qseq/2 ) continue;
+    metric_add(MC_VALIDATED);
     
-    string cnv=cnv_format1(mcbp[i]);
-    for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
-    cerr << "checking: " << cnv << endl;
+    string cnv;
+    if ( msc::verbose>0 ) {
+      cnv=cnv_format1(mcbp[i]);
+      for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
+      cerr << "checking: " << cnv << endl;
+    }
     match_reads_for_pairs(ibp, FASTA, -1, true);
     assess_rd_rp_sr_infomation(ibp);
     mcbp[i]=ibp; // update mr info
@@ -679,12 +667,14 @@ void exhaustive_search(vector<bam1_t>& b_MS, vector<bam1_t>& b_SM,
       }
     }
     
-    cnv=mr_format1(ibp);
-    for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
-    cerr << "matched:  " << cnv << endl;
-    cnv=cnv_format1(ibp);
-    for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
-    cerr << "matched:  " << cnv << endl;
+    if ( msc::verbose>0 ) {
+      cnv=mr_format1(ibp);
+      for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
+      cerr << "matched:  " << cnv << endl;
+      cnv=cnv_format1(ibp);
+      for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
+      cerr << "matched:  " << cnv << endl;
+    }
     
     if ( ibp.srscore>0 && 
 	 ibp.rdscore>=mcbp[i].rdscore && 
@@ -695,23 +685,26 @@ void exhaustive_search(vector<bam1_t>& b_MS, vector<bam1_t>& b_SM,
 	 ibp.un<msc::minOverlap &&
 	 bool(ibp.MS_F2>ibp.MS_R1 ) == bool(ibp.F2>ibp.R1 ) ) mcbp[i]=ibp; 
     
-    cnv=cnv_format1(mcbp[i]);
-    for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
-    cerr << "updated:  " << cnv << "\n" << endl;
+    if ( msc::verbose>0 ) {
+      cnv=cnv_format1(mcbp[i]);
+      for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
+      cerr << "updated:  " << cnv << "\n" << endl;
+    }
   }
   
   msc::minOverlap = old_minOverlap ;
+  metric_time(MS_VALIDATION, wall_time()-t0);
   
   return;
 }
 
 void exhaustive_search(int ref, int beg, int end, 
-		       int min_pair_length, string& FASTA,
+		       int min_pair_length, const refseq_st& FASTA,
 		       vector<pairinfo_st>& mcbp) 
 {
   mcbp.clear();
-  vector<bam1_t> b_MS(0), b_SM(0);
-  get_softclip_reads(ref, beg, end, FASTA, b_MS, b_SM) ;
-  exhaustive_search(b_MS, b_SM, min_pair_length, FASTA,  mcbp) ;
+  readstore_st r_MS, r_SM;
+  get_softclip_reads(ref, beg, end, FASTA, r_MS, r_SM) ;
+  exhaustive_search(r_MS, r_SM, min_pair_length, FASTA,  mcbp) ;
   return;
 }
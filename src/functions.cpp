@@ -29,6 +29,8 @@ CONTACT: wu_yinghua@hotmail.com; hongzhe@upenn.edu
 #include <cstring>
 #include <limits>
 #include <algorithm>
+#include <sys/stat.h>
+#include <sys/time.h>
 using namespace std;
 
 #include "functions.h"  // functions defined here
@@ -75,6 +77,22 @@ bool file_exist(string filename)
   else  return(false); 
 }
 
+string file_stamp(string filename)
+{
+  struct stat st;
+  if ( stat(filename.c_str(), &st)!=0 ) return "";
+  ostringstream oss;
+  oss << (long long)st.st_size << "\t" << (long long)st.st_mtime;
+  return oss.str();
+}
+
+double wall_time()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
 bool is_binary(string filename)
 {
   if ( filename=="-" || filename=="STDIN" || filename=="STDOUT" ) return false;
@@ -26,9 +26,16 @@ string get_env_var( std::string const & key );
 /* check if a file exists */
 bool file_exist(string filename) ;
 
+/* size and modification time of a file, "" if not found
+ * used to tell if a file changed since a sidecar was made from it */
+string file_stamp(string filename);
+
 /* check if a file i binary */
 bool is_binary(string filename);
 
+/* wall clock in seconds */
+double wall_time();
+
 /* check information from a pid file, or any file 
  * equivalent to grep $fields file */
 string procpidstatus(string file, string fields);
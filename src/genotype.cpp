@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "matchreads.h"
+#include "readstore.h"
+#include "pairset.h"
+#include "preprocess.h"
+#include "pairguide.h"
+#include "regioncache.h"
+#include "bamstream.h"
+#include "metrics.h"
+#include "progress.h"
+#include "trace.h"
+#include "genotype.h"
+
+//! sites of fn on the targets of the BAM, a DUP has F2>R1 as if called
+static void read_sites(const string& fn, vector<pairinfo_st>& sites)
+{
+  ifstream FIN(fn.c_str());
+  if ( !FIN ) {
+    cerr << fn << " not found" << endl;
+    exit(0);
+  }
+  map<string, int> tid;
+  for(size_t i=0; i<msc::bam_target_name.size(); ++i) tid[ msc::bam_target_name[i] ]=i;
+
+  sites.clear();
+  size_t nskip=0;
+  string line;
+  while ( getline(FIN, line) ) {
+    if ( line=="" || line[0]=='#' ) continue;
+    istringstream is(line);
+    string chr, type;
+    int beg, end;
+    if ( !(is >> chr >> beg >> end >> type) || beg<1 || end<beg ||
+	 tid.find(chr)==tid.end() ) {
+      ++nskip;
+      continue;
+    }
+    pairinfo_st ibp;
+    ibp.tid=tid[chr];
+    ibp.F2=beg-1;
+    ibp.R1=end-1;
+    if ( type=="DUP" ) swap(ibp.F2, ibp.R1);
+    sites.push_back(ibp);
+  }
+  FIN.close();
+  if ( nskip>0 ) cerr << nskip << " lines of " << fn << " skipped, not CHR BEGIN END TYPE of a BAM target" << endl;
+  return;
+}
+
+static bool sort_site(const pairinfo_st& p1, const pairinfo_st& p2)
+{
+  if ( p1.tid != p2.tid ) return p1.tid<p2.tid;
+  return sort_pair_info_output(p1, p2);
+}
+
+//! depth of the merged windows around the sites, msc::rd is 0 elsewhere
+static void site_read_depth(int ref, const vector<pairinfo_st>& sites)
+{
+  int flank=max(GENOTYPE_FLANK, msc::bam_l_qseq*5);
+  int len=msc::fp_in->header->target_len[ref];
+  vector<pair<int, int> > win(0);
+  for(size_t i=0; i<sites.size(); ++i) {
+    int F2=min(sites[i].F2, sites[i].R1);
+    int R1=max(sites[i].F2, sites[i].R1);
+    win.push_back( make_pair(max(0, F2-flank), min(len-1, R1+flank)) );
+  }
+  sort(win.begin(), win.end());
+
+  bam1_t *b=bam_init1();
+  int scanned=-1;     // reads starting up to here are counted already
+  size_t nread=0, nbase=0;
+  for(size_t i=0; i<win.size(); ++i) {
+    int beg=win[i].first, end=win[i].second;
+    while ( i+1<win.size() && win[i+1].first<=end+1 ) end=max(end, win[++i].second);
+    if ( end<=scanned ) continue;
+    nbase+=end-max(beg, scanned+1)+1;
+    region_iter_t iter=region_query(ref, beg, end);
+    while ( region_read(iter, b)>0 ) {
+      if ( b->core.tid != ref ) break;
+      if ( b->core.pos > end ) break;
+      if ( b->core.pos <= scanned ) continue;
+      if ( is_read_count_for_depth(b, 0) ) add_read_depth(b, msc::rd);
+      ++nread;
+    }
+    region_destroy(iter);
+    scanned=end;
+  }
+  bam_destroy1(b);
+  cerr << "read " << commify(nread) << " reads over " << commify(nbase)
+       << " bases around " << sites.size() << " sites" << endl;
+  return;
+}
+
+void genotype_score(int ref, const refseq_st& FASTA, vector<pairinfo_st>& bp)
+{
+  if ( bp.empty() ) return;
+  progress_stage(MS_INGEST);
+  double t0=wall_time();
+  if ( !msc::bam_pe_set_by_user && !msc::bam_pe_genome ) {
+    int F2=min(bp[0].F2, bp[0].R1);
+    get_pairend_info(ref, max(0, F2-GENOTYPE_FLANK*100), F2+GENOTYPE_FLANK*100);
+  }
+  msc::rd.assign(FASTA.size(), 0);
+  site_read_depth(ref, bp);
+  metric_time(MS_INGEST, wall_time()-t0);
+  
+  // reads matching is done with the longer overlap of the validation
+  int old_minOverlap = msc::minOverlap;
+  msc::minOverlap += msc::minOverlapPlus;
+  progress_stage(MS_VALIDATION);
+  t0=wall_time();
+  for(size_t i=0; i<bp.size(); ++i) {
+    progress_candidates(i, bp.size());
+    stat_region(bp[i], FASTA, msc::bam_l_qseq);
+    match_reads_for_pairs(bp[i], FASTA, -1, true);
+    assess_rd_rp_sr_infomation(bp[i]);
+    // only the clips of the pair are matched, the soft clip search is not run
+    bp[i].sr_ed=bp[i].sr_count=SR_UNSCORED;
+    metric_add(MC_VALIDATED);
+  }
+  metric_time(MS_VALIDATION, wall_time()-t0);
+  msc::minOverlap = old_minOverlap;
+  return;
+}
+
+bool is_somatic(const pairinfo_st& n)
+{
+  return n.rpscore<=0 && n.srscore<=0 && n.rdscore<=1;
+}
+
+void genotype_sites(const string& fn)
+{
+  vector<pairinfo_st> sites(0);
+  read_sites(fn, sites);
+  stable_sort(sites.begin(), sites.end(), sort_site);
+  cerr << sites.size() << " sites to genotype from " << fn << endl;
+
+  refseq_st FASTA;
+  for(size_t i0=0, i1=0; i0<sites.size(); i0=i1) {
+    int ref=sites[i0].tid;
+    for(i1=i0; i1<sites.size() && sites[i1].tid==ref; ++i1) ;
+    const string& name=msc::bam_target_name[ref];
+    cerr << "genotyping region:\t" << name << endl;
+    tracespan_st region_span(name.c_str(), "region");
+    msc::bam_ref=ref;
+    regioncache_clear();
+
+    progress_stage(MS_INGEST);
+    double t0=wall_time();
+    if ( msc::bamStream && !bamstream_load(ref, 0, 0x7fffffff) ) continue;
+    metric_time(MS_INGEST, wall_time()-t0);
+
+    progress_stage(MS_REFERENCE);
+    t0=wall_time();
+    load_reference(msc::refFile, name, FASTA, msc::refPacked);
+    if ( msc::refInMemory ) FASTA.materialise();
+    if ( FASTA.size() != msc::fp_in->header->target_len[ref] )
+      cerr << "not exactly the same reference, expected length "
+	   << msc::fp_in->header->target_len[ref] << " loaded " << FASTA.size() << endl;
+    metric_time(MS_REFERENCE, wall_time()-t0);
+
+    vector<pairinfo_st> bp(sites.begin()+i0, sites.begin()+i1);
+    genotype_score(ref, FASTA, bp);
+
+    progress_stage(MS_OUTPUT);
+    t0=wall_time();
+    write_cnv_to_file(bp, msc::outFile);
+    metric_time(MS_OUTPUT, wall_time()-t0);
+  }
+
+  vector<int32_t>(0).swap(msc::rd);
+  return;
+}
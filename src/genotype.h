@@ -0,0 +1,32 @@
+#ifndef _GENOTYPE_H
+#define _GENOTYPE_H
+
+using namespace std;
+#include <string>
+#include <vector>
+
+//! depth is counted this far outside the breakpoints of a site, enough
+//! for the flanks of stat_region() and assess_rd_rp_sr_infomation()
+#define GENOTYPE_FLANK 1000
+
+/*!
+  @abstract  score the known breakpoints listed in fn, -cnv fn
+
+  fn holds CHR BEGIN END TYPE as the first columns, 1 based, as written
+  by matchclips; lines starting with # are skipped. no discovery is run,
+  only the BAM around each site, and between its breakpoints, is read:
+  read depth, read pairs and matching soft clipped reads are scored as
+  in the validation of the exhaustive search. every site is written to
+  -o in the standard columns, sorted by position within each target.
+*/
+void genotype_sites(const string& fn);
+
+//! score the sites bp of target ref in the current BAM, msc::rd is
+//! overwritten with the depth around them
+void genotype_score(int ref, const refseq_st& FASTA, vector<pairinfo_st>& bp);
+
+//! bp scored in the normal of -bn shows no variation: no read pair,
+//! matching reads or depth score beyond RDSCORE 1
+bool is_somatic(const pairinfo_st& n);
+
+#endif
@@ -0,0 +1,249 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "insertsize.h"
+
+//! samples of one read group
+struct insertsample_st {
+  vector<int> isize;
+  double l_sum;
+  size_t l_count;
+  insertsample_st(): l_sum(0), l_count(0) {};
+};
+
+struct insert_thread_data_t {
+  int thread_id;
+  int NUM_THREADS;
+  const char *bamFile;
+  bam_index_t *idx;
+  int minMAPQ;
+  const vector<int> *tid;
+  const vector<int> *pos;
+  map<string, insertsample_st> samples;
+};
+
+//! same filter as get_pairend_info(), each template is counted once
+static bool is_insert_sample(const bam1_t *b, int minMAPQ)
+{
+  if ( (int)b->core.tid < 0 ) return false;
+  if ( b->core.mtid != b->core.tid ) return false;
+  if ( bool(b->core.flag&BAM_FREVERSE) == bool(b->core.flag&BAM_FMREVERSE) ) return false;
+  if ( b->core.flag & BAM_DEF_MASK ) return false;
+  if ( !(b->core.flag & BAM_FPROPER_PAIR) ) return false;
+  if ( (int)b->core.qual < minMAPQ ) return false;
+  return b->core.isize>0;
+}
+
+static void* insert_sample_thread(void *arg)
+{
+  insert_thread_data_t *d=(insert_thread_data_t*) arg;
+  BGZF *fp=bam_open(d->bamFile, "r");
+  if ( fp==NULL ) pthread_exit((void*) 0);
+  bam1_t *b=bam_init1();
+
+  for(size_t s=d->thread_id; s<d->tid->size(); s+=d->NUM_THREADS) {
+    bam_iter_t iter=bam_iter_query(d->idx, (*d->tid)[s], (*d->pos)[s], 0x7fffffff);
+    size_t npair=0, nread=0;
+    while ( npair<INSERT_STRATUM_PAIRS && nread<20*INSERT_STRATUM_PAIRS &&
+	    bam_iter_read(fp, iter, b)>0 ) {
+      ++nread;
+      uint8_t *rg=bam_aux_get(b, "RG");
+      string id= rg ? string(bam_aux2Z(rg)) : string(INSERT_ALL_RG);
+      insertsample_st& smp=d->samples[id];
+      smp.l_sum+=b->core.l_qseq;
+      ++smp.l_count;
+      if ( !is_insert_sample(b, d->minMAPQ) ) continue;
+      smp.isize.push_back(b->core.isize);
+      ++npair;
+    }
+    bam_iter_destroy(iter);
+  }
+
+  bam_destroy1(b);
+  bam_close(fp);
+  pthread_exit((void*) 0);
+}
+
+//! median and inter quartile range as in get_pairend_info()
+static void make_insert_model(const string& rg, insertsample_st& smp,
+			      insertmodel_st& m)
+{
+  m.rg=rg;
+  m.n=smp.isize.size();
+  m.l_qseq= smp.l_count>0 ? (int)(smp.l_sum/smp.l_count+0.5) : 0;
+  m.insert=m.insert_sd=0;
+  if ( m.n<3 ) return;
+  vector<int>& pe=smp.isize;
+  sort(pe.begin(), pe.end());
+  m.insert=pe[ pe.size()/2 ];
+  m.insert_sd=(int)( ( pe[pe.size()/4*3] - pe[pe.size()/4] ) / 1.35 );
+  if ( m.insert_sd<30 ) m.insert_sd=30;
+  if ( m.insert>1000 || m.insert_sd>2*m.insert ) m.insert_sd=m.insert/2;
+  return;
+}
+
+void estimate_insert_models(const string& bamFile, bam_index_t *idx,
+			    const bam_header_t *header, int minMAPQ, int nthreads,
+			    vector<insertmodel_st>& models)
+{
+  models.clear();
+
+  // strata at the middle of INSERT_STRATA equal slices of the genome
+  double G=0;
+  for(int t=0; t<header->n_targets; ++t) G+=header->target_len[t];
+  vector<int> tid(0), pos(0);
+  double g0=0;
+  for(int t=0, k=0; t<header->n_targets && k<INSERT_STRATA; ++t) {
+    double g1=g0+header->target_len[t];
+    for( ; k<INSERT_STRATA && (k+0.5)*G/INSERT_STRATA<g1; ++k) {
+      tid.push_back(t);
+      pos.push_back( (int)( (k+0.5)*G/INSERT_STRATA-g0 ) );
+    }
+    g0=g1;
+  }
+
+  if ( nthreads<1 ) nthreads=1;
+  if ( nthreads>(int)tid.size() ) nthreads=max((size_t)1, tid.size());
+  vector<pthread_t> threads(nthreads);
+  vector<insert_thread_data_t> data(nthreads);
+  for(int i=0; i<nthreads; ++i) {
+    data[i].thread_id=i;
+    data[i].NUM_THREADS=nthreads;
+    data[i].bamFile=bamFile.c_str();
+    data[i].idx=idx;
+    data[i].minMAPQ=minMAPQ;
+    data[i].tid=&tid;
+    data[i].pos=&pos;
+    int rc=pthread_create(&threads[i], NULL, insert_sample_thread, &data[i]);
+    if ( rc ) {
+      cerr << "ERROR; return code from pthread_create() is " << rc << endl;
+      exit(-1);
+    }
+  }
+  for(int i=0; i<nthreads; ++i) pthread_join(threads[i], NULL);
+
+  // merge threads, all reads go to the pooled model as well
+  map<string, insertsample_st> all;
+  insertsample_st& pooled=all[INSERT_ALL_RG];
+  for(int i=0; i<nthreads; ++i) {
+    for(map<string, insertsample_st>::iterator it=data[i].samples.begin();
+	it!=data[i].samples.end(); ++it) {
+      insertsample_st& s=it->second;
+      if ( it->first!=INSERT_ALL_RG ) {
+	insertsample_st& r=all[it->first];
+	r.isize.insert(r.isize.end(), s.isize.begin(), s.isize.end());
+	r.l_sum+=s.l_sum;
+	r.l_count+=s.l_count;
+      }
+      pooled.isize.insert(pooled.isize.end(), s.isize.begin(), s.isize.end());
+      pooled.l_sum+=s.l_sum;
+      pooled.l_count+=s.l_count;
+    }
+  }
+
+  models.resize(1);
+  make_insert_model(INSERT_ALL_RG, pooled, models[0]);
+  for(map<string, insertsample_st>::iterator it=all.begin(); it!=all.end(); ++it) {
+    if ( it->first==INSERT_ALL_RG ) continue;
+    insertmodel_st m;
+    make_insert_model(it->first, it->second, m);
+    models.push_back(m);
+  }
+  return;
+}
+
+//! sidecar format, the first model is the pooled one
+//!   #bam <size> <mtime> <minMAPQ>
+//!   <rg> <n> <l_qseq> <insert> <insert_sd>
+static bool read_insert_sidecar(const string& bamFile, const string& key,
+				vector<insertmodel_st>& models)
+{
+  models.clear();
+  ifstream FIN( (bamFile+INSERT_SUFFIX).c_str() );
+  if ( !FIN ) return false;
+  string tmps;
+  getline(FIN, tmps);
+  if ( tmps!=key ) return false;
+  while ( getline(FIN, tmps) ) {
+    istringstream iss(tmps);
+    insertmodel_st m;
+    if ( !(iss >> m.rg >> m.n >> m.l_qseq >> m.insert >> m.insert_sd) ) return false;
+    models.push_back(m);
+  }
+  return models.size()>0 && models[0].rg==INSERT_ALL_RG;
+}
+
+//! write to a temporary file and rename, readers never see a partial file
+static void write_insert_sidecar(const string& bamFile, const string& key,
+				 const vector<insertmodel_st>& models)
+{
+  string fn=bamFile+INSERT_SUFFIX;
+  ostringstream tmpfn;
+  tmpfn << fn << "." << getpid();
+  ofstream FOUT(tmpfn.str().c_str());
+  if ( !FOUT ) return;
+  FOUT << key << "\n";
+  for(size_t i=0; i<models.size(); ++i)
+    FOUT << models[i].rg << "\t" << models[i].n << "\t" << models[i].l_qseq << "\t"
+	 << models[i].insert << "\t" << models[i].insert_sd << "\n";
+  FOUT.close();
+  if ( !FOUT || rename(tmpfn.str().c_str(), fn.c_str())!=0 )
+    remove(tmpfn.str().c_str());
+  return;
+}
+
+bool load_insert_models(const string& bamFile, bam_index_t *idx,
+			const bam_header_t *header, int minMAPQ, int nthreads,
+			vector<insertmodel_st>& models)
+{
+  string stamp=file_stamp(bamFile);
+  if ( stamp=="" ) return false;
+  string key="#bam\t"+stamp+"\t"+to_string(minMAPQ);
+  if ( read_insert_sidecar(bamFile, key, models) ) {
+    cerr << "insert size models read from " << bamFile << INSERT_SUFFIX << endl;
+    return true;
+  }
+
+  bam_index_t *myidx=NULL;
+  BGZF *fp=NULL;
+  bam_header_t *myheader=NULL;
+  if ( idx==NULL ) idx=myidx=bam_index_load(bamFile.c_str());
+  if ( header==NULL ) {
+    fp=bam_open(bamFile.c_str(), "r");
+    if ( fp ) header=myheader=bam_header_read(fp);
+  }
+  if ( idx && header ) {
+    estimate_insert_models(bamFile, idx, header, minMAPQ, nthreads, models);
+    write_insert_sidecar(bamFile, key, models);
+  }
+  if ( myheader ) bam_header_destroy(myheader);
+  if ( fp ) bam_close(fp);
+  if ( myidx ) bam_index_destroy(myidx);
+
+  return models.size()>0 && models[0].l_qseq>0;
+}
+
+const insertmodel_st& widest_insert_model(const vector<insertmodel_st>& models, int k)
+{
+  size_t w=0;
+  for(size_t i=1; i<models.size(); ++i)
+    if ( models[i].n>0 && models[i].upper(k)>models[w].upper(k) ) w=i;
+  return models[w];
+}
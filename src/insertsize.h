@@ -0,0 +1,68 @@
+#ifndef _INSERTSIZE_H
+#define _INSERTSIZE_H
+
+using namespace std;
+#include <string>
+#include <vector>
+#include <bam.h>
+
+//! models are cached in BAMFILE+INSERT_SUFFIX
+#define INSERT_SUFFIX ".mcins"
+//! genome is sampled at INSERT_STRATA evenly spaced positions
+#define INSERT_STRATA 128
+//! proper pairs sampled per stratum
+#define INSERT_STRATUM_PAIRS 2000
+//! name of the model pooled over all read groups
+#define INSERT_ALL_RG "*"
+
+/*!
+  @abstract insert size and read length of one read group
+
+  @field  rg         read group id, INSERT_ALL_RG for all reads
+  @field  n          number of proper pairs sampled
+  @field  l_qseq     mean read length
+  @field  insert     median insert size
+  @field  insert_sd  inter quartile range / 1.35
+*/
+struct insertmodel_st {
+  string rg;
+  size_t n;
+  int l_qseq;
+  int insert;
+  int insert_sd;
+
+  insertmodel_st(): rg(""), n(0), l_qseq(0), insert(0), insert_sd(0) {};
+  //! largest insert of a normal pair, insert+k*sd
+  int upper(int k) const { return insert+k*insert_sd; }
+};
+
+/*!
+  @abstract  estimate insert size models from strata across the genome
+
+  proper pairs with mapq>=minMAPQ are sampled from INSERT_STRATA positions
+  spread over all targets in proportion to their length, nthreads threads
+  read the strata through their own BAM handles. one model is made for
+  each read group and one for all reads, which is the first.
+*/
+void estimate_insert_models(const string& bamFile, bam_index_t *idx,
+			    const bam_header_t *header, int minMAPQ, int nthreads,
+			    vector<insertmodel_st>& models);
+
+/*!
+  @abstract  get the insert size models of bamFile
+
+  models are read from the sidecar bamFile.mcins if it was made from the
+  same version of bamFile with the same minMAPQ, otherwise they are
+  estimated and the sidecar is rewritten. idx and header may be NULL,
+  then they are loaded if an estimate is needed.
+
+  @return    false if no model could be made
+*/
+bool load_insert_models(const string& bamFile, bam_index_t *idx,
+			const bam_header_t *header, int minMAPQ, int nthreads,
+			vector<insertmodel_st>& models);
+
+//! model of the read group with the largest insert+k*sd
+const insertmodel_st& widest_insert_model(const vector<insertmodel_st>& models, int k);
+
+#endif
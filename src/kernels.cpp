@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <new>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "samfunctions.h"
+#include "functions.h"
+#include "matchreads.h"
+
+#include "readstore.h"
+#include "pairset.h"
+#include "preprocess.h"
+
+#include "mcbench.h"
+#include "kernels.h"
+
+// every operator new of mcbench is counted, the kernels run on one thread
+// kept out of line so the malloc is not paired with delete by the compiler
+static size_t bench_nalloc=0;
+
+__attribute__((noinline)) void* operator new(size_t n)
+{
+  ++bench_nalloc;
+  void *p=malloc(n ? n : 1);
+  if ( p==NULL ) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) throw()
+{
+  free(p);
+}
+
+/*!
+  @abstract inputs of the kernels, prepared once from the reads
+
+  @field  reads    all reads of the fixture
+  @field  MS, SM   sequences of the reads kept by is_keep_read()
+  @field  tried    MS and SM reads within KERNELS_WINDOW
+  @field  matched  tried pairs that string_overlap() accepts, with p1
+  @field  bps      break points found by get_break_points()
+*/
+struct corpus_st {
+  const refseq_st *FASTA;
+  vector<bam1_t*> reads;
+  readstore_st r_MS, r_SM;
+  vector<string> MS, SM;
+  vector<pair<size_t, size_t> > tried;
+  vector<pair<size_t, size_t> > matched;
+  vector<int> p1;
+  vector<pair<int, int> > bps;
+};
+
+// keeps the results alive so the calls are not optimised away
+static volatile long bench_sink=0;
+
+static size_t kernel_resolve_cigar_pos(corpus_st& c)
+{
+  POSCIGAR_st m;
+  for(size_t i=0; i<c.reads.size(); ++i) {
+    resolve_cigar_pos(c.reads[i], m, 0);
+    bench_sink+=m.pos;
+  }
+  return c.reads.size();
+}
+
+//! the read is copied first, calibrate_cigar_pos() changes it
+static size_t kernel_calibrate_cigar_pos(corpus_st& c)
+{
+  bam1_t *b=bam_init1();
+  size_t n=0;
+  for(size_t i=0; i<c.reads.size(); ++i) {
+    if ( c.reads[i]->core.n_cigar<2 ) continue;
+    bam_copy1(b, c.reads[i]);
+    bench_sink+=calibrate_cigar_pos(*c.FASTA, b);
+    ++n;
+  }
+  bam_destroy1(b);
+  return n;
+}
+
+static size_t kernel_is_keep_read(corpus_st& c)
+{
+  RSAI_st iread;
+  POSCIGAR_st bm;
+  for(size_t i=0; i<c.reads.size(); ++i)
+    bench_sink+=is_keep_read(c.reads[i], *c.FASTA, iread, bm);
+  return c.reads.size();
+}
+
+static size_t kernel_string_overlap(corpus_st& c)
+{
+  vector<int> p_err(0);
+  int p1;
+  for(size_t i=0; i<c.tried.size(); ++i) {
+    bench_sink+=string_overlap(c.MS[c.tried[i].first], c.SM[c.tried[i].second],
+			       msc::minOverlap, msc::errMatch, p1, p_err);
+    bench_sink+=p1;
+  }
+  return c.tried.size();
+}
+
+static size_t kernel_get_break_points(corpus_st& c)
+{
+  int F2, R1, e_dis;
+  for(size_t i=0; i<c.matched.size(); ++i) {
+    get_break_points(*c.FASTA, c.r_MS, c.matched[i].first, c.r_SM, c.matched[i].second,
+		     c.p1[i], F2, R1, e_dis);
+    bench_sink+=F2+R1+e_dis;
+  }
+  return c.matched.size();
+}
+
+static size_t kernel_find_displacement(corpus_st& c)
+{
+  int dx_F2, dx_R1;
+  for(size_t i=0; i<c.bps.size(); ++i) {
+    find_displacement(*c.FASTA, c.bps[i].first, c.bps[i].second, dx_F2, dx_R1);
+    bench_sink+=dx_F2+dx_R1;
+  }
+  return c.bps.size();
+}
+
+//! the inputs of the later kernels are the outputs of the earlier ones
+static void prepare_corpus(corpus_st& c)
+{
+  RSAI_st iread;
+  POSCIGAR_st bm;
+  for(size_t i=0; i<c.reads.size(); ++i) {
+    if ( !is_keep_read(c.reads[i], *c.FASTA, iread, bm) ) continue;
+    if ( iread.sbeg > iread.pos ) c.r_MS.add(c.reads[i], bm, *c.FASTA);
+    else c.r_SM.add(c.reads[i], bm, *c.FASTA);
+  }
+  for(size_t i=0; i<c.r_MS.size(); ++i) c.MS.push_back( c.r_MS.get_qseq(i) );
+  for(size_t k=0; k<c.r_SM.size(); ++k) c.SM.push_back( c.r_SM.get_qseq(k) );
+
+  size_t kstart=0;
+  for(size_t i=0; i<c.r_MS.size(); ++i) {
+    while ( kstart<c.r_SM.size() && c.r_SM.pos[kstart]+KERNELS_WINDOW < c.r_MS.pos[i] ) ++kstart;
+    for(size_t k=kstart; k<c.r_SM.size(); ++k) {
+      if ( c.r_SM.pos[k] > c.r_MS.pos[i]+KERNELS_WINDOW ) break;
+      c.tried.push_back( make_pair(i, k) );
+    }
+  }
+
+  vector<int> p_err(0);
+  for(size_t t=0; t<c.tried.size(); ++t) {
+    int p1;
+    const string& a=c.MS[c.tried[t].first];
+    const string& b=c.SM[c.tried[t].second];
+    if ( !string_overlap(a, b, msc::minOverlap, msc::errMatch, p1, p_err) || p1<0 ) continue;
+    c.matched.push_back(c.tried[t]);
+    c.p1.push_back(p1);
+    int F2, R1, e_dis;
+    get_break_points(*c.FASTA, c.r_MS, c.tried[t].first, c.r_SM, c.tried[t].second,
+		     p1, F2, R1, e_dis);
+    if ( F2>0 && R1>0 ) c.bps.push_back( make_pair(F2, R1) );
+  }
+  return;
+}
+
+/*!
+  @abstract  reads of the first target of bamFile, or of region, up to n
+
+  with fixture the reads are also written there as a BAM, later runs
+  read the fixture as bamFile.
+*/
+static void load_reads(const string& bamFile, const string& region, size_t n,
+		       const string& fixture, vector<bam1_t*>& reads, string& target)
+{
+  samfile_t *in=samopen(bamFile.c_str(), "rb", 0);
+  if ( !in ) {
+    cerr << bamFile << " not found!" << endl;
+    exit(0);
+  }
+  samfile_t *out=NULL;
+  if ( fixture!="" ) {
+    out=samopen(fixture.c_str(), "wb", in->header);
+    if ( !out ) {
+      cerr << "cannot write " << fixture << endl;
+      exit(0);
+    }
+  }
+  bam_index_t *idx=NULL;
+  bam_iter_t iter=NULL;
+  if ( region!="" ) {
+    int ref=-1, beg=0, end=0x7fffffff;
+    idx=bam_index_load(bamFile.c_str());
+    if ( !idx ) {
+      cerr << bamFile << " idx not found!" << endl;
+      exit(0);
+    }
+    if ( bam_parse_region(in->header, region.c_str(), &ref, &beg, &end)<0 || ref<0 ) {
+      cerr << "bad region " << region << endl;
+      exit(0);
+    }
+    iter=bam_iter_query(idx, ref, beg, end);
+  }
+
+  bam1_t *b=bam_init1();
+  int tid=-1;
+  while ( reads.size()<n ) {
+    int r= iter ? bam_iter_read(in->x.bam, iter, b) : samread(in, b);
+    if ( r<0 ) break;
+    if ( b->core.tid<0 ) continue;
+    if ( tid<0 ) tid=b->core.tid;
+    if ( b->core.tid!=tid ) break;
+    reads.push_back( bam_dup1(b) );
+    if ( out ) samwrite(out, b);
+  }
+  bam_destroy1(b);
+  if ( tid>=0 ) target=in->header->target_name[tid];
+  msc::bam_ref=tid;
+
+  if ( iter ) bam_iter_destroy(iter);
+  if ( idx ) bam_index_destroy(idx);
+  if ( out ) {
+    samclose(out);
+    bam_index_build(fixture.c_str());
+    cerr << reads.size() << " reads written to " << fixture << endl;
+  }
+  samclose(in);
+  return;
+}
+
+//! ns/op of each kernel in a table written by an earlier run
+static void read_base(const string& fn, map<string, double>& base)
+{
+  ifstream FIN(fn.c_str());
+  if ( !FIN ) {
+    cerr << fn << " not found" << endl;
+    exit(0);
+  }
+  string line;
+  while ( getline(FIN, line) ) {
+    if ( line=="" || line[0]=='#' ) continue;
+    istringstream is(line);
+    string name;
+    size_t ops;
+    double ns;
+    if ( is >> name >> ops >> ns ) base[name]=ns;
+  }
+  return;
+}
+
+int usage_bench_kernels(int argc, char* argv[]) {
+  cerr << "This subroutine times the read matching and CIGAR kernels on a\n"
+       << "fixed set of reads. The reads of one target are taken from the BAM,\n"
+       << "kept as a small BAM fixture with -w, and used as given afterwards.\n"
+       << "ns/op, operator new calls/op and ops/s of each kernel are printed\n"
+       << "as a table, which can be given to -base by a later run.\n"
+       << "\nUsage:\n"
+       << "  " << argv[0] << " " << argv[1] << " <options> -f REFFILE -b BAMFILE\n"
+       << "\nOptions:\n"
+       << "  -r  STR  region of BAMFILE, default the first target\n"
+       << "  -n  INT  number of reads, default " << KERNELS_READS << "\n"
+       << "  -w  STR  also write the reads to the fixture STR\n"
+       << "  -R  INT  rounds, default 5\n"
+       << "  -base STR  compare with the table of an earlier run\n"
+       << "\nExamples:\n"
+       << "  " << argv[0] << " simbam -o sim\n"
+       << "  " << argv[0] << " " << argv[1] << " -f sim.fa -b sim.bam -w kernels.bam > before.tsv\n"
+       << "  " << argv[0] << " " << argv[1] << " -f sim.fa -b kernels.bam -base before.tsv\n"
+       << endl;
+
+  return(0);
+}
+
+int bench_kernels(int argc, char* argv[])
+{
+  string refFile="", bamFile="", region="", fixture="", baseFile="";
+  size_t nread=KERNELS_READS;
+  int rounds=5;
+
+  for(int i=2; i<argc; ++i) {
+    string a=argv[i];
+    if ( i+1>=argc ) exit( usage_bench_kernels(argc, argv) );
+    if ( a=="-f" ) refFile=argv[++i];
+    else if ( a=="-b" ) bamFile=argv[++i];
+    else if ( a=="-r" ) region=argv[++i];
+    else if ( a=="-n" ) nread=atol(argv[++i]);
+    else if ( a=="-w" ) fixture=argv[++i];
+    else if ( a=="-R" ) rounds=atoi(argv[++i]);
+    else if ( a=="-base" ) baseFile=argv[++i];
+    else exit( usage_bench_kernels(argc, argv) );
+  }
+  if ( refFile=="" || bamFile=="" || nread<1 || rounds<1 )
+    exit( usage_bench_kernels(argc, argv) );
+  msc::verbose=0;
+
+  corpus_st c;
+  string target;
+  load_reads(bamFile, region, nread, fixture, c.reads, target);
+  if ( c.reads.empty() ) {
+    cerr << "no reads in " << bamFile << endl;
+    exit(0);
+  }
+  msc::bam_l_qseq=c.reads[0]->core.l_qseq;
+
+  refseq_st FASTA;
+  load_reference(refFile, target, FASTA);
+  FASTA.materialise();
+  c.FASTA=&FASTA;
+  prepare_corpus(c);
+
+  cerr << "reads\t" << commify(c.reads.size()) << " of " << target << "\n"
+       << "kept\t" << c.r_MS.size() << " MS, " << c.r_SM.size() << " SM\n"
+       << "pairs\t" << commify(c.tried.size()) << " tried, "
+       << commify(c.matched.size()) << " matched, "
+       << commify(c.bps.size()) << " break points\n"
+       << "rounds\t" << rounds << endl;
+
+  map<string, double> base;
+  if ( baseFile!="" ) read_base(baseFile, base);
+
+  struct { const char *name; size_t (*run)(corpus_st&); } kernels[]={
+    { "resolve_cigar_pos", kernel_resolve_cigar_pos },
+    { "calibrate_cigar_pos", kernel_calibrate_cigar_pos },
+    { "is_keep_read", kernel_is_keep_read },
+    { "string_overlap", kernel_string_overlap },
+    { "get_break_points", kernel_get_break_points },
+    { "find_displacement", kernel_find_displacement }
+  };
+
+  cout << "#kernel\tops\tns_per_op\tallocs_per_op\tops_per_s";
+  if ( baseFile!="" ) cout << "\tspeedup";
+  cout << "\n";
+  for(size_t k=0; k<sizeof(kernels)/sizeof(kernels[0]); ++k) {
+    kernels[k].run(c);   // warm up caches and buffers
+    size_t ops=0, nalloc=bench_nalloc;
+    double t0=bench_now();
+    for(int r=0; r<rounds; ++r) ops+=kernels[k].run(c);
+    double t=bench_now()-t0;
+    nalloc=bench_nalloc-nalloc;
+    double ns= ops>0 ? t*1e9/ops : 0;
+    cout << kernels[k].name << "\t" << ops << "\t"
+	 << fixed << setprecision(1) << ns << "\t"
+	 << setprecision(2) << ( ops>0 ? (double)nalloc/ops : 0 ) << "\t"
+	 << setprecision(0) << ( t>0 ? ops/t : 0 );
+    if ( baseFile!="" ) {
+      if ( base.count(kernels[k].name) && ns>0 )
+	cout << "\t" << setprecision(2) << base[kernels[k].name]/ns;
+      else cout << "\tNA";
+    }
+    cout << "\n";
+  }
+  cout.unsetf(ios::fixed);
+
+  for(size_t i=0; i<c.reads.size(); ++i) bam_destroy1(c.reads[i]);
+  return 0;
+}
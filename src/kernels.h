@@ -0,0 +1,11 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+//! reads kept from a BAM for the kernels, the fixture is a BAM of them
+#define KERNELS_READS 200000
+//! MS and SM reads closer than this are tried by string_overlap
+#define KERNELS_WINDOW 500
+
+int bench_kernels(int argc, char* argv[]);
+
+#endif
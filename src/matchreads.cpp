@@ -20,10 +20,26 @@ using namespace std;
 /**** user headers ****/
 #include "functions.h"
 #include "readref.h"
+#include "nregion.h"
 #include "matchreads.h"
+#include "readstore.h"
+#include "pairset.h"
 #include "preprocess.h"
 #include "exhaustive.h"
 #include "pairguide.h"
+#include "regioncache.h"
+#include "bamstream.h"
+#include "shard.h"
+#include "writer.h"
+#include "tabix.h"
+#include "metrics.h"
+#include "trace.h"
+#include "memtrack.h"
+#include "progress.h"
+#include "checkpoint.h"
+#include "genotype.h"
+#include "prefetch.h"
+#include "insertsize.h"
 //#include "statcnv.h"
 
 
@@ -42,11 +58,25 @@ ofstream msc::fout;
 string msc::mycommand="";
 string msc::execinfo="";
 string msc::bamFile="";
+string msc::normalFile="";
+bool msc::bamStream=false;
+int msc::shardIndex=0;
+int msc::shardCount=0;
 vector<string> msc::bamRegion(0);
 string msc::refFile="";
+bool msc::refInMemory=false;
+bool msc::refPacked=false;
+string msc::evidenceDir="";
 string msc::cnvFile="";
 string msc::outFile="STDOUT";
+bool msc::outCompress=false;
+bool msc::outVcf=false;
 string msc::logFile="";
+string msc::metricsFile="";
+string msc::traceFile="";
+string msc::statusFile="";
+bool msc::resume=false;
+size_t msc::memBudget=0;
 string msc::function="";
 int msc::verbose=0;
 int msc::numThreads=1;
@@ -67,6 +97,9 @@ int msc::bam_l_qseq=0;
 bool msc::bam_is_paired=false;
 bool msc::bam_pe_disabled=false;
 bool msc::bam_pe_set_by_user=false;
+bool msc::bam_pe_shared=false;
+bool msc::bam_pe_genome=false;
+bool msc::bam_pe_region=false;
 int msc::bam_pe_insert=500;
 int msc::bam_pe_insert_sd=100;
 int msc::bam_rd=0;
@@ -75,7 +108,6 @@ int msc::bam_tid=-1;        //! if msc::tid>0 only process msc::tid
 string msc::chr="chr";
 string msc::FASTA="";
 vector<string> msc::bam_target_name(0);
-vector<uint8_t> msc::bdata(0); 
 vector<uint8_t> msc::bpdata(0); 
 vector<int32_t> msc::rd(0); 
 samfile_t *msc::fp_in = NULL;
@@ -140,9 +172,9 @@ string mr_format1(pairinfo_st &ibp)
      << bp.R1_sr << ";"
      << bp.MS_ED << ":"
      << bp.srscore << " "
-     << "SR:"
-     << bp.sr_ed << ";"
-     << bp.sr_count;
+     << "SR:";
+  if ( bp.sr_count==SR_UNSCORED ) ss << ".;.";
+  else ss << bp.sr_ed << ";" << bp.sr_count;
   
   return ss.str() ;
 }
@@ -183,16 +215,9 @@ string cnv_format1()
   return ss.str();
 }
 
-string cnv_format1(pairinfo_st &bp1)
+//! left side first, as the calls are printed
+static void orient_cnv(pairinfo_st& bp)
 {
-  std::stringstream ss;
-  pairinfo_st bp=bp1;
-  
-  string RNAME="chr";
-  if ( bp.tid>=0 && bp.tid<(int)msc::bam_target_name.size() )
-    RNAME=msc::bam_target_name[bp.tid];
-  string TYPE= bp.F2 < bp.R1 ? "DEL" : "DUP";
-  int len=bp.R1-bp.F2;
   if ( bp.F2>bp.R1 ) { 
     swap(bp.F2, bp.R1);
     swap(bp.F2_rd, bp.R1_rd);
@@ -201,60 +226,108 @@ string cnv_format1(pairinfo_st &bp1)
     swap(bp.F2_rp, bp.R1_rp);
     swap(bp.F2_sr, bp.R1_sr);
   }
+  return;
+}
+
+static const char* cnv_rname(const pairinfo_st& bp)
+{
+  if ( bp.tid>=0 && bp.tid<(int)msc::bam_target_name.size() )
+    return msc::bam_target_name[bp.tid].c_str();
+  return "chr";
+}
+
+//! sr_ed and sr_count split by sep, . for a site not searched for soft clips
+static void append_sr(string& s, const pairinfo_st& bp, char sep)
+{
+  if ( bp.sr_count==SR_UNSCORED ) {
+    s+='.'; s+=sep; s+='.';
+    return;
+  }
+  append_int(s, bp.sr_ed); s+=sep;
+  append_int(s, bp.sr_count);
+}
+
+void cnv_format1(const pairinfo_st &bp1, string& s)
+{
+  pairinfo_st bp=bp1;
   
-  ss << RNAME << "\t" 
-     << bp.F2+1 << "\t" 
-     << bp.R1+1 << "\t" 
-     << TYPE << "\t"
-     << len << "\t"
-     << "UN:" << bp.un << "\t"
-     << "RD100:" 
-     << bp.F2_rd_100 << ";"
-     << bp.rd_F2_100 << ";"
-     << bp.rd_R1_100 << ";"
-     << bp.R1_rd_100 << ":"
-     << bp.ddscore << "\t"
-     << "RD:"
-     << bp.F2_rd << ";"
-     << bp.R1_rd << ";"
-     << bp.rd << ":"
-     << bp.rdscore << "\t"
-     << "RP:"
-     << bp.F2_rp << ";"
-     << bp.R1_rp << ";"
-     << bp.FRrp << ":"
-     << bp.rpscore << "\t"
-     << "MR:"
-     << bp.F2_sr << ";"
-     << bp.R1_sr << ";"
-     << bp.MS_ED << ":"
-     << bp.srscore << "\t"
-     << "SR:"
-     << bp.sr_ed << ";"
-     << bp.sr_count;
-  // << bp.sr_count << "\t"
-  // << BPMARKER ;
+  const char *RNAME=cnv_rname(bp);
+  const char *TYPE= bp.F2 < bp.R1 ? "DEL" : "DUP";
+  int len=bp.R1-bp.F2;
+  orient_cnv(bp);
   
-  return ss.str() ;
+  s.append(RNAME); s+='\t';
+  append_int(s, bp.F2+1); s+='\t';
+  append_int(s, bp.R1+1); s+='\t';
+  s.append(TYPE); s+='\t';
+  append_int(s, len); s+='\t';
+  s.append("UN:"); append_int(s, bp.un); s+='\t';
+  s.append("RD100:");
+  append_int(s, bp.F2_rd_100); s+=';';
+  append_int(s, bp.rd_F2_100); s+=';';
+  append_int(s, bp.rd_R1_100); s+=';';
+  append_int(s, bp.R1_rd_100); s+=':';
+  append_int(s, bp.ddscore); s+='\t';
+  s.append("RD:");
+  append_int(s, bp.F2_rd); s+=';';
+  append_int(s, bp.R1_rd); s+=';';
+  append_int(s, bp.rd); s+=':';
+  append_int(s, bp.rdscore); s+='\t';
+  s.append("RP:");
+  append_int(s, bp.F2_rp); s+=';';
+  append_int(s, bp.R1_rp); s+=';';
+  append_int(s, bp.FRrp); s+=':';
+  append_int(s, bp.rpscore); s+='\t';
+  s.append("MR:");
+  append_int(s, bp.F2_sr); s+=';';
+  append_int(s, bp.R1_sr); s+=';';
+  append_int(s, bp.MS_ED); s+=':';
+  append_int(s, bp.srscore); s+='\t';
+  s.append("SR:");
+  append_sr(s, bp, ';');
+  
+  return;
 }
 
-string cnv_format_all(pairinfo_st &bp1)
+string cnv_format1(pairinfo_st &bp1)
 {
-  std::stringstream ss;
+  string s;
+  cnv_format1(bp1, s);
+  return s;
+}
+
+void check_map_quality(pairinfo_st& bp)
+{
+  if ( bp.Q0>=0 ) return;
   
-  int F2=bp1.F2;
-  int R1=bp1.R1;
+  int F2=bp.F2;
+  int R1=bp.R1;
   if ( F2> R1 ) swap(F2, R1);
   
   double q0, q10;
-  check_map_quality(bp1.tid, F2, R1, q0, q10);  
+  check_map_quality(bp.tid, F2, R1, q0, q10);  
   
-  int i0=q0*100+0.5;
-  int i10=q10*100+0.5;
-  
-  ss << cnv_format1(bp1) << "\tQ0:" << i0 << ";" << i10;
+  bp.Q0=q0*100+0.5;
+  bp.Q10=q10*100+0.5;
+  return;
+}
+
+void cnv_format_all(pairinfo_st &bp1, string& s)
+{
+  check_map_quality(bp1);
   
-  return ss.str() ;
+  cnv_format1(bp1, s);
+  s.append("\tQ0:");
+  append_int(s, bp1.Q0); s+=';';
+  append_int(s, bp1.Q10);
+  return;
+}
+
+string cnv_format_all(pairinfo_st &bp1)
+{
+  string s;
+  cnv_format_all(bp1, s);
+  return s;
 }
 
 void write_cnv_to_file(vector<pairinfo_st>& bp)
@@ -263,31 +336,276 @@ void write_cnv_to_file(vector<pairinfo_st>& bp)
   return;
 }
 
-void write_cnv_to_file(vector<pairinfo_st>& bp, string fn)
+//! columns added by -bn
+static string cnv_format_normal()
 {
-  static vector<string> files(0);
-  if ( fn=="STDOUT" ) {
-    for(size_t i=0;i<bp.size();++i) cout << cnv_format_all(bp[i]) << endl;
-    return;
+  std::stringstream ss;
+  ss << "\t" << "NORMAL_READDEPTH:" << "LSIDE;RSIDE;BETWEEN:RDSCORE"
+     << "\t" << "NORMAL_READPAIR:" << "CROSSL;CROSSR;ENVELOPEBOTH:RPSCORE"
+     << "\t" << "NORMAL_MATCHINGREADS:" << "LSIDE;RSIDE;EDITDISTANCE:MRSCORE"
+     << "\t" << "NORMAL_SPLITREAD:#;#"
+     << "\t" << "SOMATIC";
+  return ss.str();
+}
+
+//! append the scores of the call in the normal, n1 is oriented as the call
+static void cnv_format_normal(const pairinfo_st &n1, string& s)
+{
+  pairinfo_st n=n1;
+  orient_cnv(n);
+  s.append("\tNRD:");
+  append_int(s, n.F2_rd); s+=';';
+  append_int(s, n.R1_rd); s+=';';
+  append_int(s, n.rd); s+=':';
+  append_int(s, n.rdscore); s+='\t';
+  s.append("NRP:");
+  append_int(s, n.F2_rp); s+=';';
+  append_int(s, n.R1_rp); s+=';';
+  append_int(s, n.FRrp); s+=':';
+  append_int(s, n.rpscore); s+='\t';
+  s.append("NMR:");
+  append_int(s, n.F2_sr); s+=';';
+  append_int(s, n.R1_sr); s+=';';
+  append_int(s, n.MS_ED); s+=':';
+  append_int(s, n.srscore); s+='\t';
+  s.append("NSR:");
+  append_sr(s, n, ';'); s+='\t';
+  s.append(is_somatic(n) ? "SOMATIC:1" : "SOMATIC:0");
+  return;
+}
+
+//! calls kept for -oz and -vcf by output file, written sorted at the end,
+//! with their scores in the normal of -bn
+static map<string, vector<pairinfo_st> > kept_cnv;
+static map<string, vector<pairinfo_st> > kept_normal;
+
+//! records are formatted here, Q0 needs the BAM, and written by the writer thread
+void write_cnv_to_file(vector<pairinfo_st>& bp, string fn, 
+		       const vector<pairinfo_st>* normal)
+{
+  if ( msc::outCompress || msc::outVcf ) {
+    vector<pairinfo_st>& kept=kept_cnv[fn];
+    for(size_t i=0;i<bp.size();++i) {
+      check_map_quality(bp[i]);
+      kept.push_back(bp[i]);
+    }
+    if ( normal ) {
+      vector<pairinfo_st>& kn=kept_normal[fn];
+      kn.insert(kn.end(), normal->begin(), normal->end());
+    }
+    if ( msc::outCompress ) return;
   }
   
-  bool is_new=false;
-  is_new = find(files.begin(), files.end(), fn) == files.end() ? true : false ;
+  string header="";
+  if ( fn!="STDOUT" ) header="##Command Line: "+msc::mycommand+"\n"+cnv_format1()+
+			( normal ? cnv_format_normal() : "" )+"\n";
+  int stream=writer_stream(fn, header);
   
-  ofstream FOUT;
-  if ( is_new ) {
-    FOUT.open(fn.c_str());
-    files.push_back(fn);
-    FOUT << "##Command Line: " << msc::mycommand << endl;
-    FOUT << cnv_format1() << endl;
-  }    
-  else FOUT.open(fn.c_str(), std::ofstream::app);
+  string *buf=writer_buffer();
+  for(size_t i=0;i<bp.size();++i) {
+    cnv_format_all(bp[i], *buf);
+    if ( normal ) cnv_format_normal( (*normal)[i], *buf );
+    *buf+='\n';
+  }
+  writer_push(stream, buf);
+  return;
+}
+
+//! bp as a VCF record, calls of the .weak output are filtered as weak
+static void cnv_format_vcf(const pairinfo_st &bp1, bool weak, string& s)
+{
+  pairinfo_st bp=bp1;
   
-  for(size_t i=0;i<bp.size();++i) FOUT << cnv_format_all(bp[i]) << endl;
+  bool is_del= bp.F2 < bp.R1;
+  orient_cnv(bp);
+  
+  s.append(cnv_rname(bp)); s+='\t';
+  append_int(s, bp.F2+1);
+  s.append("\t.\tN\t");
+  s.append(is_del ? "<DEL>" : "<DUP>");
+  s.append("\t.\t");
+  s.append(weak ? "weak" : "PASS");
+  s.append("\tSVTYPE="); s.append(is_del ? "DEL" : "DUP");
+  s.append(";END="); append_int(s, bp.R1+1);
+  s.append(";SVLEN="); append_int(s, is_del ? bp.F2-bp.R1 : bp.R1-bp.F2);
+  s.append(";UN="); append_int(s, bp.un);
+  s.append(";RD100=");
+  append_int(s, bp.F2_rd_100); s+=',';
+  append_int(s, bp.rd_F2_100); s+=',';
+  append_int(s, bp.rd_R1_100); s+=',';
+  append_int(s, bp.R1_rd_100);
+  s.append(";DDSCORE="); append_int(s, bp.ddscore);
+  s.append(";RD=");
+  append_int(s, bp.F2_rd); s+=',';
+  append_int(s, bp.R1_rd); s+=',';
+  append_int(s, bp.rd);
+  s.append(";RDSCORE="); append_int(s, bp.rdscore);
+  s.append(";RP=");
+  append_int(s, bp.F2_rp); s+=',';
+  append_int(s, bp.R1_rp); s+=',';
+  append_int(s, bp.FRrp);
+  s.append(";RPSCORE="); append_int(s, bp.rpscore);
+  s.append(";MR=");
+  append_int(s, bp.F2_sr); s+=',';
+  append_int(s, bp.R1_sr); s+=',';
+  append_int(s, bp.MS_ED);
+  s.append(";MRSCORE="); append_int(s, bp.srscore);
+  s.append(";SR=");
+  append_sr(s, bp, ',');
+  s.append(";Q0=");
+  append_int(s, bp.Q0); s+=',';
+  append_int(s, bp.Q10);
+  return;
+}
+
+//! INFO of the call scored in the normal of -bn, n1 is oriented as the call
+static void cnv_format_vcf_normal(const pairinfo_st &n1, string& s)
+{
+  pairinfo_st n=n1;
+  orient_cnv(n);
+  s.append(";NRD=");
+  append_int(s, n.F2_rd); s+=',';
+  append_int(s, n.R1_rd); s+=',';
+  append_int(s, n.rd);
+  s.append(";NRDSCORE="); append_int(s, n.rdscore);
+  s.append(";NRP=");
+  append_int(s, n.F2_rp); s+=',';
+  append_int(s, n.R1_rp); s+=',';
+  append_int(s, n.FRrp);
+  s.append(";NRPSCORE="); append_int(s, n.rpscore);
+  s.append(";NMR=");
+  append_int(s, n.F2_sr); s+=',';
+  append_int(s, n.R1_sr); s+=',';
+  append_int(s, n.MS_ED);
+  s.append(";NMRSCORE="); append_int(s, n.srscore);
+  s.append(";NSR=");
+  append_sr(s, n, ',');
+  if ( is_somatic(n) ) s.append(";SOMATIC");
+  return;
+}
+
+//! s as the inside of a quoted VCF header value, on a single line
+static string vcf_quote(const string& s)
+{
+  string q="";
+  for(size_t i=0; i<s.size(); ++i) {
+    if ( s[i]=='"' || s[i]=='\\' ) q+='\\';
+    q+= s[i]=='\n' || s[i]=='\r' ? ' ' : s[i];
+  }
+  return q;
+}
+
+static string vcf_header()
+{
+  string s="##fileformat=VCFv4.2\n"
+    "##source=matchclips\n"
+    "##commandline=\""+vcf_quote(msc::mycommand)+"\"\n";
+  for(size_t i=0; i<msc::bam_target_name.size(); ++i) {
+    if ( msc::bam_target_name[i]=="" ) continue;
+    s+="##contig=<ID="+msc::bam_target_name[i];
+    if ( msc::fp_in && (int)i<msc::fp_in->header->n_targets ) 
+      s+=",length="+to_string(msc::fp_in->header->target_len[i]);
+    s+=">\n";
+  }
+  s+="##ALT=<ID=DEL,Description=\"Deletion\">\n"
+    "##ALT=<ID=DUP,Description=\"Duplication\">\n"
+    "##FILTER=<ID=weak,Description=\"Reported in the .weak output\">\n"
+    "##INFO=<ID=SVTYPE,Number=1,Type=String,Description=\"Type of the variation\">\n"
+    "##INFO=<ID=END,Number=1,Type=Integer,Description=\"Last base of the variation\">\n"
+    "##INFO=<ID=SVLEN,Number=1,Type=Integer,Description=\"Length of the variation\">\n"
+    "##INFO=<ID=UN,Number=1,Type=Integer,Description=\"Length of the reference repeat at the breakpoints\">\n"
+    "##INFO=<ID=RD100,Number=4,Type=Integer,Description=\"Read depth 100 bases left outside, left inside, right inside and right outside\">\n"
+    "##INFO=<ID=DDSCORE,Number=1,Type=Integer,Description=\"Score of RD100\">\n"
+    "##INFO=<ID=RD,Number=3,Type=Integer,Description=\"Read depth left side, right side and between\">\n"
+    "##INFO=<ID=RDSCORE,Number=1,Type=Integer,Description=\"Score of RD\">\n"
+    "##INFO=<ID=RP,Number=3,Type=Integer,Description=\"Read pairs crossing left, crossing right and enveloping both\">\n"
+    "##INFO=<ID=RPSCORE,Number=1,Type=Integer,Description=\"Score of RP\">\n"
+    "##INFO=<ID=MR,Number=3,Type=Integer,Description=\"Matching reads left side, right side and edit distance\">\n"
+    "##INFO=<ID=MRSCORE,Number=1,Type=Integer,Description=\"Score of MR\">\n"
+    "##INFO=<ID=SR,Number=2,Type=Integer,Description=\"Split reads edit distance and count\">\n"
+    "##INFO=<ID=Q0,Number=2,Type=Integer,Description=\"Percent of reads with mapping quality 0 and at most 10\">\n";
+  if ( msc::normalFile!="" )
+    s+="##INFO=<ID=NRD,Number=3,Type=Integer,Description=\"RD in the normal\">\n"
+      "##INFO=<ID=NRDSCORE,Number=1,Type=Integer,Description=\"Score of NRD\">\n"
+      "##INFO=<ID=NRP,Number=3,Type=Integer,Description=\"RP in the normal\">\n"
+      "##INFO=<ID=NRPSCORE,Number=1,Type=Integer,Description=\"Score of NRP\">\n"
+      "##INFO=<ID=NMR,Number=3,Type=Integer,Description=\"MR in the normal\">\n"
+      "##INFO=<ID=NMRSCORE,Number=1,Type=Integer,Description=\"Score of NMR\">\n"
+      "##INFO=<ID=NSR,Number=2,Type=Integer,Description=\"SR in the normal\">\n"
+      "##INFO=<ID=SOMATIC,Number=0,Type=Flag,Description=\"The normal shows no variation\">\n"
+      "##normal="+msc::normalFile+"\n";
+  s+="#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n";
+  return s;
+}
+
+//! bp as tabix lines, formatted as VCF records or as the text output, with
+//! the scores of normal appended if it is not empty
+static void cnv_tabix_lines(const vector<pairinfo_st>& bp, const vector<pairinfo_st>& normal,
+			    bool vcf, bool weak, vector<tabixline_st>& lines)
+{
+  bool paired= normal.size()==bp.size() && bp.size()>0;
+  for(size_t i=0;i<bp.size();++i) {
+    tabixline_st L;
+    L.tid=bp[i].tid;
+    L.beg=min(bp[i].F2, bp[i].R1);
+    L.end=max(bp[i].F2, bp[i].R1)+1;
+    pairinfo_st b=bp[i];
+    if ( vcf ) cnv_format_vcf(b, weak, L.line);
+    else cnv_format_all(b, L.line);
+    if ( paired && vcf ) cnv_format_vcf_normal(normal[i], L.line);
+    else if ( paired ) cnv_format_normal(normal[i], L.line);
+    lines.push_back(L);
+  }
+  return;
+}
+
+static void write_sorted_text(const string& fn, const string& header, 
+			      vector<tabixline_st>& lines)
+{
+  stable_sort(lines.begin(), lines.end(), sort_tabixline);
+  ofstream FOUT(fn.c_str());
+  if ( !FOUT ) {
+    cerr << "cannot write " << fn << endl;
+    exit(0);
+  }
+  FOUT << header;
+  for(size_t i=0; i<lines.size(); ++i) FOUT << lines[i].line << "\n";
   FOUT.close();
   return;
 }
 
+void close_cnv_files()
+{
+  writer_close();
+  if ( !msc::outCompress && !msc::outVcf ) return;
+  
+  vector<pairinfo_st>& strong=kept_cnv[msc::outFile];
+  vector<pairinfo_st>& weak=kept_cnv[msc::outFile+".weak"];
+  vector<pairinfo_st>& nstrong=kept_normal[msc::outFile];
+  vector<pairinfo_st>& nweak=kept_normal[msc::outFile+".weak"];
+  if ( msc::outCompress ) {
+    string header="##Command Line: "+msc::mycommand+"\n"+cnv_format1()+
+      ( msc::normalFile!="" ? cnv_format_normal() : "" )+"\n";
+    vector<tabixline_st> lines(0);
+    cnv_tabix_lines(strong, nstrong, false, false, lines);
+    write_bgzf_tabix(msc::outFile+".gz", header, msc::bam_target_name, lines, TABIX_GENERIC);
+    lines.clear();
+    cnv_tabix_lines(weak, nweak, false, true, lines);
+    write_bgzf_tabix(msc::outFile+".weak.gz", header, msc::bam_target_name, lines, TABIX_GENERIC);
+  }
+  if ( msc::outVcf ) {
+    vector<tabixline_st> lines(0);
+    cnv_tabix_lines(strong, nstrong, true, false, lines);
+    cnv_tabix_lines(weak, nweak, true, true, lines);
+    if ( msc::outCompress ) 
+      write_bgzf_tabix(msc::outFile+".vcf.gz", vcf_header(), msc::bam_target_name, lines, TABIX_VCF);
+    else write_sorted_text(msc::outFile+".vcf", vcf_header(), lines);
+  }
+  kept_cnv.clear();
+  kept_normal.clear();
+  return;
+}
+
 string tmpfile(int thread_id) {
   string tmps="matchclipstmpdata."+
     to_string(msc::pid)+"."+to_string(msc::numThreads)+"."+to_string(thread_id);
@@ -316,24 +634,35 @@ void write_ED_st_to_file(vector<ED_st>& ed, string fn)
   return;
 }
 
-void remove_N_regions(string& fasta, vector<pairinfo_st>& bp)
+//! the regions of pending are journaled once their calls are on disk
+static void checkpoint_written(vector<ckptregion_st>& pending, const vector<string>& outputs)
 {
-  vector<int> N_beg(0), N_end(0);
-  get_N_regions(fasta, N_beg, N_end);
-  for(int i=bp.size()-1; i>=0; --i) {
+  if ( pending.empty() ) return;
+  writer_sync();
+  vector<long> offset(0);
+  for(size_t i=0; i<outputs.size(); ++i) offset.push_back( writer_tell(outputs[i]) );
+  for(size_t i=0; i<pending.size(); ++i) {
+    pending[i].offset=offset;
+    checkpoint_region(pending[i]);
+  }
+  pending.clear();
+  return;
+}
+
+void remove_N_regions(const nregion_st& nr, vector<pairinfo_st>& bp)
+{
+  size_t k=0;
+  for(size_t i=0; i<bp.size(); ++i) {
     int F2=bp[i].F2;
     int R1=bp[i].R1;
     if ( F2>R1 ) swap(F2, R1);
     
-    bool is_N=false;
-    for(size_t k=0; k<N_beg.size(); ++k) {
-      int r1=max(N_beg[k], F2);
-      int r2=min(N_end[k], R1);
-      if ( r2-r1 > (R1-F2)/3 ) { is_N=true; break; }
-    }
-    
-    if ( is_N && bp[i].rdscore>=1 ) bp.erase( bp.begin()+i );
+    bool is_N= nr.max_overlap(F2, R1) > (R1-F2)/3;
+    if ( is_N && bp[i].rdscore>=1 ) continue;
+    if ( k<i ) bp[k]=bp[i];
+    ++k;
   }
+  bp.resize(k);
   
   return;
 }
@@ -347,7 +676,8 @@ void finalize_output(vector<pairinfo_st>& bp,
   weak.clear();
   if ( bp.size() < 1 ) return;
   
-  for(size_t i=1; i<bp.size(); ++i) cerr << cnv_format1(bp[i]) << endl;
+  if ( msc::verbose>0 )
+    for(size_t i=1; i<bp.size(); ++i) cerr << cnv_format1(bp[i]) << endl;
   
   // remove duplicated 
   for(size_t i=1; i<bp.size(); ++i) {
@@ -491,19 +821,19 @@ void finalize_output(vector<pairinfo_st>& bp,
 }
 
 
-void get_pairend_info(int ref, int beg, int end)
+int get_pairend_info(int ref, int beg, int end)
 {
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter;
+  region_iter_t iter;
   
   size_t count=0;
   int l_qseq=100; double l_qseq_sum=0.0;
   double isize=0.0, isize2=0.0, isize_c=0, isize_sd=0.0;
   
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
+  iter = region_query(ref, beg, end);
   
   vector<double> pe(0); pe.reserve(15000);
-  while(  bam_iter_read(msc::fp_in->x.bam, iter, b)  > 0 ) {
+  while(  region_read(iter, b)  > 0 ) {
     ++count;
     l_qseq_sum+=b->core.l_qseq;
     if ( (int)b->core.tid < 0 ) continue;
@@ -529,7 +859,9 @@ void get_pairend_info(int ref, int beg, int end)
 	 << msc::fp_in->header->target_name[ ref ] << "\t" 
 	 << beg << "\t" << end 
 	 << endl; 
-    return;
+    if ( b ) bam_destroy1(b);
+    if ( iter) region_destroy(iter);
+    return 0;
   }
   
   //update main control
@@ -574,17 +906,150 @@ void get_pairend_info(int ref, int beg, int end)
   }
 
   if ( b ) bam_destroy1(b);
-  if ( iter) bam_iter_destroy(iter);
+  if ( iter) region_destroy(iter);
+  return (int)isize_c;
+}
+
+
+/*!
+  @abstract the globals that belong to one BAM, for the normal of -bn
+
+  the tumor of -b is in msc while its regions are searched, the normal is
+  swapped in with swap_bam_context() to score the calls of the tumor.
+*/
+struct bamcontext_st {
+  string bamFile;
+  samfile_t *fp_in;
+  bam_index_t *bamidx;
+  bool bamStream;
+  int l_qseq;
+  bool is_paired;
+  bool pe_genome;
+  int pe_insert;
+  int pe_insert_sd;
+  vector<int32_t> rd;
+  bamcontext_st(): bamFile(""), fp_in(NULL), bamidx(NULL), bamStream(false), 
+		   l_qseq(0), is_paired(false), pe_genome(false), 
+		   pe_insert(0), pe_insert_sd(0), rd(0) {};
+};
+
+//! exchange c with the BAM in msc, the region statistics of the other BAM are dropped
+static void swap_bam_context(bamcontext_st& c)
+{
+  swap(c.bamFile, msc::bamFile);
+  swap(c.fp_in, msc::fp_in);
+  swap(c.bamidx, msc::bamidx);
+  swap(c.bamStream, msc::bamStream);
+  swap(c.l_qseq, msc::bam_l_qseq);
+  swap(c.is_paired, msc::bam_is_paired);
+  swap(c.pe_genome, msc::bam_pe_genome);
+  swap(c.pe_insert, msc::bam_pe_insert);
+  swap(c.pe_insert_sd, msc::bam_pe_insert_sd);
+  c.rd.swap(msc::rd);
+  regioncache_clear();
   return;
 }
 
+static void set_insert_model(const vector<insertmodel_st>& models);
+
+//! open the normal of -bn, its targets must be those of the tumor
+static void open_normal(bamcontext_st& normal)
+{
+  normal.bamFile=msc::normalFile;
+  normal.fp_in=samopen(normal.bamFile.c_str(), "rb", 0);
+  if ( !normal.fp_in ) {
+    cerr << normal.bamFile << " not found!" << endl;
+    exit(0);
+  }
+  normal.bamidx=bam_index_load(normal.bamFile.c_str());
+  if ( !normal.bamidx ) {
+    cerr << normal.bamFile << " idx not found!" << endl;
+    exit(0);
+  }
+  const bam_header_t *t=msc::fp_in->header, *n=normal.fp_in->header;
+  bool same= t->n_targets==n->n_targets;
+  for(int i=0; same && i<t->n_targets; ++i) 
+    same= t->target_len[i]==n->target_len[i] && 
+      strcmp(t->target_name[i], n->target_name[i])==0;
+  if ( !same ) {
+    cerr << "targets of " << normal.bamFile << " differ from " << msc::bamFile << endl;
+    exit(0);
+  }
+  
+  // the normal has its own insert size, the tumor's is kept if none is found
+  normal.l_qseq=msc::bam_l_qseq;
+  normal.is_paired=msc::bam_is_paired;
+  normal.pe_genome=msc::bam_pe_genome;
+  normal.pe_insert=msc::bam_pe_insert;
+  normal.pe_insert_sd=msc::bam_pe_insert_sd;
+  swap_bam_context(normal);
+  vector<insertmodel_st> pemodels(0);
+  if ( !msc::bam_pe_set_by_user && !msc::bam_pe_region && 
+       load_insert_models(msc::bamFile, msc::bamidx, msc::fp_in->header, 
+			  msc::minMAPQ, msc::numThreads, pemodels) ) 
+    set_insert_model(pemodels);
+  swap_bam_context(normal);
+  return;
+}
+
+//! the calls of the tumor scored in the normal, n[i] belongs to calls[i]
+static void score_in_normal(bamcontext_st& normal, int ref, const refseq_st& FASTA,
+			    const vector<pairinfo_st>& calls, vector<pairinfo_st>& n)
+{
+  n.clear();
+  for(size_t i=0; i<calls.size(); ++i) {
+    pairinfo_st ibp;
+    ibp.tid=calls[i].tid;
+    ibp.F2=calls[i].F2;
+    ibp.R1=calls[i].R1;
+    n.push_back(ibp);
+  }
+  if ( n.empty() ) return;
+  swap_bam_context(normal);
+  genotype_score(ref, FASTA, n);
+  swap_bam_context(normal);
+  for(size_t i=0; i<n.size(); ++i) metric_add(MC_SOMATIC_CALLS, is_somatic(n[i]));
+  return;
+}
+
+//! use the genome wide models, the widest library decides which pairs are
+//! discordant. models with too few pairs only set the read length
+static void set_insert_model(const vector<insertmodel_st>& models)
+{
+  for(size_t i=0; i<models.size(); ++i) 
+    cerr << "read group\t" << models[i].rg 
+	 << "\tpairs " << models[i].n 
+	 << "\tl_qseq " << models[i].l_qseq
+	 << "\tinsert " << models[i].insert << " += " << models[i].insert_sd << endl;
+  
+  const insertmodel_st& m=widest_insert_model(models, 6);
+  msc::bam_l_qseq=models[0].l_qseq;
+  if ( m.n>=PE_MIN_SAMPLES ) {
+    msc::bam_is_paired=true;
+    msc::bam_pe_insert=m.insert;
+    msc::bam_pe_insert_sd=m.insert_sd;
+    msc::bam_pe_genome=true;
+  }
+  cerr << "genome wide model of read group " << m.rg << "\n"
+       << "bam_l_qseq\t" << msc::bam_l_qseq << "\n"
+       << "bam_is_paired\t" << msc::bam_is_paired << "\n"
+       << "bam_pe_insert\t" << msc::bam_pe_insert << "\n"
+       << "bam_pe_insert_sd\t" << msc::bam_pe_insert_sd << "\n"
+       << endl;
+  
+  if ( msc::minOverlap*4<msc::bam_l_qseq ) {
+    msc::minOverlap=msc::bam_l_qseq/4;
+    cerr << "length of minimum overlap changed to: " << msc::minOverlap << endl;
+  }
+  return;
+}
 
 void get_bam_info()
 {
   
   bam1_t *b=NULL;   
   b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   int ref=0, beg=0, end=0x7fffffff;
   
   for(int i=0;i<msc::fp_in->header->n_targets;++i) 
@@ -604,9 +1069,14 @@ void get_bam_info()
       cerr << "Cannt resolve region " << msc::bamRegion[i] << endl;
       have_reads=false;
     }
+    else if ( msc::bamStream ) {
+      // checked when the target is read from the stream
+      have_reads=true;
+    }
     else {
-      iter = bam_iter_query(msc::bamidx, ref, beg, end);
-      if ( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+      if ( iter ) region_destroy(iter);
+      iter = region_query(ref, beg, end);
+      if ( region_read(iter, b)>0 ) {
 	string RNAME=msc::fp_in->header->target_name[b->core.tid];
 	if ( msc::bamRegion[i].find(RNAME) == 0 ) 
 	  cerr << msc::bamFile << " has reads on " << msc::bamRegion[i] << endl;
@@ -621,8 +1091,24 @@ void get_bam_info()
     }
   }
   
+  // a stream is read once, regions follow the order of the targets
+  if ( msc::bamStream ) {
+    vector< pair<int, int> > order(0);
+    for( int i=0; i<(int)msc::bamRegion.size(); ++i) {
+      if ( msc::bamRegion[i]=="NA" ) continue;
+      bam_parse_region(msc::fp_in->header, msc::bamRegion[i].c_str(), &ref, &beg, &end); 
+      order.push_back( make_pair(ref, i) );
+    }
+    stable_sort(order.begin(), order.end());
+    vector<string> regions(0);
+    for(size_t i=0; i<order.size(); ++i) regions.push_back(msc::bamRegion[ order[i].second ]);
+    if ( regions!=msc::bamRegion ) 
+      cerr << "regions are processed in the order of the targets in the stream" << endl;
+    msc::bamRegion=regions;
+  }
+  
   if ( b ) bam_destroy1(b);
-  if ( iter ) bam_iter_destroy(iter);
+  if ( iter ) region_destroy(iter);
   
   return;
 }
@@ -634,6 +1120,11 @@ int usage_match_MS_SM_reads(int argc, char* argv[]) {
        << "  " << app << " <options> -f REFFILE -b BAMFILE [REGION]\n"
        << "\nOptions:\n"
        << "  -t  INT  number of threads, INT=1 \n"
+       << "  -fm      copy each chromosome into memory, default reads the mapped REFFILE\n"
+       << "  -f2      read the 2-bit packed REFFILE.mc2bit, built if missing\n"
+       << "  -M  SIZE memory budget, MB or with a K, M or G suffix; soft clipped reads\n"
+       << "           of a region are downsampled to stay within it\n"
+       << "  -ev DIR  save the BAM evidence of each region in DIR and reuse it on reruns\n"
        << "  -e  INT  max allowed mismatches when matching strings, INT=2 \n"
        << "  -l  INT  minimum length of overlap, INT=25 \n"
        << "  -s  INT  minimum number of soft clipped bases, INT=10 \n"
@@ -643,11 +1134,34 @@ int usage_match_MS_SM_reads(int argc, char* argv[]) {
        << "  -L  0    pair end mode only \n"
        << "  -se      single end mode, do not use pair end distances\n"
        << "  -pe INT INT provide insert and s.d. of insert, otherwise calculate them\n"
+       << "  -pr      estimate insert and s.d. in each region, always so with -b -\n"
        << "  -o  STR  outputfile, STR=STDOUT \n"
+       << "  -oz      write STR.gz and STR.weak.gz, position sorted with tabix indexes\n"
+       << "  -vcf     also write the calls as STR.vcf, STR.vcf.gz with -oz\n"
+       << "  -metrics STR  write stage times, filter counts and memory peaks as JSON to STR\n"
+       << "  -trace STR    write a timeline of regions, stages and threads to STR, for\n"
+       << "           chrome://tracing or Perfetto\n"
+       << "  -status STR  keep the region, stage, throughput and ETA of the run in STR,\n"
+       << "           rewritten every few seconds\n"
+       << "  -bn STR  normal BAMFILE of the tumor in -b, the calls of the tumor are also\n"
+       << "           scored in the normal and flagged somatic if it shows none,\n"
+       << "           also in -oz and as NRD, NRP, NMR, NSR and SOMATIC INFO in -vcf\n"
+       << "  -cnv STR genotype the breakpoints listed in STR, CHR BEGIN END TYPE as in the\n"
+       << "           output, only the BAM around them is read; SR is not scored and\n"
+       << "           written as .;. as is NSR with -bn\n"
+       << "  --resume skip the regions already written to -o by an earlier run of the\n"
+       << "           same command, as journaled in STR.ckpt\n"
+       << "  --shard i/N  process the i-th of N balanced parts of the regions and\n"
+       << "           write the calls to -o, combine all N with: " << app << " merge;\n"
+       << "           a chromosome is only cut in N gaps of 10kb or more, and kept\n"
+       << "           whole without one\n"
        << "   REGION  if given should be in samtools's region format \n"
+       << "  BAMFILE  - reads a coordinate sorted BAM from stdin, no index needed; each\n"
+       << "           target is held in memory, counted against -M\n"
        << "\nExamples:\n"
        << "  " << app << "      -f hg19.fasta -b A.bam -o A.txt\n"
        << "  " << app << " -t 4 -f hg19.fasta -b A.bam chr1 -o A.txt\n"
+       << "  samtools sort -o A.unsorted.bam tmp | " << app << " -f hg19.fasta -b - -o A.txt\n"
        << "\nDiscussion:\n"
        << "  1. max allowed mismatches when matching reads\n"
        << "     This number is also adjusted according to the length of\n"
@@ -702,8 +1216,26 @@ int get_parameters(int argc, char* argv[])
       }
       _next2;
     }
+    if ( ARGV[i]=="-bn" ) { msc::normalFile=ARGV[i+1]; _next2; }
     if ( ARGV[i]=="-f" ) { msc::refFile=ARGV[i+1]; _next2; }
+    if ( ARGV[i]=="-fm" ) { msc::refInMemory=true; _next1; }
+    if ( ARGV[i]=="-f2" ) { msc::refPacked=true; _next1; }
+    if ( ARGV[i]=="-ev" ) { msc::evidenceDir=ARGV[i+1]; _next2; }
     if ( ARGV[i]=="-o" ) { msc::outFile=ARGV[i+1]; _next2; }
+    if ( ARGV[i]=="-oz" ) { msc::outCompress=true; _next1; }
+    if ( ARGV[i]=="-vcf" ) { msc::outVcf=true; _next1; }
+    if ( ARGV[i]=="-metrics" ) { msc::metricsFile=ARGV[i+1]; _next2; }
+    if ( ARGV[i]=="-trace" ) { msc::traceFile=ARGV[i+1]; _next2; }
+    if ( ARGV[i]=="-status" ) { msc::statusFile=ARGV[i+1]; _next2; }
+    if ( ARGV[i]=="--resume" ) { msc::resume=true; _next1; }
+    if ( ARGV[i]=="-M" ) { 
+      msc::memBudget=parse_mem_size(ARGV[i+1]);
+      if ( msc::memBudget==0 ) {
+	cerr << "-M " << ARGV[i+1] << " is not a memory size" << endl;
+	exit(0);
+      }
+      _next2;
+    }
     if ( ARGV[i]=="-t" ) { msc::numThreads=atoi(ARGV[i+1].c_str()); _next2; }
     if ( ARGV[i]=="-e" ) { msc::errMatch=atoi(ARGV[i+1].c_str()); _next2; }
     if ( ARGV[i]=="-l" ) { msc::minOverlap=atoi(ARGV[i+1].c_str()); _next2; }
@@ -722,6 +1254,14 @@ int get_parameters(int argc, char* argv[])
     if ( ARGV[i]=="-cnv" ) { msc::cnvFile=ARGV[i+1]; _next2; }
     if ( ARGV[i]=="-d" ) { msc::dx=atoi(ARGV[i+1].c_str()); _next2; }
     if ( ARGV[i]=="-se" ) { msc::bam_pe_disabled=true; _next1; }
+    if ( ARGV[i]=="-pr" ) { msc::bam_pe_region=true; _next1; }
+    if ( ARGV[i]=="--shard" ) {
+      if ( !parse_shard(ARGV[i+1], msc::shardIndex, msc::shardCount) ) {
+	cerr << "shard is given by --shard i/N, 1<=i<=N" << endl;
+	exit(0);
+      }
+      _next2;
+    }
     if ( ARGV[i]=="-pe" ) { 
       msc::bam_pe_set_by_user=true;
       msc::bam_pe_insert=atoi(ARGV[i+1].c_str());
@@ -741,6 +1281,33 @@ int get_parameters(int argc, char* argv[])
     cerr << "Need reference file\n";
     exit( usage_match_MS_SM_reads(argc, argv) );
   }
+  if ( msc::shardCount>0 && msc::outFile=="STDOUT" ) {
+    cerr << "Need -o for the shard file\n";
+    exit( usage_match_MS_SM_reads(argc, argv) );
+  }
+  if ( (msc::outCompress || msc::outVcf) && msc::outFile=="STDOUT" ) {
+    cerr << "Need -o for -oz and -vcf\n";
+    exit( usage_match_MS_SM_reads(argc, argv) );
+  }
+  if ( msc::resume && ( msc::outFile=="STDOUT" || msc::outCompress || msc::outVcf || 
+			msc::shardCount>0 || msc::dumpBam ) ) {
+    cerr << "--resume needs -o without -oz, -vcf, -dump and --shard, ignored" << endl;
+    msc::resume=false;
+  }
+  if ( msc::normalFile!="" && ( msc::cnvFile!="" || msc::shardCount>0 || msc::dumpBam ) ) {
+    cerr << "-bn can not be used with -cnv, --shard or -dump" << endl;
+    exit( usage_match_MS_SM_reads(argc, argv) );
+  }
+  if ( msc::cnvFile!="" && ( msc::shardCount>0 || msc::dumpBam || msc::resume ) ) {
+    cerr << "-cnv genotypes the listed sites in one run, --shard, -dump and --resume are ignored" << endl;
+    msc::shardCount=0;
+    msc::dumpBam=false;
+    msc::resume=false;
+  }
+  if ( (msc::outCompress || msc::outVcf) && msc::shardCount>0 ) {
+    cerr << "-oz and -vcf are given to merge with --shard" << endl;
+    msc::outCompress=msc::outVcf=false;
+  }
   bool is_unknown_parameter=false;
   for(i=1;i<ARGV.size();++i) {
     if ( ARGV[i]!="" ) {
@@ -765,6 +1332,8 @@ int get_parameters(int argc, char* argv[])
     "#Maximum distance : " + to_string(msc::maxDistance) + "\n" +
     "#Output           : " + msc::outFile + "\n"+
     "#Output           : " + msc::outFile + ".weak\n";
+  if ( msc::normalFile!="" ) 
+    msc::execinfo+="#Normal bamfile   : " + msc::normalFile + "\n";
   
   cerr << msc::execinfo << endl;
   
@@ -775,8 +1344,11 @@ void match_MS_SM_reads(int argc, char* argv[])
 {
   if ( argc<3 )  exit( usage_match_MS_SM_reads(argc, argv) );
   get_parameters(argc, argv);
+  double t_start=wall_time();
+  if ( msc::traceFile!="" ) trace_open(msc::traceFile);
   
-  string FASTA; string fastaname="";
+  refseq_st FASTA; string fastaname="";
+  nregion_st nregion;
   
   int ref=0, beg=0, end=0x7fffffff;
   
@@ -786,81 +1358,332 @@ void match_MS_SM_reads(int argc, char* argv[])
     cerr << msc::bamFile << " not found!" << endl;
     exit(0);
   }
-  msc::bamidx=bam_index_load(msc::bamFile.c_str()); 
-  if ( ! msc::bamidx ) {
-    cerr << msc::bamFile << " idx not found!" << endl;
-    exit(0);
+  msc::bamStream= msc::bamFile==BAMSTREAM_STDIN;
+  if ( !msc::bamStream ) {
+    msc::bamidx=bam_index_load(msc::bamFile.c_str()); 
+    if ( ! msc::bamidx ) {
+      cerr << msc::bamFile << " idx not found!" << endl;
+      exit(0);
+    }
+  }
+  else {
+    // records are gathered one target at a time, the genome wide insert
+    // model and the evidence files need the whole BAM before the first
+    msc::bam_pe_region=true;
+    if ( msc::evidenceDir!="" ) {
+      cerr << "-ev is ignored when reading from stdin" << endl;
+      msc::evidenceDir="";
+    }
   }
   get_bam_info();
   
+  // only the units of this shard are processed, bamRegion[i] is units[i]
+  vector<shardunit_st> units(0);
+  if ( msc::shardCount>0 ) {
+    vector<shardunit_st> all(0);
+    make_shard_units(msc::shardCount, all);
+    msc::bamRegion.clear();
+    for(size_t i=0; i<all.size(); ++i) {
+      if ( all[i].shard!=msc::shardIndex ) continue;
+      units.push_back(all[i]);
+      msc::bamRegion.push_back(all[i].query);
+    }
+    cerr << "shard " << msc::shardIndex << "/" << msc::shardCount << ": "
+	 << units.size() << " of " << all.size() << " units" << endl;
+  }
+  
+  // plain text calls are journaled in STR.ckpt, regions finished by an
+  // earlier run are skipped with --resume
+  bool is_journaled= msc::outFile!="STDOUT" && !msc::outCompress && !msc::outVcf &&
+    msc::shardCount==0 && !msc::dumpBam && msc::cnvFile=="";
+  vector<string> outputs(0);
+  vector<ckptregion_st> done(0), ckpt_pending(0);
+  if ( is_journaled ) {
+    outputs.push_back(msc::outFile);
+    outputs.push_back(msc::outFile+".weak");
+    checkpoint_open(msc::outFile+".ckpt", outputs, msc::resume, done);
+    for(size_t i=0; i<done.size(); ++i) msc::bamRegion[ done[i].region ]="NA";
+    for(size_t i=0; i<outputs.size() && !done.empty(); ++i)
+      if ( done.back().offset[i]>=0 ) writer_reopen(outputs[i]);
+  }
+  
+  if ( msc::statusFile!="" ) {
+    double bases=0;
+    for(size_t i=0; i<msc::bamRegion.size(); ++i) {
+      int r=-1, b=0, e=0x7fffffff;
+      if ( msc::bamRegion[i]=="NA" ) continue;
+      if ( bam_parse_region(msc::fp_in->header, msc::bamRegion[i].c_str(), &r, &b, &e)<0 ) continue;
+      if ( r<0 || r>=(int)msc::bam_target_name.size() ) continue;
+      bases+=max(0, min(e, (int)msc::fp_in->header->target_len[r])-b);
+    }
+    progress_open(msc::statusFile, msc::bamRegion.size(), bases);
+  }
+  
   if ( msc::dumpBam ) {
     msc::fp_out = msc::outFile=="STDOUT" ? 
       samopen("-", "w", msc::fp_in->header) :
       samopen(msc::outFile.c_str(), "wb", msc::fp_in->header) ;
   }
   
+  // insert size sampled across the genome once, cached next to the BAM
+  vector<insertmodel_st> pemodels(0);
+  if ( !msc::bam_pe_set_by_user && !msc::bam_pe_region && 
+       load_insert_models(msc::bamFile, msc::bamidx, msc::fp_in->header, 
+			  msc::minMAPQ, msc::numThreads, pemodels) ) 
+    set_insert_model(pemodels);
+  
+  bamcontext_st normal;
+  bool paired= msc::normalFile!="";
+  if ( paired ) open_normal(normal);
+  
+  // -cnv scores the listed breakpoints only, no discovery
+  if ( msc::cnvFile!="" ) {
+    genotype_sites(msc::cnvFile);
+    double t0=wall_time();
+    close_cnv_files();
+    metric_time(MS_OUTPUT, wall_time()-t0);
+    if ( msc::fp_in ) samclose(msc::fp_in);
+    if ( msc::bamidx ) bam_index_destroy(msc::bamidx);
+    if ( msc::metricsFile!="" ) metrics_write(msc::metricsFile, wall_time()-t_start);
+    trace_close();
+    if ( msc::statusFile!="" ) progress_close();
+    cerr << msc::execinfo << endl;
+    return;
+  }
+  
+  // buffers reused by all regions
+  pairset_st pairs;
+  readstore_st r_MS, r_SM;
+  
+  // insert size model shared with contigs too small to estimate their own
+  bool pe_saved=false;
+  int pe_insert=0, pe_insert_sd=0;
+  string pe_target="";
+  if ( !done.empty() ) {
+    pe_target=done.back().pe_target;
+    pe_insert=done.back().pe_insert;
+    pe_insert_sd=done.back().pe_insert_sd;
+    pe_saved= pe_target!="";
+  }
+  
+  // output of small contigs is written in batches
+  vector<pairinfo_st> strong_batch(0), weak_batch(0);
+  vector<pairinfo_st> nstrong_batch(0), nweak_batch(0);   // scored in the normal
+  int nbatch=0;
+  
+  // reference of the next contig is loaded while this one is matched
+  prefetch_st pf;
+  double pf_saved=0;
+  
   for(int ichr=0; ichr<(int)msc::bamRegion.size(); ++ichr ) {
     if ( msc::bamRegion[ichr]=="NA" ) continue;
     cerr << "processing region:\t" << msc::bamRegion[ichr] << endl;
+    tracespan_st region_span(msc::bamRegion[ichr].c_str(), "region");
+    mem_set(MEM_CANDIDATES, 0);
+    memscope_st region_mem(msc::bamRegion[ichr]);
     
     ref=-1; beg=0; end=0x7fffffff;
     int is_solved=bam_parse_region(msc::fp_in->header, msc::bamRegion[ichr].c_str(), &ref, &beg, &end); 
     if ( is_solved<0 || ref<0 || ref>=(int)msc::bam_target_name.size() ) continue;
     msc::bam_ref=ref;
+    regioncache_clear();
+    progress_region(ichr, msc::bamRegion[ichr], beg, 
+		    max(0, min(end, (int)msc::fp_in->header->target_len[ref])-beg));
+    progress_stage(MS_INGEST);
+    double t0=wall_time();
+    if ( msc::bamStream && !bamstream_load(ref, beg, end) ) continue;
+    metric_time(MS_INGEST, wall_time()-t0);
     
-    if ( !msc::bam_pe_set_by_user ) get_pairend_info(ref, beg, end);
+    int rlen=min(end, (int)msc::fp_in->header->target_len[ref])-beg;
+    bool is_small= rlen<SMALL_CONTIG;
+    
+    msc::bam_pe_shared=false;
+    t0=wall_time();
+    if ( !msc::bam_pe_set_by_user && !msc::bam_pe_genome ) {
+      int nsample=get_pairend_info(ref, beg, end);
+      if ( nsample>=PE_MIN_SAMPLES ) {
+	pe_saved=true;
+	pe_insert=msc::bam_pe_insert;
+	pe_insert_sd=msc::bam_pe_insert_sd;
+	pe_target=msc::bam_target_name[ref];
+      }
+      else if ( pe_saved ) {
+	msc::bam_is_paired=true;
+	msc::bam_pe_insert=pe_insert;
+	msc::bam_pe_insert_sd=pe_insert_sd;
+	msc::bam_pe_shared=true;
+	cerr << "too few pairs, insert size model of " << pe_target << " is used: " 
+	     << pe_insert << " += " << pe_insert_sd << endl;
+      }
+    }
+    metric_time(MS_INGEST, wall_time()-t0);
     
     //! load reference sequence
     if ( msc::bam_target_name[msc::bam_ref] != fastaname ) {
+      progress_stage(MS_REFERENCE);
+      t0=wall_time();
       fastaname=msc::bam_target_name[ref];
-      load_reference(msc::refFile, fastaname, FASTA);
+      if ( !prefetch_take(pf, fastaname, FASTA, pf_saved) ) {
+	load_reference(msc::refFile, fastaname, FASTA, msc::refPacked);
+	if ( msc::refInMemory ) FASTA.materialise();
+      }
       if ( FASTA.size() != msc::fp_in->header->target_len[msc::bam_ref] )
 	cerr << "not exactly the same reference, expected length " 
 	     << msc::fp_in->header->target_len[msc::bam_ref]  
 	     << " loaded " << FASTA.size() 
 	     << endl;
+      if ( !load_N_regions(msc::refFile, fastaname, FASTA, nregion) ) nregion=nregion_st();
+      mem_set(MEM_REFERENCE, FASTA.totalRAM());
+      metric_time(MS_REFERENCE, wall_time()-t0);
     }
     
-    vector<intpair_st> pairs(0);
-    vector<bam1_t> b_MS(0);
-    vector<bam1_t> b_SM(0);
+    // look ahead to the next region on another contig
+    if ( !pf.running ) 
+      for(int j=ichr+1; j<(int)msc::bamRegion.size(); ++j) {
+	if ( msc::bamRegion[j]=="NA" ) continue;
+	int jref=-1, jbeg=0, jend=0x7fffffff;
+	if ( bam_parse_region(msc::fp_in->header, msc::bamRegion[j].c_str(), 
+			      &jref, &jbeg, &jend)<0 ) continue;
+	if ( jref<0 || jref>=(int)msc::bam_target_name.size() ) continue;
+	if ( msc::bam_target_name[jref]==fastaname ) continue;
+	// a stream has no index to warm up
+	prefetch_start(pf, msc::bam_target_name[jref], msc::bamStream ? -1 : jref, 
+		       jbeg, jend);
+	break;
+      }
     
     int min_pair_length=msc::bam_pe_insert+msc::bam_pe_insert_sd*6;
     //if ( min_pair_length<1000 ) min_pair_length=1000;
+    progress_stage(MS_INGEST);
+    t0=wall_time();
     prepare_pairend_matchclip_data(ref, beg, end, min_pair_length, FASTA,
-				   pairs, b_MS, b_SM);
+				   pairs, r_MS, r_SM);
+    metric_time(MS_INGEST, wall_time()-t0);
     
     vector<pairinfo_st> pairbp_pe(0);
     if (! msc::bam_pe_disabled ) {
       pair_guided_search(pairs, FASTA, pairbp_pe) ;
       // pair_guided_search(ref, beg, end, min_pair_length, FASTA, pairbp_pe);
-      vector<intpair_st> (0).swap(pairs);
+      pairs.reset();
+      mem_set(MEM_PAIRS, pairs.totalRAM());
+      mem_set(MEM_CANDIDATES, totalRAM(pairbp_pe));
     }
     
     vector<pairinfo_st> pairbp_mc(0);
     int search_length=msc::bam_pe_insert+msc::bam_pe_insert_sd*8+msc::bam_l_qseq*2;
     if ( msc::bam_pe_disabled || msc::search_length_set_by_user ) 
       search_length=msc::maxDistance;
-    exhaustive_search(b_MS, b_SM, search_length, FASTA, pairbp_mc);
+    exhaustive_search(r_MS, r_SM, search_length, FASTA, pairbp_mc);
     // exhaustive_search(ref, beg, end, search_length, FASTA, pairbp_mc);
+    mem_set(MEM_CANDIDATES, totalRAM(pairbp_pe)+totalRAM(pairbp_mc));
     
     pairbp_mc.insert(pairbp_mc.end(), pairbp_pe.begin(), pairbp_pe.end() ); 
     sort(pairbp_mc.begin(), pairbp_mc.end(), sort_pair_info);
     
     vector<pairinfo_st> strong, weak;
-    remove_N_regions(FASTA, pairbp_mc);
+    progress_stage(MS_OUTPUT);
+    t0=wall_time();
+    remove_N_regions(nregion, pairbp_mc);
+    if ( msc::shardCount>0 ) {
+      // calls are kept by the unit holding their left end, those that
+      // finalize_output() may print get Q0 while the BAM is at hand
+      const shardunit_st& u=units[ichr];
+      size_t k=0;
+      for(size_t i=0; i<pairbp_mc.size(); ++i) {
+	int left=min(pairbp_mc[i].F2, pairbp_mc[i].R1);
+	if ( left<u.beg || left>=u.end ) continue;
+	pairbp_mc[k++]=pairbp_mc[i];
+      }
+      pairbp_mc.resize(k);
+      vector<pairinfo_st> calls=pairbp_mc;
+      finalize_output(calls, strong, weak);
+      strong.insert(strong.end(), weak.begin(), weak.end());
+      map<pair<int, int>, pairinfo_st> q;
+      for(size_t i=0; i<strong.size(); ++i) {
+	check_map_quality(strong[i]);
+	q[ make_pair(strong[i].F2, strong[i].R1) ]=strong[i];
+      }
+      for(size_t i=0; i<pairbp_mc.size(); ++i) {
+	map<pair<int, int>, pairinfo_st>::iterator it=
+	  q.find( make_pair(pairbp_mc[i].F2, pairbp_mc[i].R1) );
+	if ( it==q.end() ) continue;
+	pairbp_mc[i].Q0=it->second.Q0;
+	pairbp_mc[i].Q10=it->second.Q10;
+      }
+      write_shard_unit(msc::outFile, msc::shardIndex, msc::shardCount, u, pairbp_mc);
+      metric_time(MS_OUTPUT, wall_time()-t0);
+      continue;
+    }
     finalize_output(pairbp_mc, strong, weak);    
+    metric_add(MC_STRONG_CALLS, strong.size());
+    metric_add(MC_WEAK_CALLS, weak.size());
     sort(strong.begin(), strong.end(), sort_pair_info_output);
     sort(weak.begin(), weak.end(), sort_pair_info_output);
-    write_cnv_to_file(strong, msc::outFile);
-    write_cnv_to_file(weak, string(msc::outFile+".weak"));    
+    strong_batch.insert(strong_batch.end(), strong.begin(), strong.end());
+    weak_batch.insert(weak_batch.end(), weak.begin(), weak.end());
+    if ( paired ) {
+      // timed as ingest and validation of the normal, not as output
+      double tn=wall_time();
+      vector<pairinfo_st> n(0);
+      score_in_normal(normal, ref, FASTA, strong, n);
+      nstrong_batch.insert(nstrong_batch.end(), n.begin(), n.end());
+      score_in_normal(normal, ref, FASTA, weak, n);
+      nweak_batch.insert(nweak_batch.end(), n.begin(), n.end());
+      t0+=wall_time()-tn;
+      progress_stage(MS_OUTPUT);
+    }
+    ++nbatch;
+    if ( is_journaled ) {
+      ckptregion_st cr;
+      cr.region=ichr;
+      cr.name=msc::bamRegion[ichr];
+      if ( pe_saved ) {
+	cr.pe_target=pe_target;
+	cr.pe_insert=pe_insert;
+	cr.pe_insert_sd=pe_insert_sd;
+      }
+      ckpt_pending.push_back(cr);
+    }
+    if ( !is_small || nbatch>=SMALL_BATCH ) {
+      write_cnv_to_file(strong_batch, msc::outFile, paired ? &nstrong_batch : NULL);
+      write_cnv_to_file(weak_batch, string(msc::outFile+".weak"), 
+			paired ? &nweak_batch : NULL);
+      strong_batch.clear();
+      weak_batch.clear();
+      nstrong_batch.clear();
+      nweak_batch.clear();
+      nbatch=0;
+      checkpoint_written(ckpt_pending, outputs);
+    }
+    metric_time(MS_OUTPUT, wall_time()-t0);
+    if ( msc::verbose>0 ) regioncache_report(msc::bamRegion[ichr]);
     
   } // done
+  double t0=wall_time();
+  if ( nbatch>0 ) {
+    write_cnv_to_file(strong_batch, msc::outFile, paired ? &nstrong_batch : NULL);
+    write_cnv_to_file(weak_batch, string(msc::outFile+".weak"), 
+		      paired ? &nweak_batch : NULL);
+    checkpoint_written(ckpt_pending, outputs);
+  }
+  if ( msc::shardCount>0 ) close_shard_file(msc::outFile, msc::shardIndex, msc::shardCount);
+  close_cnv_files();
+  checkpoint_close();
+  metric_time(MS_OUTPUT, wall_time()-t0);
+  prefetch_cancel(pf);
+  save_N_regions();
+  cerr << "time saved by prefetch\t" << pf_saved << "s" << endl;
+  if ( msc::verbose>0 ) regioncache_report("");
   
   if ( msc::fp_in ) samclose(msc::fp_in);
   if ( msc::bamidx )bam_index_destroy(msc::bamidx);
+  if ( normal.fp_in ) samclose(normal.fp_in);
+  if ( normal.bamidx ) bam_index_destroy(normal.bamidx);
   if ( msc::fp_out ) samclose(msc::fp_out);
   if ( msc::dumpBam && msc::outFile!="" ) bam_index_build(msc::outFile.c_str());
+  if ( msc::metricsFile!="" ) metrics_write(msc::metricsFile, wall_time()-t_start);
+  trace_close();
+  if ( msc::statusFile!="" ) progress_close();
   
   cerr << msc::execinfo << endl;
   return;
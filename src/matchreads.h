@@ -8,6 +8,18 @@
 #define TYPE_DUP 1
 #define TYPE_UNKNOWN 9
 
+//! sr_ed and sr_count of a site scored without the soft clip search, -cnv 
+//! and the normal of -bn, written as .
+#define SR_UNSCORED -2
+
+//! contigs shorter than SMALL_CONTIG are processed in batches of up to 
+//! SMALL_BATCH contigs sharing buffers and output
+#define SMALL_CONTIG 1000000
+#define SMALL_BATCH 1000
+//! a contig with fewer proper pairs uses the insert size model shared 
+//! from the last contig that had enough
+#define PE_MIN_SAMPLES 1000
+
 class msc {
 public: 
   static int verbose;
@@ -22,11 +34,25 @@ public:
   static string mycommand;
   static string execinfo;
   static string bamFile;
+  static string normalFile;
+  static bool bamStream;
+  static int shardIndex;
+  static int shardCount;
   static vector<string> bamRegion;
   static string refFile;
+  static bool refInMemory;
+  static bool refPacked;
+  static string evidenceDir;
   static string cnvFile;
   static string outFile;
+  static bool outCompress;
+  static bool outVcf;
   static string logFile;
+  static string metricsFile;
+  static string traceFile;
+  static string statusFile;
+  static bool resume;
+  static size_t memBudget;
   static string function;
   static int numThreads;
   static int maxMR;
@@ -47,12 +73,14 @@ public:
   static bool bam_is_paired;
   static bool bam_pe_disabled;
   static bool bam_pe_set_by_user;
+  static bool bam_pe_shared;
+  static bool bam_pe_genome;
+  static bool bam_pe_region;
   static int bam_pe_insert;
   static int bam_pe_insert_sd;
   static int bam_rd;
   static int bam_rd_sd;
   static int bam_tid;
-  static vector<uint8_t> bdata;
   static vector<uint8_t> bpdata;
   static vector<int32_t> rd;
   static vector<string> bam_target_name;
@@ -80,6 +108,9 @@ struct RSAI_st {        // read suffic array index
   int pos_end;          // 1-based pos of last base of read on reference
   int mms;              // mismatched wrt REF in S part of read
   int mmm;              // mismatched wrt REF in M part of read
+  int S0;               // number of S bases before calibration
+  int nN;               // number of N bases in S part
+  int bq25;             // base quality at 1/4 of S part, 255 if unknown
   RSAI_st():tid(-1),
 	    pos(0),
 	    p1(0),
@@ -92,7 +123,10 @@ struct RSAI_st {        // read suffic array index
 	    pos_beg(0),
 	    pos_end(0),
 	    mms(0),
-	    mmm(0){};
+	    mmm(0),
+	    S0(0),
+	    nN(0),
+	    bq25(0xff){};
 };
 
 struct intpair_st {     
@@ -153,13 +187,15 @@ struct pairinfo_st {
   int rd;         // read depth between F2 and R1 
   int rd_F2_100;         // read depth between F2 and R1 
   int rd_R1_100;         // read depth between F2 and R1 
+  int Q0;         // percent of reads with mapq 0 between F2 and R1, -1 until checked
+  int Q10;        // percent of reads with mapq <=10 ...
   pairinfo_st(): 
     tid(-1), F2(-1), F2_rp(-1), F2_rd(-1), F2_rd_100(-1), F2_acurate(0), 
     R1(-1), R1_rp(-1), R1_rd(-1), R1_rd_100(-1), R1_acurate(0), un(-1), 
     MS_F2(-1), MS_F2_rd(-1), MS_R1(-1), MS_R1_rd(-1), MS_ED(-1), MS_ED_count(-1), MS_S_count(-1), 
     F2_sr(-1), R1_sr(-1), sr_ed(-1), sr_count(-1),
     rpscore(-1), rdscore(-1), ddscore(-1), srscore(-1), FRrp(-1), 
-    rd(-1), rd_F2_100(-1), rd_R1_100(-1) {};
+    rd(-1), rd_F2_100(-1), rd_R1_100(-1), Q0(-1), Q10(-1) {};
 };
 
 
@@ -168,9 +204,32 @@ string tmpfile(int thread_id);
 void write_ED_st_to_file(vector<ED_st>& ed, string fn);
 
 string cnv_format1(pairinfo_st &bp);
+//! append the record of bp to s
+void cnv_format1(const pairinfo_st &bp, string& s);
 string mr_format1(pairinfo_st &bp);
 
-void get_pairend_info(int ref, int beg, int end);
+bool sort_pair_info(const pairinfo_st& p1, const pairinfo_st& p2);
+bool sort_pair_info_output(const pairinfo_st& p1, const pairinfo_st& p2);
+
+//! set bp.Q0 and bp.Q10 from the BAM unless they are known
+void check_map_quality(pairinfo_st& bp);
+
+void finalize_output(vector<pairinfo_st>& bp, 
+		     vector<pairinfo_st>& strong, 
+		     vector<pairinfo_st>& weak);
+//! with normal, the same calls scored in the normal of -bn are added
+void write_cnv_to_file(vector<pairinfo_st>& bp, string fn, 
+		       const vector<pairinfo_st>* normal=NULL);
+/*!
+  @abstract  write what -oz and -vcf kept back from write_cnv_to_file()
+
+  outFile and outFile.weak become position sorted BGZF files with a
+  tabix index with -oz, outFile.vcf(.gz) holds both with -vcf.
+*/
+void close_cnv_files();
+
+//! return the number of proper pairs sampled
+int get_pairend_info(int ref, int beg, int end);
 
 void match_MS_SM_reads(int argc, char* argv[]);
 
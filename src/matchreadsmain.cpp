@@ -32,6 +32,8 @@ using namespace std;
 #endif
 
 void match_MS_SM_reads(int argc, char* argv[]);
+void merge_shards(int argc, char* argv[]);
+void batch_run(int argc, char* argv[]);
 
 int main(int argc, char* argv[])
 {
@@ -43,7 +45,9 @@ int main(int argc, char* argv[])
   check_github_update(build_time, updateFile);
   
   time(&begin_T);
-  match_MS_SM_reads(argc, argv);  
+  if ( argc>1 && string(argv[1])=="merge" ) merge_shards(argc-1, argv+1);
+  else if ( argc>1 && string(argv[1])=="batch" ) batch_run(argc-1, argv+1);
+  else match_MS_SM_reads(argc, argv);  
   
   cerr << procpidstatus(pid,"VmPeak") ;
   time(&end_T);
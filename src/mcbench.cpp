@@ -0,0 +1,166 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "samfunctions.h"
+#include "functions.h"
+#include "matchreads.h"
+
+#include "readstore.h"
+#include "pairset.h"
+#include "preprocess.h"
+#include "pairguide.h"
+
+#include "mcbench.h"
+
+double bench_now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+//! print one timing line, rate is items per second
+static void bench_report(const string& name, size_t n, double t)
+{
+  cerr << "  " << setw(24) << left << name << right
+       << setw(10) << fixed << setprecision(3) << t << " s  "
+       << setw(14) << commify( (size_t)( t>0 ? n/t : 0 ) ) << " pairs/s\n";
+  cerr.unsetf(ios::fixed);
+  cerr << setprecision(6);
+}
+
+int usage_bench_pairs(int argc, char* argv[]) {
+  cerr << "This subroutine times sorting and clustering of discordant pairs.\n"
+       << "Pairs are simulated for one chromosome, a part of them cluster\n"
+       << "around deletions and the rest are scattered as background.\n"
+       << "\nUsage:\n" 
+       << "  " << argv[0] << " " << argv[1] << " <options>\n"
+       << "\nOptions:\n"
+       << "  -n  INT  number of pairs, default 2000000\n"
+       << "  -c  INT  number of deletions, default 20000\n"
+       << "  -p  INT  pairs per deletion, default 40\n"
+       << "  -L  INT  chromosome length, default 250000000\n"
+       << "  -r  INT  rounds, default 3\n"
+       << "\nExamples:\n"
+       << "  " << argv[0] <<  " " << argv[1] << " -n 5000000 -c 50000\n"
+       << endl;
+  
+  return(0);
+}
+
+int bench_pairs(int argc, char* argv[])
+{
+  size_t npairs=2000000;
+  int ndel=20000, perdel=40, rounds=3;
+  int chrlen=250000000;
+  
+  for(int i=2; i<argc; ++i) {
+    string a=argv[i];
+    if ( i+1>=argc ) exit( usage_bench_pairs(argc, argv) );
+    if ( a=="-n" ) npairs=atol(argv[++i]);
+    else if ( a=="-c" ) ndel=atoi(argv[++i]);
+    else if ( a=="-p" ) perdel=atoi(argv[++i]);
+    else if ( a=="-L" ) chrlen=atoi(argv[++i]);
+    else if ( a=="-r" ) rounds=atoi(argv[++i]);
+    else exit( usage_bench_pairs(argc, argv) );
+  }
+  if ( npairs<1 || chrlen<100000 || rounds<1 ) exit( usage_bench_pairs(argc, argv) );
+  
+  msc::verbose=0;
+  msc::bam_l_qseq=100;
+  msc::bam_pe_insert=400;
+  msc::bam_pe_insert_sd=50;
+  
+  // simulate pairs, the inner ends F2 and R1 of a deletion cluster spread
+  // within an insert size of the breakpoints
+  srand48(msc::seed);
+  pairset_st pairs0;
+  pairs0.reserve(npairs);
+  for(int d=0; d<ndel && pairs0.size()<npairs; ++d) {
+    int bp1=(int)( drand48()*(chrlen-200000) );
+    int bp2=bp1+1000+(int)( drand48()*100000 );
+    for(int k=0; k<perdel && pairs0.size()<npairs; ++k) {
+      int f2=bp1-(int)( drand48()*msc::bam_pe_insert );
+      int r1=bp2+(int)( drand48()*msc::bam_pe_insert );
+      bool clipped= drand48()<0.2;
+      pairs0.push_back(clipped ? bp1 : f2, clipped, clipped ? bp2 : r1, true);
+    }
+  }
+  size_t nclustered=pairs0.size();
+  while ( pairs0.size()<npairs ) {
+    int f2=(int)( drand48()*(chrlen-200000) );
+    int r1=f2+1000+(int)( drand48()*1000000 );
+    pairs0.push_back(f2, false, r1, true);
+  }
+  // pairs come out of the bam roughly sorted by the forward read
+  {
+    vector<uint32_t> idx(npairs), tmp(0);
+    vector<int32_t> key(npairs);
+    for(size_t i=0; i<npairs; ++i) {
+      idx[i]=i;
+      key[i]=pairs0.F2[i]-(int)( drand48()*msc::bam_l_qseq );
+    }
+    radix_sort_index(&key[0], idx, tmp);
+    pairs0.permute(idx);
+  }
+  
+  cerr << "pairs\t" << commify(npairs) << "\n"
+       << "clustered\t" << commify(nclustered) << "\n"
+       << "memory\t" << commify( pairs0.totalRAM() ) << " bytes as pairset_st, "
+       << commify( npairs*sizeof(intpair_st) ) << " bytes as intpair_st\n";
+  
+  double t_std=0, t_radix=0, t_cluster=0;
+  size_t nbp=0;
+  for(int r=0; r<rounds; ++r) {
+    vector<intpair_st> v(npairs);
+    for(size_t i=0; i<npairs; ++i) {
+      v[i].F2=pairs0.F2[i];
+      v[i].F2_acurate=pairs0.F2_acurate(i);
+      v[i].R1=pairs0.R1[i];
+      v[i].R1_acurate=pairs0.R1_acurate(i);
+    }
+    double t0=bench_now();
+    sort(v.begin(), v.end(), sort_pair);
+    t_std+=bench_now()-t0;
+    
+    pairset_st pairs=pairs0;
+    t0=bench_now();
+    sort_pairs_by_pos(pairs);
+    t_radix+=bench_now()-t0;
+    
+    for(size_t i=0; i<npairs; ++i) {
+      if ( v[i].F2==pairs.F2[i] && v[i].R1==pairs.R1[i] ) continue;
+      cerr << "radix sort differs from std::sort at " << i << endl;
+      exit(0);
+    }
+    
+    pairs=pairs0;
+    vector<intpair_st> bp(0);
+    t0=bench_now();
+    cluster_pair_groups(pairs, bp);
+    t_cluster+=bench_now()-t0;
+    nbp=bp.size();
+  }
+  
+  cerr << "clusters\t" << commify(nbp) << "\n"
+       << "rounds\t" << rounds << "\n";
+  bench_report("std::sort(sort_pair)", npairs*rounds, t_std);
+  bench_report("sort_pairs_by_pos", npairs*rounds, t_radix);
+  bench_report("cluster_pair_groups", npairs*rounds, t_cluster);
+  
+  return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _MCBENCH_H
+#define _MCBENCH_H
+
+//! wall clock in seconds
+double bench_now();
+
+int bench_pairs(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,34 @@
+/**** system headers ****/
+#include <iostream>
+#include <cstdlib>
+#include <string>
+using namespace std;
+
+#include "mcbench.h"
+#include "simbam.h"
+#include "kernels.h"
+
+int usage_main(int argc, char* argv[]) {
+  cerr << "mcbench times the hot paths of matchclips on synthetic data.\n"
+       << "\nUsage:\n"
+       << "  " << argv[0] << " command options\n"
+       << "\nCommands:\n"
+       << "  pairs  : sort and cluster discordant pairs\n"
+       << "  kernels: time the read matching and CIGAR kernels on a BAM\n"
+       << "  simbam : write a sorted, indexed BAM with known deletions and duplications\n"
+       << endl;
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if ( argc<2 ) exit( usage_main(argc,argv) );
+  string func=argv[1];
+  
+  if ( func=="pairs" ) bench_pairs(argc, argv);
+  else if ( func=="simbam" ) bench_simbam(argc, argv);
+  else if ( func=="kernels" ) bench_kernels(argc, argv);
+  else usage_main(argc,argv);
+  
+  exit(0);
+} 
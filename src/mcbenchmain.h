@@ -0,0 +1,4 @@
+#ifndef _MCBENCHMAIN_H
+#define _MCBENCHMAIN_H
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "metrics.h"
+#include "memtrack.h"
+
+struct memregion_st {
+  string name;
+  size_t peak;
+  size_t peak_sub[MEM_NUM];
+  int step;
+};
+
+static size_t mem_now[MEM_NUM]={0};
+static size_t mem_peak[MEM_NUM]={0};
+static size_t mem_peak_total=0;
+
+static bool in_region=false;
+static memregion_st region;
+static vector<memregion_st> regions;
+
+static const char *mem_name[MEM_NUM]={
+  "reference",
+  "read_depth",
+  "soft_clipped_reads",
+  "discordant_pairs",
+  "clip_matches",
+  "candidates",
+  "streamed_records"
+};
+
+void mem_set(int sub, size_t bytes)
+{
+  mem_now[sub]=bytes;
+  if ( bytes>mem_peak[sub] ) mem_peak[sub]=bytes;
+  size_t total=mem_total();
+  if ( total>mem_peak_total ) mem_peak_total=total;
+  if ( in_region ) {
+    if ( bytes>region.peak_sub[sub] ) region.peak_sub[sub]=bytes;
+    if ( total>region.peak ) region.peak=total;
+  }
+  return;
+}
+
+size_t mem_total()
+{
+  size_t total=0;
+  for(int i=0; i<MEM_NUM; ++i) total+=mem_now[i];
+  return total;
+}
+
+bool mem_over_budget()
+{
+  return msc::memBudget>0 && mem_total()>msc::memBudget;
+}
+
+size_t parse_mem_size(const string& s)
+{
+  char *e=NULL;
+  double x=strtod(s.c_str(), &e);
+  if ( e==s.c_str() || x<=0 ) return 0;
+  string u(e);
+  if ( u=="" || u=="M" || u=="m" ) return (size_t)(x*1048576);
+  if ( u=="G" || u=="g" ) return (size_t)(x*1073741824);
+  if ( u=="K" || u=="k" ) return (size_t)(x*1024);
+  return 0;
+}
+
+void mem_region_begin(const string& name)
+{
+  in_region=true;
+  region.name=name;
+  region.peak=mem_total();
+  for(int i=0; i<MEM_NUM; ++i) region.peak_sub[i]=mem_now[i];
+  region.step=1;
+  return;
+}
+
+void mem_region_step(int step)
+{
+  region.step=step;
+  return;
+}
+
+void mem_region_end()
+{
+  if ( !in_region ) return;
+  in_region=false;
+  regions.push_back(region);
+  cerr << "memory peak of region\t" << commify(region.peak);
+  for(int i=0; i<MEM_NUM; ++i) 
+    cerr << ( i==0 ? "\t" : ", " ) << mem_name[i] << " " << commify(region.peak_sub[i]);
+  cerr << endl;
+  return;
+}
+
+static void json_bytes(ostream& out, const size_t *bytes, const string& indent)
+{
+  out << "{\n";
+  for(int i=0; i<MEM_NUM; ++i)
+    out << indent << "  " << json_string(mem_name[i]) << ": " << bytes[i]
+	<< (i+1<MEM_NUM ? ",\n" : "\n");
+  out << indent << "}";
+  return;
+}
+
+void mem_write_json(ostream& out)
+{
+  out << "  \"memory\": {\n"
+      << "    \"budget_bytes\": " << msc::memBudget << ",\n"
+      << "    \"peak_bytes\": " << mem_peak_total << ",\n"
+      << "    \"current_bytes\": ";
+  json_bytes(out, mem_now, "    ");
+  out << ",\n    \"peak_bytes_by_subsystem\": ";
+  json_bytes(out, mem_peak, "    ");
+  out << ",\n    \"regions\": [";
+  for(size_t r=0; r<regions.size(); ++r) {
+    out << ( r==0 ? "\n" : ",\n" )
+	<< "      {\"region\": " << json_string(regions[r].name)
+	<< ", \"peak_bytes\": " << regions[r].peak
+	<< ", \"read_sampling\": " << regions[r].step;
+    for(int i=0; i<MEM_NUM; ++i)
+      out << ", " << json_string(mem_name[i]) << ": " << regions[r].peak_sub[i];
+    out << "}";
+  }
+  out << ( regions.empty() ? "]\n" : "\n    ]\n" )
+      << "  }";
+  return;
+}
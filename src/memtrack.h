@@ -0,0 +1,57 @@
+#ifndef _MEMTRACK_H
+#define _MEMTRACK_H
+
+using namespace std;
+#include <iostream>
+#include <string>
+
+/*!
+  @abstract bytes held by the large buffers of a run
+
+  each subsystem is set to the bytes of its buffers, capacity included,
+  at the points where they grow or shrink. the peak of each subsystem and
+  of their sum is kept for the run and for the current region.
+*/
+enum mem_subsystem {
+  MEM_REFERENCE,    // contig sequence, mapped or copied
+  MEM_DEPTH,        // msc::rd
+  MEM_READS,        // soft clipped reads, r_MS and r_SM
+  MEM_PAIRS,        // discordant pairs
+  MEM_MATCHES,      // ED_st of soft clip matching
+  MEM_CANDIDATES,   // pairinfo_st candidates
+  MEM_STREAM,       // records of the target read from stdin, -b -
+  MEM_NUM
+};
+
+//! soft clipped reads are not halved below this to fit the budget
+#define MEM_MIN_READS 1000
+
+//! set bytes of a subsystem, main thread only
+void mem_set(int sub, size_t bytes);
+
+//! sum of all subsystems
+size_t mem_total();
+
+//! true if a budget is set with -M and the sum is above it
+bool mem_over_budget();
+
+//! SIZE of -M, MB or with a K, M or G suffix, 0 if it can not be read
+size_t parse_mem_size(const string& s);
+
+//! peaks of a region start from the current bytes
+void mem_region_begin(const string& name);
+//! print the peak of the region and keep it for the report
+void mem_region_end();
+//! soft clipped reads of the region are kept 1 of step
+void mem_region_step(int step);
+
+//! write the "memory" member of the -metrics JSON
+void mem_write_json(ostream& out);
+
+//! the peak of a region from construction to the end of the scope
+struct memscope_st {
+  memscope_st(const string& name) { mem_region_begin(name); };
+  ~memscope_st() { mem_region_end(); };
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "metrics.h"
+#include "trace.h"
+#include "memtrack.h"
+
+long metric_count[MC_NUM]={0};
+
+static double stage_seconds[MS_NUM]={0};
+
+static const char *counter_name[MC_NUM]={
+  "reads_checked",
+  "reject_depth",
+  "reject_cigar",
+  "reject_edge",
+  "reject_short_clip",
+  "reject_long_clip",
+  "reject_clip_matches",
+  "reject_mismatches",
+  "reject_complex_cigar",
+  "reject_mapq",
+  "reject_baseq",
+  "reject_nbases",
+  "reads_kept",
+  "string_overlap_calls",
+  "string_overlap_hits",
+  "overlap_reject_errors",
+  "get_break_points_calls",
+  "breakpoint_reject_ed",
+  "breakpoint_reject_adjacent",
+  "matched_pairs",
+  "pair_candidates",
+  "clip_candidates",
+  "validated",
+  "strong_calls",
+  "weak_calls",
+  "reads_downsampled",
+  "somatic_calls"
+};
+
+static const char *stage_name[MS_NUM]={
+  "reference",
+  "ingest",
+  "pair_clustering",
+  "exhaustive_matching",
+  "validation",
+  "output"
+};
+
+const char* metric_stage_name(int stage)
+{
+  return stage_name[stage];
+}
+
+void metric_time(int stage, double seconds)
+{
+  stage_seconds[stage]+=seconds;
+  if ( trace_on() ) {
+    double t1=wall_time();
+    trace_span(stage_name[stage], "stage", t1-seconds, t1);
+  }
+  return;
+}
+
+//! value in kB of field, as VmPeak, of /proc/self/status
+static long status_kb(const string& field)
+{
+  string s=procpidstatus(getpid(), field+":");
+  size_t p=s.find(':');
+  return p==string::npos ? -1 : atol(s.c_str()+p+1);
+}
+
+string json_string(const string& s)
+{
+  string r="\"";
+  for(size_t i=0; i<s.size(); ++i) {
+    if ( s[i]=='"' || s[i]=='\\' ) r+='\\';
+    if ( (unsigned char)s[i]<0x20 ) { r+=' '; continue; }
+    r+=s[i];
+  }
+  return r+"\"";
+}
+
+void metrics_write(const string& fn, double seconds)
+{
+  ofstream FOUT(fn.c_str());
+  if ( !FOUT ) {
+    cerr << "cannot write " << fn << endl;
+    return;
+  }
+  FOUT << "{\n"
+       << "  \"command\": " << json_string(msc::mycommand) << ",\n"
+       << "  \"bam\": " << json_string(msc::bamFile) << ",\n"
+       << "  \"threads\": " << msc::numThreads << ",\n"
+       << "  \"wall_seconds\": " << seconds << ",\n"
+       << "  \"vm_peak_kb\": " << status_kb("VmPeak") << ",\n"
+       << "  \"vm_hwm_kb\": " << status_kb("VmHWM") << ",\n"
+       << "  \"stage_seconds\": {\n";
+  for(int i=0; i<MS_NUM; ++i)
+    FOUT << "    " << json_string(stage_name[i]) << ": " << stage_seconds[i]
+	 << (i+1<MS_NUM ? ",\n" : "\n");
+  FOUT << "  },\n";
+  mem_write_json(FOUT);
+  FOUT << ",\n"
+       << "  \"counters\": {\n";
+  for(int i=0; i<MC_NUM; ++i)
+    FOUT << "    " << json_string(counter_name[i]) << ": " << metric_count[i]
+	 << (i+1<MC_NUM ? ",\n" : "\n");
+  FOUT << "  }\n"
+       << "}\n";
+  FOUT.close();
+  cerr << "metrics written to " << fn << endl;
+  return;
+}
@@ -0,0 +1,73 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+using namespace std;
+#include <string>
+
+/*!
+  @abstract counters of a run, written as JSON by -metrics FILE
+
+  MC_REJECT_* count the reads dropped by each check of is_keep_read(),
+  the first failing check is counted. the matching counters are summed
+  by each thread once it returns.
+*/
+enum metric_counter {
+  MC_READS_CHECKED,
+  MC_REJECT_DEPTH,
+  MC_REJECT_CIGAR,
+  MC_REJECT_EDGE,
+  MC_REJECT_SHORT_CLIP,
+  MC_REJECT_LONG_CLIP,
+  MC_REJECT_CLIP_MATCHES,
+  MC_REJECT_MISMATCHES,
+  MC_REJECT_COMPLEX_CIGAR,
+  MC_REJECT_MAPQ,
+  MC_REJECT_BASEQ,
+  MC_REJECT_NBASES,
+  MC_READS_KEPT,
+  MC_OVERLAP_CALLS,
+  MC_OVERLAP_HITS,
+  MC_OVERLAP_REJECT_ERRORS,
+  MC_BREAKPOINT_CALLS,
+  MC_BREAKPOINT_REJECT_ED,
+  MC_BREAKPOINT_REJECT_ADJACENT,
+  MC_MATCHED_PAIRS,
+  MC_PAIR_CANDIDATES,
+  MC_CLIP_CANDIDATES,
+  MC_VALIDATED,
+  MC_STRONG_CALLS,
+  MC_WEAK_CALLS,
+  MC_READS_DOWNSAMPLED,
+  MC_SOMATIC_CALLS,
+  MC_NUM
+};
+
+//! stages timed in the main loop
+enum metric_stage {
+  MS_REFERENCE,
+  MS_INGEST,
+  MS_PAIRS,
+  MS_EXHAUSTIVE,
+  MS_VALIDATION,
+  MS_OUTPUT,
+  MS_NUM
+};
+
+extern long metric_count[MC_NUM];
+
+//! thread safe
+inline void metric_add(int id, long n=1) { __sync_fetch_and_add(&metric_count[id], n); }
+
+//! name of a metric_stage as written in the JSON
+const char* metric_stage_name(int stage);
+
+//! add seconds of wall time to stage, main thread only
+void metric_time(int stage, double seconds);
+
+//! s as a quoted JSON string
+string json_string(const string& s);
+
+//! write the counters, stage times and peak memory as JSON to fn
+void metrics_write(const string& fn, double seconds);
+
+#endif
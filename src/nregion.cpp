@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "nregion.h"
+
+size_t nregion_st::first_end_ge(int p) const
+{
+  return lower_bound(end.begin(), end.end(), p) - end.begin();
+}
+
+bool nregion_st::has_N(int p1, int p2) const
+{
+  size_t k=first_end_ge(p1);
+  return k<size() && beg[k]<=p2;
+}
+
+int nregion_st::max_overlap(int p1, int p2) const
+{
+  int o=-1;
+  for(size_t k=first_end_ge(p1); k<size() && beg[k]<=p2; ++k) 
+    o=max(o, min(end[k], p2)-max(beg[k], p1));
+  return o;
+}
+
+void build_N_regions(const string& chr, const refseq_st& fasta, nregion_st& nr)
+{
+  nr.chr=chr;
+  nr.len=fasta.size();
+  nr.beg.clear();
+  nr.end.clear();
+  // runs saved in the packed sidecar
+  if ( fasta.gaps() ) {
+    for(size_t k=0; k<fasta.ngap(); ++k) {
+      nr.beg.push_back( fasta.gaps()[2*k] );
+      nr.end.push_back( fasta.gaps()[2*k+1] );
+    }
+    return;
+  }
+  // scan line by line, memchr skips the runs without N
+  for(size_t p=0; p<fasta.size(); ) {
+    size_t n;
+    const char *s=fasta.chunk(p, n);
+    for(const char *c=s; (c=(const char*)memchr(c, 'N', s+n-c))!=NULL; ++c) {
+      int i=p+(c-s);
+      if ( nr.end.size()>0 && i==nr.end.back()+1 ) nr.end.back()=i;
+      else {
+	nr.beg.push_back(i);
+	nr.end.push_back(i);
+      }
+    }
+    p+=n;
+  }
+  return;
+}
+
+// contigs of one fasta file, loaded from and saved to the sidecar
+static string nr_fasta="";
+static string nr_stamp="";
+static map<string, nregion_st> nr_map;
+static bool nr_dirty=false;
+
+//! a sidecar made from another version of the fasta is ignored
+//! sidecar format, one block per contig:
+//!   #fasta <size> <mtime>
+//!   @chr <length> <number of gaps>
+//!   <beg> <end>
+//!   ...
+static void read_sidecar(const string& fastaFile)
+{
+  save_N_regions();
+  nr_fasta=fastaFile;
+  nr_stamp=file_stamp(fastaFile);
+  nr_map.clear();
+  
+  ifstream FIN( (fastaFile+NREGION_SUFFIX).c_str() );
+  if ( !FIN ) return;
+  string tmps;
+  getline(FIN, tmps);
+  if ( tmps!="#fasta\t"+nr_stamp ) return;
+  
+  while ( getline(FIN, tmps) ) {
+    if ( tmps.size()<1 || tmps[0]!='@' ) break;
+    istringstream iss(tmps.substr(1));
+    nregion_st nr;
+    size_t n=0;
+    if ( !(iss >> nr.chr >> nr.len >> n) ) break;
+    nr.beg.resize(n);
+    nr.end.resize(n);
+    for(size_t k=0; k<n; ++k) FIN >> nr.beg[k] >> nr.end[k];
+    getline(FIN, tmps);
+    if ( !FIN ) break;
+    nr_map[nr.chr]=nr;
+  }
+  return;
+}
+
+//! write to a temporary file and rename, readers never see a partial file
+static void write_sidecar(const string& fastaFile)
+{
+  if ( nr_stamp=="" ) return;
+  string fn=fastaFile+NREGION_SUFFIX;
+  ostringstream tmpfn;
+  tmpfn << fn << "." << getpid();
+  ofstream FOUT(tmpfn.str().c_str());
+  if ( !FOUT ) return;
+  FOUT << "#fasta\t" << nr_stamp << "\n";
+  for(map<string, nregion_st>::const_iterator it=nr_map.begin(); 
+      it!=nr_map.end(); ++it) {
+    const nregion_st& nr=it->second;
+    FOUT << "@" << nr.chr << "\t" << nr.len << "\t" << nr.size() << "\n";
+    for(size_t k=0; k<nr.size(); ++k) 
+      FOUT << nr.beg[k] << "\t" << nr.end[k] << "\n";
+  }
+  FOUT.close();
+  if ( !FOUT || rename(tmpfn.str().c_str(), fn.c_str())!=0 ) 
+    remove(tmpfn.str().c_str());
+  return;
+}
+
+void save_N_regions()
+{
+  if ( !nr_dirty ) return;
+  write_sidecar(nr_fasta);
+  nr_dirty=false;
+  return;
+}
+
+bool load_N_regions(const string& fastaFile, const string& chr, 
+		    const refseq_st& FASTA, nregion_st& nr)
+{
+  if ( fastaFile!=nr_fasta ) read_sidecar(fastaFile);
+  
+  map<string, nregion_st>::const_iterator it=nr_map.find(chr);
+  if ( it!=nr_map.end() ) {
+    nr=it->second;
+    return true;
+  }
+  
+  if ( FASTA.size()>0 ) build_N_regions(chr, FASTA, nr);
+  else {
+    refseq_st fasta;
+    if ( !fasta.load(fastaFile, chr) ) return false;
+    build_N_regions(chr, fasta, nr);
+  }
+  
+  // the sidecar is written once at exit, not once per contig
+  nr_map[chr]=nr;
+  if ( !nr_dirty ) {
+    static bool registered=false;
+    if ( !registered ) atexit(save_N_regions);
+    registered=true;
+  }
+  nr_dirty=true;
+  return true;
+}
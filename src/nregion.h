@@ -0,0 +1,58 @@
+#ifndef _NREGION_H
+#define _NREGION_H
+
+using namespace std;
+#include <string>
+#include <vector>
+#include "readref.h"
+
+//! N regions are cached in fastaFile+NREGION_SUFFIX
+#define NREGION_SUFFIX ".nreg"
+
+/*!
+  @abstract N (no sequence) gaps of one contig
+
+  @field  chr   contig name as requested
+  @field  len   contig length
+  @field  beg   0-based first base of each gap
+  @field  end   0-based last base of each gap, gaps are sorted and disjoint
+*/
+struct nregion_st {
+  string chr;
+  int len;
+  vector<int> beg;
+  vector<int> end;
+  
+  nregion_st(): chr(""), len(0) {};
+  size_t size() const { return beg.size(); }
+  
+  //! index of the first gap with end>=p, size() if none
+  size_t first_end_ge(int p) const;
+  //! true if any base in [p1,p2] (0-based, inclusive) is N
+  bool has_N(int p1, int p2) const;
+  //! longest min(end,p2)-max(beg,p1) of a single gap overlapping [p1,p2]
+  //! -1 if no gap overlaps
+  int max_overlap(int p1, int p2) const;
+};
+
+//! build the gaps of chr from its sequence
+void build_N_regions(const string& chr, const refseq_st& fasta, nregion_st& nr);
+
+/*! 
+  @abstract  get the N gaps of chr in fastaFile
+  
+  gaps are looked up in the sidecar file fastaFile.nreg first, which is
+  rebuilt when fastaFile changes. if chr is not in the sidecar, the gaps
+  are computed from FASTA, or mapped from fastaFile if FASTA is empty, and the
+  sidecar is updated at exit or by save_N_regions().
+  
+  @return    false if chr can not be loaded from fastaFile, nr is then
+             left as it was
+*/
+bool load_N_regions(const string& fastaFile, const string& chr, 
+		    const refseq_st& FASTA, nregion_st& nr);
+
+//! write the sidecar if contigs were added since it was loaded
+void save_N_regions();
+
+#endif
@@ -22,9 +22,15 @@ using namespace std;
 #include "functions.h"
 #include "matchreads.h"
 
+#include "readstore.h"
+#include "pairset.h"
 #include "preprocess.h"
 #include "exhaustive.h"
 #include "pairguide.h"
+#include "regioncache.h"
+#include "bamstream.h"
+#include "metrics.h"
+#include "progress.h"
 
 void check_read_pair_ends(const bam1_t *b )
 {
@@ -184,7 +190,7 @@ int check_normalpairs_cross_pos(int ref, int end)
 
   bam1_t *b=NULL;   
   b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   
   int dx = msc::bam_pe_insert+5*msc::bam_pe_insert_sd;
   
@@ -192,9 +198,9 @@ int check_normalpairs_cross_pos(int ref, int end)
   int beg=end-dx;
   if (beg<1) beg=1;
   
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
+  iter = region_query(ref, beg, end);
   int d1=0;
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  while( region_read(iter, b)>0 ) {
     if ( b->core.tid!=ref || b->core.pos>end ) break;
     if ( ! is_read_count_for_pair(b) ) continue;
     // since we checked in [end-dx, end], we need FORWARD
@@ -209,8 +215,9 @@ int check_normalpairs_cross_pos(int ref, int end)
   
   if ( d1<10 ) {
     int d2=0;
-    iter = bam_iter_query(msc::bamidx, ref, end, end+dx);
-    while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+    region_destroy(iter);
+    iter = region_query(ref, end, end+dx);
+    while( region_read(iter, b)>0 ) {
       if ( b->core.tid!=ref || b->core.pos>end ) break;
       if ( ! is_read_count_for_pair(b) ) continue;
       // since we checked in [end, end+dx], we need REVERSE
@@ -226,7 +233,7 @@ int check_normalpairs_cross_pos(int ref, int end)
   }
   
   if ( b ) bam_destroy1(b);
-  if ( iter ) bam_iter_destroy(iter);
+  if ( iter ) region_destroy(iter);
   
   return d1;
 }
@@ -243,7 +250,7 @@ void check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
   
   bam1_t *b=NULL;   
   b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   int beg,end;
   
   int dx = msc::bam_pe_insert+5*msc::bam_pe_insert_sd;
@@ -251,8 +258,8 @@ void check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
   size_t p_F2R1_LS=0;
   beg=max(1, F2-dx);
   end=F2;
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     if ( b->core.tid!=ref ) break;
     if ( !is_read_count_for_pair(b) ) continue; 
     if ( b->core.flag & BAM_FREVERSE ) continue;  // since we checked -dx, we need FORWARD
@@ -295,8 +302,9 @@ void check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
   size_t p_F2R1_RS=0;
   beg=R1;
   end=R1+dx;
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  region_destroy(iter);
+  iter = region_query(ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     if ( b->core.tid!=ref ) break;
     if ( !is_read_count_for_pair(b) ) continue; 
     if ( ! (b->core.flag & BAM_FREVERSE) ) continue;  // since we checked +dx, we need R
@@ -343,7 +351,7 @@ void check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
   if ( p_R1 < 10 ) p_R1=check_normalpairs_cross_pos(ref, R1); 
   
   bam_destroy1(b);
-  bam_iter_destroy(iter);
+  region_destroy(iter);
   
   return;
 }
@@ -415,138 +423,146 @@ void stat_and_filter_pair_group(vector<intpair_st>& bpi, vector<pairinfo_st>& bp
 //! get the most possible brreak points
 //! for F2, get the right most position
 //! for R1, get the left most position
-void kmean_pairgroup(vector<intpair_st>& pairs, vector<intpair_st>& bp)
+void kmean_pairgroup(const pairset_st& pairs, size_t gbeg, size_t gend, 
+		     vector<intpair_st>& bp)
 {
   bp.clear();
-  if ( pairs.size()<1 ) return;
+  if ( gend<=gbeg ) return;
   
   int pair_gap=msc::bam_pe_insert+msc::bam_pe_insert_sd*5;
   
-  vector<int> len(pairs.size());
-  sort(pairs.begin(), pairs.end(), sort_pair_len);
-  for(size_t i=0; i<pairs.size(); ++i) len[i]=pairs[i].R1-pairs[i].F2;
-  //  sort(len.begin(),len.end());
+  // sort pairs in the group by pair length
+  size_t n=gend-gbeg;
+  vector<int32_t> len(n);
+  vector<uint32_t> idx(n), tmp(0);
+  for(size_t i=0; i<n; ++i) {
+    len[i]=pairs.R1[gbeg+i]-pairs.F2[gbeg+i];
+    idx[i]=i;
+  }
+  radix_sort_index(&len[0], idx, tmp);
   
-  // cluster according to pair length and remove outliers
+  // cluster according to pair length, clusters are contiguous ranges
+  // in sorted order starting at cs[j]
   vector<int> g(0);       // cluster value
-  vector<int> gc(0);      // cluster count
-  vector<int> gi(len.size(),0); // cluster assignment
-  g.push_back(len[0]);
-  for(size_t i=0; i<len.size(); ++i) {
-    if ( len[i]-g.back() <= pair_gap ) gi[i]=g.size()-1;
-    else {
-      g.push_back( len[i] );
-      gi[i]=g.size()-1;
-    }
+  vector<size_t> cs(0);   // cluster start in idx
+  g.push_back(len[ idx[0] ]);
+  cs.push_back(0);
+  for(size_t i=0; i<n; ++i) {
+    if ( len[ idx[i] ]-g.back() <= pair_gap ) continue;
+    g.push_back( len[ idx[i] ] );
+    cs.push_back(i);
   }
+  cs.push_back(n);
   
   // a cluster should have at least six pairs msc::minClusterSize=6
   // roughly 3 templates ( 6 segments ) 
-  gc.resize(g.size());
-  for(size_t i=0; i<len.size(); ++i) ++gc[ gi[i] ];
   if ( msc::verbose>1 ) 
     cerr << "density cluster\t" << g.size() << endl;
+  int good_pair_count=0;
   for(int j=0; j<(int)g.size(); ++j) {
+    int gc=cs[j+1]-cs[j];
     bool del=false;
-    if ( (double)gc[j]/(double)len.size() < 0.1 
-	 || gc[j]<msc::minClusterSize ) del=true;
-    if ( gc[j] > msc::minClusterSize ) del=false;
+    if ( (double)gc/(double)n < 0.1 
+	 || gc<msc::minClusterSize ) del=true;
+    if ( gc > msc::minClusterSize ) del=false;
     if ( msc::verbose>1 ) { 
       cerr << "cluster " << j << "\t" 
 	   << g[j] << "\t" 
-	   << gc[j] << "\t" 
-	   << (float)gc[j]/len.size();
+	   << gc << "\t" 
+	   << (float)gc/n;
       if ( del ) cerr << "\tx";
       cerr << endl;
     }
-    if ( del ) {
-      for(size_t i=0;i<gi.size();++i) if ( gi[i]==j ) gi[i]=-1;
-    }
-  }
-  
-  int good_pair_count=0;
-  for(size_t i=0; i<pairs.size(); ++i) if ( gi[i]!=-1 ) ++good_pair_count;
-  if ( msc::verbose>1 )     
-    cerr << "cluster purified\t" << len.size() << "\t" << good_pair_count << endl;
-  
-  // get break points from the clusters
-  for(int j=0; j<(int)g.size(); ++j) {
-    vector<intpair_st> tmp(0);
-    for(size_t i=0; i<pairs.size(); ++i) 
-      if ( gi[i]==j ) tmp.push_back( pairs[i] );
-    if ( tmp.size()==0 ) continue;
-    intpair_st ibp=tmp[0];
-    for(size_t i=0; i<tmp.size(); ++i) {
+    if ( del ) continue;
+    good_pair_count+=gc;
+    
+    // get break points from the cluster
+    size_t i0=gbeg+idx[ cs[j] ];
+    intpair_st ibp;
+    ibp.F2=pairs.F2[i0];
+    ibp.F2_acurate=pairs.F2_acurate(i0);
+    ibp.R1=pairs.R1[i0];
+    ibp.R1_acurate=pairs.R1_acurate(i0);
+    for(size_t k=cs[j]; k<cs[j+1]; ++k) {
+      size_t i=gbeg+idx[k];
       // infer F2
-      if ( tmp[i].F2_acurate && (!ibp.F2_acurate) ) {
-	ibp.F2=tmp[i].F2;
-	ibp.F2_acurate=tmp[i].F2_acurate;
+      if ( pairs.F2_acurate(i) && (!ibp.F2_acurate) ) {
+	ibp.F2=pairs.F2[i];
+	ibp.F2_acurate=true;
       }
-      if ( tmp[i].F2_acurate && tmp[i].F2>=ibp.F2 ) {
-	ibp.F2=tmp[i].F2;
-	ibp.F2_acurate=tmp[i].F2_acurate;
+      if ( pairs.F2_acurate(i) && pairs.F2[i]>=ibp.F2 ) {
+	ibp.F2=pairs.F2[i];
+	ibp.F2_acurate=true;
       }
       // note R1 must be always acurate
-      if ( tmp[i].R1_acurate && tmp[i].R1<=ibp.R1 ) {
-	ibp.R1=tmp[i].R1;
-	ibp.R1_acurate=tmp[i].R1_acurate;
+      if ( pairs.R1_acurate(i) && pairs.R1[i]<=ibp.R1 ) {
+	ibp.R1=pairs.R1[i];
+	ibp.R1_acurate=true;
       }
     }
-    ibp.FRrp=tmp.size();
+    ibp.FRrp=gc;
     bp.push_back(ibp);
   }
   
-  // make sure all pairs counted
-  for(int i=0; i<(int)bp.size(); ++i) {
-    good_pair_count-=bp[i].FRrp;
-    if ( msc::verbose>1 )     
+  if ( msc::verbose>1 )     
+    cerr << "cluster purified\t" << n << "\t" << good_pair_count << endl;
+  
+  if ( msc::verbose>1 ) {
+    for(int i=0; i<(int)bp.size(); ++i) 
       cerr << "cluster identified " << i << "\t"
 	   << bp[i].F2_acurate << "\t" << bp[i].F2 << "\t"
 	   << bp[i].R1_acurate << "\t" << bp[i].R1 << "\t"
 	   << bp[i].FRrp << "\n" << endl;
   }
-  if ( good_pair_count != 0 ) 
-    cerr << "not all pairs counted from the clusters" << endl;
   
+  return;
 }
 
 //! sort pairs according to F2
-//! roughly break them to clusters according to gap between pairs
-//! call kmean to do fine clustering
-void check_pair_group(vector<intpair_st>& pairs, vector<pairinfo_st>& bpinfo)
+//! roughly break them to groups according to gap between pairs
+//! call kmean to do fine clustering within each group
+void cluster_pair_groups(pairset_st& pairs, vector<intpair_st>& bp)
 {
-  bpinfo.clear();
-  vector<intpair_st> bp(0);
+  bp.clear();
   if ( pairs.size()<1 ) return;
-  if ( msc::verbose>0 ) cerr << "total pairs:" << pairs.size() << endl;
   
   int pair_gap=msc::bam_pe_insert+msc::bam_pe_insert_sd*5-msc::bam_l_qseq/2;
   
-  vector<intpair_st> pairgroup(0);    
-  sort(pairs.begin(), pairs.end(), sort_pair);
+  sort_pairs_by_pos(pairs);
   
   vector<intpair_st> bp0(0);
-  pairgroup.push_back( pairs[0] );
-  for(size_t i=1; i<pairs.size(); ++i) {
-    if ( pairs[i].F2 - pairs[i-1].F2 > pair_gap ) {
-      // cerr << "------------\t" << pairgroup.size() << endl;
-      if ( (int)pairgroup.size()<msc::minClusterSize ) pairgroup.clear();
-      kmean_pairgroup(pairgroup, bp0);
-      pairgroup.clear();
-      if ( bp0.size()>0 ) bp.insert(bp.end(), bp0.begin(), bp0.end());
+  size_t gbeg=0;
+  for(size_t i=1; i<=pairs.size(); ++i) {
+    bool last= ( i==pairs.size() );
+    if ( !last && msc::verbose>2 ) {
+      cerr << pairs.F2_acurate(i) << "\t" << pairs.F2[i] << "\t" 
+	   << pairs.R1_acurate(i) << "\t" << pairs.R1[i] << "\t" 
+	   << pairs.F2[i]-pairs.R1[i] << endl;
     }
+    if ( !last && pairs.F2[i] - pairs.F2[i-1] <= pair_gap ) continue;
     
-    if ( msc::verbose>2 ) {
-      cerr << pairs[i].F2_acurate << "\t" << pairs[i].F2 << "\t" 
-	   << pairs[i].R1_acurate << "\t" << pairs[i].R1 << "\t" 
-	   << pairs[i].F2-pairs[i].R1 << endl;
+    // the last group only needs 3 pairs
+    int min_size= last ? 3 : msc::minClusterSize;
+    if ( (int)(i-gbeg) >= min_size ) {
+      kmean_pairgroup(pairs, gbeg, i, bp0);
+      if ( bp0.size()>0 ) bp.insert(bp.end(), bp0.begin(), bp0.end());
     }
-    pairgroup.push_back( pairs[i] );
+    gbeg=i;
   }
-  if ( pairgroup.size()<3 ) pairgroup.clear();
-  kmean_pairgroup(pairgroup, bp0);
-  if ( bp0.size()>0 ) bp.insert(bp.end(), bp0.begin(), bp0.end());
-  pairgroup.clear();
+  
+  return;
+}
+
+//! cluster discordant pairs
+//! check read depth and normal pairs around each cluster
+void check_pair_group(pairset_st& pairs, vector<pairinfo_st>& bpinfo)
+{
+  bpinfo.clear();
+  vector<intpair_st> bp(0);
+  if ( pairs.size()<1 ) return;
+  if ( msc::verbose>0 ) cerr << "total pairs:" << pairs.size() << endl;
+  
+  cluster_pair_groups(pairs, bp);
   
   if ( msc::verbose>0 ) {
     cerr << "clusters found --- " << bp.size() << endl;
@@ -578,10 +594,10 @@ void check_pair_group(vector<intpair_st>& pairs, vector<pairinfo_st>& bpinfo)
     if ( dx/3 > abs(bp[i].F2-bp[i].R1) ) dx=abs(bp[i].F2-bp[i].R1)*3;
     if ( dx < msc::bam_l_qseq ) dx = msc::bam_l_qseq;
     
-    check_cnv_readdepth(msc::bam_ref, ibp.F2, ibp.R1, dx, 
+    cached_check_cnv_readdepth(msc::bam_ref, ibp.F2, ibp.R1, dx, 
 			ibp.F2_rd, ibp.R1_rd, ibp.rd);
     
-    check_cnv_readdepth_100(msc::bam_ref, ibp.F2, ibp.R1, 
+    cached_check_cnv_readdepth_100(msc::bam_ref, ibp.F2, ibp.R1, 
 			    ibp.F2_rd_100, ibp.rd_F2_100,  
 			    ibp.rd_R1_100, ibp.R1_rd_100);
     
@@ -603,7 +619,7 @@ void check_pair_group(vector<intpair_st>& pairs, vector<pairinfo_st>& bpinfo)
 //! reads around R1 are collected
 //! check if two reads from each group match
 //! get the break points
-void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool pointmode)
+void match_reads_for_pairs(pairinfo_st& ipairbp, const refseq_st& FASTA, int dx, bool pointmode)
 {
   // these are return values
   ipairbp.MS_F2=-1;
@@ -614,12 +630,9 @@ void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool poi
   bool with_matching_reads=false;
 
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=NULL;
+  region_iter_t iter=NULL;
   
-  vector<uint8_t> bdata(0); bdata.reserve(3000000);
-  vector<bam1_t> b_F2(0);
-  vector<bam1_t> b_R1(0);
-  bam1_t ibam;
+  readstore_st r_F2, r_R1;
   
   if ( dx<1 ) dx=msc::bam_l_qseq/4;
   int beg,end, MS_F2_rd=0, MS_R1_rd=0;
@@ -627,8 +640,8 @@ void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool poi
   // get reads around F2
   beg=max(1, ipairbp.F2-dx);
   end=ipairbp.F2+dx;
-  iter = bam_iter_query(msc::bamidx, msc::bam_ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(msc::bam_ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     if ( b->core.tid != msc::bam_ref ) break;
     if ( b->core.pos > end ) break;
     if ( ! is_read_count_for_depth(b) ) continue;
@@ -642,16 +655,17 @@ void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool poi
       if ( ! is_cover ) continue;
     }
     
-    _save_read_in_vector(b, ibam, bdata);
-    b_F2.push_back(ibam);
+    r_F2.add(b, FASTA);
   }
   ipairbp.MS_F2_rd=MS_F2_rd;
   
+  region_destroy(iter);
+  
   // get reads around R1
   beg=max(1, ipairbp.R1-dx);
   end=ipairbp.R1+dx;
-  iter = bam_iter_query(msc::bamidx, msc::bam_ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(msc::bam_ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     if ( b->core.tid != msc::bam_ref ) break;
     if ( b->core.pos > end ) break;
     if ( ! is_read_count_for_depth(b) ) continue;
@@ -665,21 +679,17 @@ void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool poi
       if ( ! is_cover ) continue;
     }
     
-    _save_read_in_vector(b, ibam, bdata);
-    b_R1.push_back(ibam);
+    r_R1.add(b, FASTA);
   }
   ipairbp.MS_R1_rd=MS_R1_rd;
   
   if ( b ) bam_destroy1(b);
-  if ( iter ) bam_iter_destroy(iter);
-  
-  for(size_t i=0; i<b_F2.size(); ++i) b_F2[i].data = &bdata[(size_t)b_F2[i].data];
-  for(size_t i=0; i<b_R1.size(); ++i) b_R1[i].data = &bdata[(size_t)b_R1[i].data];
+  if ( iter ) region_destroy(iter);
   
-  if ( b_F2.size()<1 || b_R1.size()<1 ) with_matching_reads=false;
+  if ( r_F2.size()<1 || r_R1.size()<1 ) with_matching_reads=false;
   
   vector<ED_st> bp(0); 
-  multithreads_read_matching(b_F2, b_R1, FASTA, -1, bp);
+  multithreads_read_matching(r_F2, r_R1, FASTA, -1, bp);
   
   int min_ED=msc::bam_l_qseq*2;
   for(size_t i=0; i<bp.size(); ++i) {
@@ -734,8 +744,8 @@ void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool poi
     //	 << endl;
   }
   
-  vector<int> b_MS_m(b_F2.size(), 0);
-  vector<int> b_SM_m(b_R1.size(), 0);
+  vector<int> b_MS_m(r_F2.size(), 0);
+  vector<int> b_SM_m(r_R1.size(), 0);
   if ( best_ED.size()>0 ) {
     for(size_t i=0; i<bp.size(); ++i) {
       if ( abs(bp[i].F2-best_ED[it].F2)<10 &&
@@ -776,14 +786,10 @@ void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool poi
 	 << endl;
   }
   
-  //  vector<uint8_t> (0).swap(msc::bpdata);
-  vector<uint8_t> (0).swap(bdata);
-  vector<bam1_t> (0).swap(b_F2);
-  vector<bam1_t> (0).swap(b_R1);
   return;
 }
 
-void match_reads_for_pairs(vector<pairinfo_st>& pairbp, string& FASTA, int dx, bool pointmode)
+void match_reads_for_pairs(vector<pairinfo_st>& pairbp, const refseq_st& FASTA, int dx, bool pointmode)
 {
   if ( dx<1 ) dx=msc::bam_l_qseq/4;
   int pair_supported=0;
@@ -796,13 +802,13 @@ void match_reads_for_pairs(vector<pairinfo_st>& pairbp, string& FASTA, int dx, b
 }
 
 void get_abnormal_pairs(int ref, int beg, int end, int min_pair_length,
-			vector<intpair_st>& pairs)
+			pairset_st& pairs)
 {
   pairs.clear();
   if ( ! msc::bam_is_paired ) return;
   
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   
   //! collect read pairs
   cerr << "processing pairs in:\t" 
@@ -813,9 +819,9 @@ void get_abnormal_pairs(int ref, int beg, int end, int min_pair_length,
   
   intpair_st ipair;
   
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
+  iter = region_query(ref, beg, end);
   size_t count=0;
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  while( region_read(iter, b)>0 ) {
     count++;
     if ( count%1000000==0 ) {
       cerr << "#processed " << commify(count) << " reads at pos " 
@@ -826,38 +832,50 @@ void get_abnormal_pairs(int ref, int beg, int end, int min_pair_length,
     if ( abs(b->core.isize) < min_pair_length ) continue;
     if ( ! is_read_count_for_pair(b) ) continue;
     check_inner_pair_ends(b, ipair.F2, ipair.F2_acurate, ipair.R1, ipair.R1_acurate);
-    if ( ipair.F2>0 && ipair.R1>0 ) pairs.push_back(ipair);
+    if ( ipair.F2>0 && ipair.R1>0 ) 
+      pairs.push_back(ipair.F2, ipair.F2_acurate, ipair.R1, ipair.R1_acurate);
   }
   
   bam_destroy1(b);
-  bam_iter_destroy(iter);
+  region_destroy(iter);
   return;
 }
 
-void pair_guided_search(vector<intpair_st>& pairs, string& FASTA, 
+void pair_guided_search(pairset_st& pairs, const refseq_st& FASTA, 
 			vector<pairinfo_st>& pairbp) 
 			
 {
+  progress_stage(MS_PAIRS);
+  double t0=wall_time();
   check_pair_group(pairs, pairbp); 
-  vector<intpair_st> (0).swap(pairs);
+  pairs.clear();
+  metric_add(MC_PAIR_CANDIDATES, pairbp.size());
+  metric_time(MS_PAIRS, wall_time()-t0);
+  t0=wall_time();
   
   for(int i=0; i<(int) pairbp.size(); ++i) pairbp[i].tid=msc::bam_ref;
+  progress_stage(MS_VALIDATION);
 
   pairinfo_st ibp;
   
   size_t count=0;
   for (size_t i=0; i<pairbp.size(); ++i) {
-    string cnv=cnv_format1(pairbp[i]);
-    for(size_t t=0; t<cnv.size(); ++t) if ( cnv[t]=='\t' ) cnv[t]=' ';
-    cerr << "checking: " << cnv << endl;
+    progress_candidates(i, pairbp.size());
+    string cnv;
+    if ( msc::verbose>0 ) {
+      cnv=cnv_format1(pairbp[i]);
+      for(size_t t=0; t<cnv.size(); ++t) if ( cnv[t]=='\t' ) cnv[t]=' ';
+      cerr << "checking: " << cnv << endl;
+    }
     
     int old_minOverlap = msc::minOverlap;
     msc::minOverlap += msc::minOverlapPlus;  
+    metric_add(MC_VALIDATED);
     match_reads_for_pairs(pairbp[i], FASTA, 0, false);
     msc::minOverlap = old_minOverlap;  
     
     assess_rd_rp_sr_infomation( pairbp[i] );
-    cerr << "matched:  " << mr_format1(pairbp[i]) << endl;
+    if ( msc::verbose>0 ) cerr << "matched:  " << mr_format1(pairbp[i]) << endl;
     // update pos and check rd and rp info
     //if ( pairbp[i].srscore>0 && 
     //	 abs(pairbp[i].F2-pairbp[i].MS_F2)<msc::bam_l_qseq/2 && 
@@ -868,9 +886,11 @@ void pair_guided_search(vector<intpair_st>& pairs, string& FASTA,
       ibp.R1=ibp.MS_R1;
       stat_region( ibp, FASTA, msc::bam_l_qseq*4 );
       assess_rd_rp_sr_infomation( ibp );
-      cnv=cnv_format1(ibp);
-      for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
-      cerr << "matched:  " << cnv << endl;
+      if ( msc::verbose>0 ) {
+	cnv=cnv_format1(ibp);
+	for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
+	cerr << "matched:  " << cnv << endl;
+      }
       if ( ibp.rdscore>=2 || 
 	   ibp.rpscore>=2 ||
 	   ibp.rpscore>=pairbp[i].rpscore ||
@@ -878,25 +898,28 @@ void pair_guided_search(vector<intpair_st>& pairs, string& FASTA,
     }
     count += ( pairbp[i].srscore>0 )  ;
     
-    cnv=cnv_format1(pairbp[i]);
-    for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
-    cerr << "updated:  " << cnv << "\n" << endl;
+    if ( msc::verbose>0 ) {
+      cnv=cnv_format1(pairbp[i]);
+      for(size_t t=0; t<cnv.size(); ++t) if (cnv[t]=='\t') cnv[t]=' ';
+      cerr << "updated:  " << cnv << "\n" << endl;
+    }
   }
   cerr << "matching support " << count << " out of " << pairbp.size() << "\n"
        << "pair end mode done\n"
        << endl;;
+  metric_time(MS_VALIDATION, wall_time()-t0);
   
   // now information is complete
   return;
 }
 
-void pair_guided_search(int ref, int beg, int end, int min_pair_length, string& FASTA,
+void pair_guided_search(int ref, int beg, int end, int min_pair_length, const refseq_st& FASTA,
 			vector<pairinfo_st>& pairbp) 
 {
   pairbp.clear();
   if ( ! msc::bam_is_paired ) return;
   
-  vector<intpair_st> pairs(0);
+  pairset_st pairs;
   get_abnormal_pairs(ref, beg, end, min_pair_length, pairs);
 
   pair_guided_search(pairs, FASTA, pairbp);
@@ -14,20 +14,28 @@ int check_abnormalpairs_cross_region(int ref, int F2, int R1);
 void check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
 						 int& p_F2, int& p_R1, int& p_F2R1);
 
-void check_pair_group(vector<intpair_st>& pairs, vector<pairinfo_st>& bpinfo);
+void kmean_pairgroup(const pairset_st& pairs, size_t gbeg, size_t gend, 
+		     vector<intpair_st>& bp);
 
-void get_break_points(const string& FASTA, bam1_t *bF2, bam1_t *bR1, int p1, vector<int>& p_err, int& F2, int& R1, int& e_dis);
+void cluster_pair_groups(pairset_st& pairs, vector<intpair_st>& bp);
 
-void match_reads_for_pairs(pairinfo_st& ipairbp, string& FASTA, int dx, bool pointmode);
-void match_reads_for_pairs(vector<pairinfo_st>& pairbp, string& FASTA, int dx, bool pointmode);
+void check_pair_group(pairset_st& pairs, vector<pairinfo_st>& bpinfo);
+
+void get_break_points(const refseq_st& FASTA, 
+		      const readstore_st& rF2, size_t iF2, 
+		      const readstore_st& rR1, size_t iR1, int p1, 
+		      int& F2, int& R1, int& e_dis);
+
+void match_reads_for_pairs(pairinfo_st& ipairbp, const refseq_st& FASTA, int dx, bool pointmode);
+void match_reads_for_pairs(vector<pairinfo_st>& pairbp, const refseq_st& FASTA, int dx, bool pointmode);
 
 void stat_pair_group(vector<pairinfo_st>& bp);
 
 void stat_pair_group(vector<intpair_st>& bp, vector<pairinfo_st>& bpinfo) ;
 
-void pair_guided_search(vector<intpair_st>& pairs, string& FASTA, 
+void pair_guided_search(pairset_st& pairs, const refseq_st& FASTA, 
 			vector<pairinfo_st>& pairbp) ;
-void pair_guided_search(int ref, int beg, int end, int min_pair_length, string& FASTA,
+void pair_guided_search(int ref, int beg, int end, int min_pair_length, const refseq_st& FASTA,
 			vector<pairinfo_st>& pairbp) ;
 
 #endif
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+/**** user headers ****/
+#include "pairset.h"
+
+// 11+11+10 bits for a 32 bit key
+#define RADIX_BITS 11
+#define RADIX_SIZE (1<<RADIX_BITS)
+#define RADIX_PASSES 3
+
+void pairset_st::clear()
+{
+  vector<int32_t> (0).swap(F2);
+  vector<int32_t> (0).swap(R1);
+  vector<uint8_t> (0).swap(flag);
+}
+
+void pairset_st::reset()
+{
+  if ( F2.capacity()>PAIRSET_KEEP ) {
+    clear();
+    return;
+  }
+  F2.clear();
+  R1.clear();
+  flag.clear();
+}
+
+void pairset_st::reserve(size_t n)
+{
+  F2.reserve(n);
+  R1.reserve(n);
+  flag.reserve(n);
+}
+
+void pairset_st::push_back(int f2, bool f2_acurate, int r1, bool r1_acurate)
+{
+  F2.push_back(f2);
+  R1.push_back(r1);
+  flag.push_back( (f2_acurate ? PAIR_F2_ACURATE : 0) | (r1_acurate ? PAIR_R1_ACURATE : 0) );
+}
+
+void pairset_st::filter(const vector<bool>& keep)
+{
+  size_t k=0;
+  for(size_t i=0; i<size(); ++i) {
+    if ( !keep[i] ) continue;
+    F2[k]=F2[i];
+    R1[k]=R1[i];
+    flag[k]=flag[i];
+    ++k;
+  }
+  F2.resize(k);
+  R1.resize(k);
+  flag.resize(k);
+}
+
+void pairset_st::permute(const vector<uint32_t>& idx)
+{
+  vector<int32_t> v(idx.size());
+  for(size_t i=0; i<idx.size(); ++i) v[i]=F2[ idx[i] ];
+  F2.swap(v);
+  for(size_t i=0; i<idx.size(); ++i) v[i]=R1[ idx[i] ];
+  R1.swap(v);
+  vector<uint8_t> f(idx.size());
+  for(size_t i=0; i<idx.size(); ++i) f[i]=flag[ idx[i] ];
+  flag.swap(f);
+}
+
+size_t pairset_st::totalRAM() const
+{
+  return sizeof(*this)
+    + F2.capacity()*sizeof(int32_t)
+    + R1.capacity()*sizeof(int32_t)
+    + flag.capacity();
+}
+
+void radix_sort_index(const int32_t *key, vector<uint32_t>& idx,
+		      vector<uint32_t>& tmp)
+{
+  size_t n=idx.size();
+  if ( n<2 ) return;
+  tmp.resize(n);
+
+  // keys are carried along with idx so that every pass reads sequentially
+  vector<uint32_t> k(n), ktmp(n);
+  bool sorted=true;
+  for(size_t i=0; i<n; ++i) {
+    k[i]=(uint32_t)key[ idx[i] ] ^ 0x80000000u;
+    if ( i>0 && k[i]<k[i-1] ) sorted=false;
+  }
+  if ( sorted ) return;
+
+  // histograms of all digits in one pass
+  vector<uint32_t> count(RADIX_PASSES*RADIX_SIZE, 0);
+  for(size_t i=0; i<n; ++i) 
+    for(int d=0; d<RADIX_PASSES; ++d) 
+      ++count[ d*RADIX_SIZE + ( (k[i]>>(d*RADIX_BITS)) & (RADIX_SIZE-1) ) ];
+  
+  for(int d=0; d<RADIX_PASSES; ++d) {
+    uint32_t *c=&count[d*RADIX_SIZE];
+    int shift=d*RADIX_BITS;
+    // all keys fall in one bucket, nothing to do for this digit
+    if ( c[ (k[0]>>shift) & (RADIX_SIZE-1) ]==n ) continue;
+
+    uint32_t sum=0;
+    for(int j=0; j<RADIX_SIZE; ++j) {
+      uint32_t cj=c[j];
+      c[j]=sum;
+      sum+=cj;
+    }
+    for(size_t i=0; i<n; ++i) {
+      uint32_t o=c[ (k[i]>>shift) & (RADIX_SIZE-1) ]++;
+      ktmp[o]=k[i];
+      tmp[o]=idx[i];
+    }
+    k.swap(ktmp);
+    idx.swap(tmp);
+  }
+  return;
+}
+
+void sort_pairs_by_pos(pairset_st& pairs)
+{
+  if ( pairs.size()<2 ) return;
+  vector<uint32_t> idx(pairs.size()), tmp(0);
+  for(size_t i=0; i<idx.size(); ++i) idx[i]=i;
+  radix_sort_index(&pairs.F2[0], idx, tmp);
+
+  // pairs sharing F2 are few, order them by R1 with a stable insertion sort
+  const int32_t *F2=&pairs.F2[0];
+  const int32_t *R1=&pairs.R1[0];
+  size_t n=idx.size();
+  for(size_t beg=0, end=1; beg<n; beg=end, end=beg+1) {
+    while ( end<n && F2[ idx[end] ]==F2[ idx[beg] ] ) ++end;
+    for(size_t i=beg+1; i<end; ++i) {
+      uint32_t x=idx[i];
+      size_t j=i;
+      for( ; j>beg && R1[ idx[j-1] ]>R1[x]; --j) idx[j]=idx[j-1];
+      idx[j]=x;
+    }
+  }
+  pairs.permute(idx);
+  return;
+}
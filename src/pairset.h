@@ -0,0 +1,49 @@
+#ifndef _PAIRSET_H
+#define _PAIRSET_H
+
+using namespace std;
+#include <vector>
+#include <inttypes.h>
+
+#define PAIR_F2_ACURATE 1
+#define PAIR_R1_ACURATE 2
+#define PAIRSET_KEEP (1<<20)
+
+/*!
+  @abstract discordant pairs saved as structure of arrays
+
+  @field  F2    inner end of the forward read, see check_inner_pair_ends()
+  @field  R1    inner end of the reverse read
+  @field  flag  PAIR_F2_ACURATE | PAIR_R1_ACURATE
+*/
+struct pairset_st {
+  vector<int32_t> F2;
+  vector<int32_t> R1;
+  vector<uint8_t> flag;
+
+  size_t size() const { return F2.size(); }
+  void clear();
+  //! drop all pairs, capacity is kept unless it is above PAIRSET_KEEP
+  void reset();
+  void reserve(size_t n);
+  void push_back(int f2, bool f2_acurate, int r1, bool r1_acurate);
+  bool F2_acurate(size_t i) const { return flag[i] & PAIR_F2_ACURATE; }
+  bool R1_acurate(size_t i) const { return flag[i] & PAIR_R1_ACURATE; }
+
+  //! keep pairs with keep[i] true, order is preserved
+  void filter(const vector<bool>& keep);
+  //! reorder pairs so that new pair i is old pair idx[i]
+  void permute(const vector<uint32_t>& idx);
+
+  size_t totalRAM() const;
+};
+
+//! stable LSD radix sort of idx by key[idx[i]], key is treated as signed
+//! tmp is a work buffer of the same size as idx
+void radix_sort_index(const int32_t *key, vector<uint32_t>& idx,
+		      vector<uint32_t>& tmp);
+
+//! sort pairs by F2 then by R1, pairs with the same F2 and R1 keep their order
+void sort_pairs_by_pos(pairset_st& pairs);
+
+#endif
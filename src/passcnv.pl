@@ -21,7 +21,10 @@ my ( $chr, $beg, $end, $type, $length, $un,
      $srE, $sr,
      $q0, $q10 );
 
-open (FIN, $cnvfile ) or die "$cnvfile not found $!\n";
+if ( $cnvfile =~ /\.gz$/ ) {
+    open (FIN, "gzip -dc $cnvfile |") or die "$cnvfile not found $!\n";
+}
+else { open (FIN, $cnvfile ) or die "$cnvfile not found $!\n"; }
 while (<FIN>) {
     s/[\n\r+]$//;
     if (/^#/) {print "$_\n"; next;}
@@ -77,6 +80,7 @@ Available variables include
 
 Examples: 
           passcnv.pl cnvlist1.txt
+          passcnv.pl cnvlist1.txt.gz
 \n/);
 }
 
@@ -0,0 +1,104 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "matchreads.h"
+#include "prefetch.h"
+#include "trace.h"
+
+//! read the first records of the region through a private BAM handle,
+//! msc::fp_in belongs to the main thread
+static void warm_bam(const prefetch_st *pf)
+{
+  bamFile fp=bam_open(pf->bamFile.c_str(), "r");
+  if ( fp==NULL ) return;
+  bam1_t *b=bam_init1();
+  bam_iter_t iter=bam_iter_query(pf->bamidx, pf->ref, pf->beg, pf->end);
+  for(int n=0; n<PREFETCH_READS && bam_iter_read(fp, iter, b)>0; ++n) ;
+  bam_iter_destroy(iter);
+  bam_destroy1(b);
+  bam_close(fp);
+  return;
+}
+
+static void* prefetch_thread(void *arg)
+{
+  prefetch_st *pf=(prefetch_st*) arg;
+  trace_lane(TRACE_LANE_PREFETCH);
+  double t0=wall_time();
+  load_reference(msc::refFile, pf->target, pf->FASTA, msc::refPacked);
+  if ( msc::refInMemory ) pf->FASTA.materialise();
+  else pf->FASTA.prefault();
+  if ( pf->ref>=0 ) warm_bam(pf);
+  pf->seconds=wall_time()-t0;
+  if ( trace_on() ) trace_span("prefetch", "io", t0, t0+pf->seconds, pf->target);
+  pthread_exit((void*) 0);
+}
+
+void prefetch_start(prefetch_st& pf, const string& target, int ref, int beg, int end)
+{
+  prefetch_cancel(pf);
+  pf.target=target;
+  pf.ref=ref;
+  pf.beg=beg;
+  pf.end=end;
+  pf.bamFile=msc::bamFile;
+  pf.bamidx=msc::bamidx;
+  pf.seconds=0;
+  int rc=pthread_create(&pf.thread, NULL, prefetch_thread, &pf);
+  if ( rc ) {
+    cerr << "prefetch of " << target << " not started, return code " << rc << endl;
+    pf.target="";
+    return;
+  }
+  pf.running=true;
+  return;
+}
+
+bool prefetch_take(prefetch_st& pf, const string& target, refseq_st& FASTA,
+		   double& saved)
+{
+  if ( pf.target=="" || pf.target!=target ) {
+    prefetch_cancel(pf);
+    return false;
+  }
+  double t0=wall_time();
+  if ( pf.running ) pthread_join(pf.thread, NULL);
+  pf.running=false;
+  double wait=wall_time()-t0;
+
+  FASTA.swap(pf.FASTA);
+  pf.FASTA.clear();
+  pf.target="";
+
+  double s= pf.seconds>wait ? pf.seconds-wait : 0;
+  saved+=s;
+  cerr << "prefetch\t" << target << fixed << setprecision(3)
+       << "\tload " << pf.seconds << "s\twait " << wait
+       << "s\tsaved " << s << "s" << endl;
+  cerr.unsetf(ios::fixed);
+  cerr << setprecision(6);
+  return true;
+}
+
+void prefetch_cancel(prefetch_st& pf)
+{
+  if ( pf.running ) pthread_join(pf.thread, NULL);
+  pf.running=false;
+  pf.FASTA.clear();
+  pf.target="";
+  return;
+}
@@ -0,0 +1,62 @@
+#ifndef _PREFETCH_H
+#define _PREFETCH_H
+
+using namespace std;
+#include <pthread.h>
+#include <string>
+#include <bam.h>
+#include "readref.h"
+
+//! records read from the start of the next region to warm its BGZF blocks
+#define PREFETCH_READS 20000
+
+/*!
+  @abstract lookahead of the next region on a background thread
+
+  while the current region is matched and validated, the reference of the
+  next region is loaded (and materialised with -fm, or its pages faulted
+  in otherwise) and the first BAM blocks of the region are read through a
+  private handle, so the OS cache is warm when the main thread gets there.
+  the loaded contig is handed over with refseq_st::swap().
+
+  @field  target   contig being loaded, "" if none
+  @field  bamFile, bamidx  BAM to warm, taken when started as the main
+                   thread may switch BAMs in -bn mode
+  @field  FASTA    contig loaded by the thread
+  @field  seconds  time spent by the thread
+  @field  running  true between prefetch_start() and the join
+*/
+struct prefetch_st {
+  string target;
+  int ref;
+  int beg;
+  int end;
+  string bamFile;
+  bam_index_t *bamidx;
+  refseq_st FASTA;
+  double seconds;
+  bool running;
+  pthread_t thread;
+
+  prefetch_st(): target(""), ref(-1), beg(0), end(0), bamFile(""), bamidx(NULL),
+		 seconds(0), running(false) {};
+};
+
+//! start loading target, region ref:beg-end is used to warm the BAM
+void prefetch_start(prefetch_st& pf, const string& target, int ref, int beg, int end);
+
+/*!
+  @abstract  wait for the lookahead and take its contig if it is target
+
+  the time saved, the load time less the time waited, is reported and
+  added to saved.
+
+  @return    false if nothing was prefetched for target, FASTA is untouched
+*/
+bool prefetch_take(prefetch_st& pf, const string& target, refseq_st& FASTA,
+		   double& saved);
+
+//! wait for the lookahead and drop its contig
+void prefetch_cancel(prefetch_st& pf);
+
+#endif
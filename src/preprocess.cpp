@@ -21,7 +21,15 @@ using namespace std;
 #include "samfunctions.h"
 #include "functions.h"
 #include "matchreads.h"
+#include "readstore.h"
+#include "pairset.h"
 #include "pairguide.h"
+#include "regioncache.h"
+#include "bamstream.h"
+#include "evidence.h"
+#include "metrics.h"
+#include "memtrack.h"
+#include "progress.h"
 
 #include "preprocess.h"
 
@@ -45,9 +53,13 @@ bool is_read_count_for_depth(const bam1_t *b, int qual)
 // default filter for mpileup and map quality
 // require FR orientation
 bool is_read_count_for_pair(const bam1_t *b) 
+{
+  return is_read_count_for_pair(b, msc::minMAPQ);
+}
+bool is_read_count_for_pair(const bam1_t *b, int qual) 
 {
   if ( b->core.flag & BAM_DEF_MASK ) return false;;
-  if ( (int)b->core.qual < msc::minMAPQ ) return false;
+  if ( (int)b->core.qual < qual ) return false;
   if ( b->core.mtid != b->core.tid )  return false;
   if ( bool(b->core.flag & BAM_FREVERSE) == 
        bool(b->core.flag & BAM_FMREVERSE) ) return false;
@@ -55,78 +67,97 @@ bool is_read_count_for_pair(const bam1_t *b)
 }
 
 //! decide if a read should be included for possible softclip matching
-bool is_keep_read(const bam1_t *b, string& FASTA, RSAI_st& iread )
+//! bm returns the calibrated CIGAR of a kept read
+bool is_keep_read(const bam1_t *b, const refseq_st& FASTA, RSAI_st& iread, POSCIGAR_st& bm)
 {
-  if ( ! is_read_count_for_depth(b) ) return false;
-  if ( (int)b->core.qual < msc::minMAPQ ) return false;
-  if ( (int)b->core.n_cigar <=1 ) return false;
-  if ( (int)b->core.tid < 0 ) return false;
+  return is_keep_read_structure(b, FASTA, iread, bm, msc::minMAPQ, msc::minSNum) &&
+    is_keep_read_threshold(iread);
+}
+
+bool is_keep_read_threshold(const RSAI_st& iread)
+{
+  if ( iread.q1 < msc::minMAPQ ) { metric_add(MC_REJECT_MAPQ); return false; }
+  if ( iread.S0 < msc::minSNum ) { metric_add(MC_REJECT_SHORT_CLIP); return false; }
+  // minumum base quality, more than 1/4 of S part below minBASEQ
+  if ( msc::minBASEQ>1 && iread.bq25 < msc::minBASEQ ) { metric_add(MC_REJECT_BASEQ); return false; }
+  if ( iread.S < msc::minSNum ) { metric_add(MC_REJECT_SHORT_CLIP); return false; }
+  // too many no-call bases
+  if ( iread.nN >= msc::minSNum/2 ) { metric_add(MC_REJECT_NBASES); return false; }
+  metric_add(MC_READS_KEPT);
+  return true;
+}
+
+bool is_keep_read_structure(const bam1_t *b, const refseq_st& FASTA, 
+			    RSAI_st& iread, POSCIGAR_st& bm, int minq, int mins)
+{
+  metric_add(MC_READS_CHECKED);
+  if ( ! is_read_count_for_depth(b, minq) ) { metric_add(MC_REJECT_DEPTH); return false; }
+  if ( (int)b->core.n_cigar <=1 ) { metric_add(MC_REJECT_CIGAR); return false; }
+  if ( (int)b->core.tid < 0 ) { metric_add(MC_REJECT_CIGAR); return false; }
   if ( b->core.tid != msc::bam_ref ) cerr << "#TARGET read error" << endl;
   
-  POSCIGAR_st bm;
   resolve_cigar_pos(b, bm, 0);  
   
   // S part before the start of reference
-  if ( bm.cop[0] < 0 || bm.cop.back()+bm.nop.back()>=(int)FASTA.size()  ) return false;
-  if ( bm.cop[0]+bm.nop[0] < bm.cop[0] ) return false;
-  if ( bm.pos<=0 ) return false;
-  if ( bm.iclip<0 ) return false;
-  if ( (int)bm.nop[bm.iclip] < msc::minSNum ) return false;
-  
-  // minumum base quality
+  if ( bm.cop[0] < 0 || bm.cop.back()+bm.nop.back()>=(int)FASTA.size()  ) { 
+    metric_add(MC_REJECT_EDGE); 
+    return false; 
+  }
+  if ( bm.cop[0]+bm.nop[0] < bm.cop[0] ) { metric_add(MC_REJECT_EDGE); return false; }
+  if ( bm.pos<=0 ) { metric_add(MC_REJECT_EDGE); return false; }
+  if ( bm.iclip<0 ) { metric_add(MC_REJECT_SHORT_CLIP); return false; }
+  if ( (int)bm.nop[bm.iclip] < mins ) { metric_add(MC_REJECT_SHORT_CLIP); return false; }
+  int S0=bm.nop[bm.iclip];
+  
+  // base quality at 1/4 of the S part, the read fails -Q if it is lower 
+  int bq25=0xff;
   uint8_t *t = bam1_qual(b);
-  if ( msc::minBASEQ>1 && t[0] != 0xff) {
-    int bQ=0, bQCount=0;
-    for(int i=0;i<(int)bm.nop[bm.iclip];++i) {
-      bQ=t[ bm.qop[bm.iclip]+i ];
-      if ( bQ < msc::minBASEQ ) ++bQCount;
-    }
-    if ( bQCount*4 > (int)bm.nop[bm.iclip] ) return false;
+  if ( t[0] != 0xff ) {
+    vector<uint8_t> bq( t+bm.qop[bm.iclip], t+bm.qop[bm.iclip]+S0 );
+    nth_element(bq.begin(), bq.begin()+S0/4, bq.end());
+    bq25=bq[S0/4];
   }
   
   string SEQ=get_qseq(b);  
   
   // S part beyond reference
-  if ( bm.cop.back()+bm.nop.back() >= (int)FASTA.size() ) return false;
-  if ( bm.cop[0]<0 ) return false;
+  if ( bm.cop.back()+bm.nop.back() >= (int)FASTA.size() ) { metric_add(MC_REJECT_EDGE); return false; }
+  if ( bm.cop[0]<0 ) { metric_add(MC_REJECT_EDGE); return false; }
   
   //int nAdjust=calibrate_resolved_cigar_pos(FASTA, SEQ, bm);  
   //if ( msc::verbose && nAdjust>50 ) cerr << "nAdjust=" << nAdjust << endl;
   calibrate_resolved_cigar_pos(FASTA, SEQ, bm);  
   
   // short or no S part
-  if ( bm.pos==0 ) return false;
-  if ( bm.iclip<0 ) return false;
-  if ( (int)bm.nop[bm.iclip] < msc::minSNum ) return false;
+  if ( bm.pos==0 ) { metric_add(MC_REJECT_EDGE); return false; }
+  if ( bm.iclip<0 ) { metric_add(MC_REJECT_SHORT_CLIP); return false; }
+  if ( (int)bm.nop[bm.iclip] < mins ) { metric_add(MC_REJECT_SHORT_CLIP); return false; }
   
   // S part too long
-  if ( bm.nop[bm.iclip]*1.25 > bm.l_qseq ) return false;
+  if ( bm.nop[bm.iclip]*1.25 > bm.l_qseq ) { metric_add(MC_REJECT_LONG_CLIP); return false; }
   //if ( bm.nop[bm.iclip]*2 > bm.l_qseq ) return false;
   
+  // compare read and reference parts in place, on the packed reference
+  // 32 bases are compared at a time
   int ndiff_m=0;
   for (int k = 0; k < (int) bm.op.size(); ++k) {
     if ( bm.op[k]!=BAM_CMATCH && bm.op[k]!=BAM_CEQUAL ) continue; 
-    string CLIPPEDSEQ=SEQ.substr(bm.qop[k], bm.nop[k]);
-    string REFCLIP=FASTA.substr(bm.cop[k], bm.nop[k]);
-    for(int i=0; i<(int)REFCLIP.size(); ++i) if ( REFCLIP[i]!=CLIPPEDSEQ[i] ) ++ndiff_m;
+    size_t n=min( (size_t)bm.nop[k], SEQ.size()-bm.qop[k] );
+    ndiff_m+=FASTA.mismatches(bm.cop[k], SEQ.c_str()+bm.qop[k], n);
   }
   int ndiff_s=0, nN=0;
   if ( bm.iclip>=0 ) {
     int k = bm.iclip;
-    string CLIPPEDSEQ=SEQ.substr(bm.qop[k], bm.nop[k]);
-    string REFCLIP=FASTA.substr(bm.cop[k], bm.nop[k]);
-    for(int i=0; i<(int)REFCLIP.size(); ++i) {
-      if ( REFCLIP[i]!=CLIPPEDSEQ[i] ) ++ndiff_s;
-      if ( CLIPPEDSEQ[i]=='N' ) ++nN;
-	}
+    size_t n=min( (size_t)bm.nop[k], SEQ.size()-bm.qop[k] );
+    ndiff_s=FASTA.mismatches(bm.cop[k], SEQ.c_str()+bm.qop[k], n);
+    n=min( n, FASTA.size()-bm.cop[k] );
+    for(size_t i=0; i<n; ++i) if ( SEQ[bm.qop[k]+i]=='N' ) ++nN;
   }
   // too few different bases in S part
-  if ( ndiff_s <= 2 ) return false;    
-  if ( ndiff_s <= (int)bm.nop[bm.iclip]/4 ) return false;
+  if ( ndiff_s <= 2 ) { metric_add(MC_REJECT_CLIP_MATCHES); return false; }
+  if ( ndiff_s <= (int)bm.nop[bm.iclip]/4 ) { metric_add(MC_REJECT_CLIP_MATCHES); return false; }
   // too many different bases in M part
-  if ( ndiff_m >= (int)bm.l_qseq*8/100  ) return false;
-  // too many no-call bases
-  if ( nN >= msc::minSNum/2 ) return false;
+  if ( ndiff_m >= (int)bm.l_qseq*8/100  ) { metric_add(MC_REJECT_MISMATCHES); return false; }
   
   int nS=0,nIndel=0;
   for(int i=0;i<(int)bm.op.size();++i) {
@@ -134,7 +165,7 @@ bool is_keep_read(const bam1_t *b, string& FASTA, RSAI_st& iread )
     if (bm.op[i]==BAM_CINS || bm.op[i]==BAM_CDEL || bm.op[i]==BAM_CREF_SKIP || bm.op[i]==BAM_CPAD ) ++nIndel;
   }
   // CIGAR too complicated
-  if ( nS>3 || nIndel>3 ) return false;    
+  if ( nS>3 || nIndel>3 ) { metric_add(MC_REJECT_COMPLEX_CIGAR); return false; }
   
   //  int Snum_adjust=bm.nop[bm.iclip];
   int Sotherend=0;
@@ -153,9 +184,17 @@ bool is_keep_read(const bam1_t *b, string& FASTA, RSAI_st& iread )
   iread.send=bm.cop[bm.iclip]+bm.nop[bm.iclip]-1;
   iread.mms=ndiff_s;
   iread.mmm=ndiff_m;
+  iread.S0=S0;
+  iread.nN=nN;
+  iread.bq25=bq25;
   
   return true;
 }
+bool is_keep_read(const bam1_t *b, const refseq_st& FASTA, RSAI_st& iread )
+{
+  POSCIGAR_st bm;
+  return is_keep_read(b, FASTA, iread, bm);
+}
 
 //! find displacement that the break points can slide by the same step
 //! return: dx_F2 displacement in positive direction
@@ -163,7 +202,7 @@ bool is_keep_read(const bam1_t *b, string& FASTA, RSAI_st& iread )
 //! both dx_F2 and dx_R1 are non negative numbers
 //! total displace is dx_F2+dx_R1
 //! left most start is F2-dx_R1
-void find_displacement(string& FASTA, int F2, int R1, 
+void find_displacement(const refseq_st& FASTA, int F2, int R1, 
 		       int& dx_F2, int& dx_R1)
 {
   dx_F2=0;
@@ -171,20 +210,13 @@ void find_displacement(string& FASTA, int F2, int R1,
   if ( F2>=(int)FASTA.size() || R1>=(int)FASTA.size() ) return;
   if ( F2<=0 || R1<=0 ) return;
   
-  bool after=true;
-  while( after ) {
-    if ( F2+dx_F2+1>=(int)FASTA.size() || 
-	 R1+dx_F2>=(int)FASTA.size() ) break;
-    if ( FASTA[F2+dx_F2+1] != FASTA[R1+dx_F2] ) after=false;
-    dx_F2+=(int)after;
-  }
+  // [F2+1+k]==[R1+k] while both are within the reference
+  int n=min( (int)FASTA.size()-F2-1, (int)FASTA.size()-R1 );
+  if ( n>0 ) dx_F2=FASTA.match_forward(F2+1, R1, n);
   
-  bool prev=true;
-  while( prev ) {
-    if ( F2-dx_R1<=0 || R1-dx_R1-1<=0 ) break;
-    if ( FASTA[F2-dx_R1] != FASTA[R1-dx_R1-1] ) prev=false;
-    dx_R1+=(int)prev;
-  }
+  // [F2-k]==[R1-1-k] while both are after the first base
+  n=min( F2, R1-1 );
+  if ( n>0 ) dx_R1=FASTA.match_backward(F2, R1-1, n);
   
 }
 
@@ -201,19 +233,19 @@ void check_map_quality(int ref, int beg, int end, double& q0, double& q1)
   if ( abs(beg-end)>1E6 ) { q0=q1=-0.01001; return; }
   
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   
   double d0=0, d1=0;
   double count=0;
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     count+=1;
     if ( b->core.qual==0 ) d0+=1;
     if ( b->core.qual<=10 ) d1+=1;
     if ( b->core.tid!=ref || b->core.pos>end ) break;
   }
   if ( b ) bam_destroy1(b);
-  if ( iter ) bam_iter_destroy(iter);
+  if ( iter ) region_destroy(iter);
   
   q0=q1=-0.01001;
   if ( count>1 ) {
@@ -234,13 +266,13 @@ int mean_readdepth(int ref, int beg, int end)
   }
   
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   
   double dx=end-beg+1;
   double d1=0;
   double count=0;
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     if ( ! is_read_count_for_depth(b) ) continue;
     count++;
     
@@ -264,7 +296,7 @@ int mean_readdepth(int ref, int beg, int end)
   //cerr << "reads:\t" << ref << "\t" << beg << "-" << end << "\t" << count << endl;
   
   if ( b ) bam_destroy1(b);
-  if ( iter ) bam_iter_destroy(iter);
+  if ( iter ) region_destroy(iter);
 
   return(d1);
 }
@@ -279,12 +311,12 @@ int median_readdepth(int ref, int beg, int end)
   }
   
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   
   int dx=end-beg+1;
   vector<int> rd(dx,0);
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(ref, beg, end);
+  while( region_read(iter, b)>0 ) {
     if ( ! is_read_count_for_depth(b) ) continue;
     POSCIGAR_st b_m;
     resolve_cigar_pos(b, b_m, 0);
@@ -326,12 +358,12 @@ void check_cnv_readdepth_from_bam(int ref, int beg, int end, int dx,
   }
   
   bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
+  region_iter_t iter=0;
   
   double rd1=0, rd2=0, rdin=0;
   
-  iter = bam_iter_query(msc::bamidx, ref, max(0, beg-dx), end+dx);
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  iter = region_query(ref, max(0, beg-dx), end+dx);
+  while( region_read(iter, b)>0 ) {
     if ( ! is_read_count_for_depth(b) ) continue;
     
     POSCIGAR_st b_m;
@@ -363,7 +395,7 @@ void check_cnv_readdepth_from_bam(int ref, int beg, int end, int dx,
     
   }
   if ( b ) bam_destroy1(b);
-  if ( iter ) bam_iter_destroy(iter);
+  if ( iter ) region_destroy(iter);
   
   rd1/=dx;
   rd2/=dx;
@@ -578,66 +610,54 @@ bool string_overlap_front(const string& readMS, const string& readSM,
 }
 
 
-/*! read bF2 and bR1 overlap starting from p1(0 based) of bF2, find the break points
-  | the break points if exist, must be between p1-1 to end of bF2 on read bF2
+/*! read rF2[iF2] and rR1[iR1] overlap starting from p1(0 based) of F2, find the break points
+  | the break points if exist, must be between p1-1 to end of F2 on read F2
   | the best candidates are those that the points on both are M
-  | the second choice would be those with S on bF2 and M on bR1
-  | the next choice would be those with M on bF2 and S on bR1
+  | the second choice would be those with S on F2 and M on R1
+  | the next choice would be those with M on F2 and S on R1
   | if the above are not availble, just use p1-1
-  | given a list of possible points, test the first and the last
-  | ideally the CIGAR score should be calibrated first
+  | mismatches against the projected reference and M bases are taken from 
+  | the per base flags saved in the read store, no memory is allocated
 */
-void get_break_points(const string& FASTA, bam1_t *bF2, bam1_t *bR1, int p1, vector<int>& p_err, 
+void get_break_points(const refseq_st& FASTA, 
+		      const readstore_st& rF2, size_t iF2, 
+		      const readstore_st& rR1, size_t iR1, int p1, 
 		      int& F2, int& R1, int& e_dis)
 {
   F2=R1=-1;
   e_dis=1000000;
-  if ( bF2->core.flag & BAM_FUNMAP || bF2->core.n_cigar==0 || bF2->core.pos<0 ) return;
-  if ( bF2->core.flag & BAM_FUNMAP || bR1->core.n_cigar==0 || bR1->core.pos<0 ) return;
+  if ( rF2.n_cigar[iF2]==0 || rF2.pos[iF2]<0 ) return;
+  if ( rR1.n_cigar[iR1]==0 || rR1.pos[iR1]<0 ) return;
   
-  // 0 based positions on FASTA
-  POSCIGAR_st bF2_m, bR1_m;
-  resolve_cigar_pos(bF2, bF2_m, 0);
-  resolve_cigar_pos(bR1, bR1_m, 0);
+  int lF=rF2.l_qseq[iF2];
+  int lR=rR1.l_qseq[iR1];
   
   // basic filter; return false if too close to REF ends
   // totally overlap
   if ( p1==0 ) p1=1;
-  int bpF2=get_pos_for_base(bF2_m, p1-1);
-  int bpR1=get_pos_for_base(bR1_m, 0);
+  int bpF2=rF2.get_pos_for_base(iF2, p1-1);
+  int bpR1=rR1.get_pos_for_base(iR1, 0);
   
-  if ( bpF2<1 || bpF2+bF2->core.l_qseq>(int)FASTA.size() ) return;
-  if ( bpR1<1 || bpR1+bR1->core.l_qseq>(int)FASTA.size() ) return;
+  if ( bpF2<1 || bpF2+lF>(int)FASTA.size() ) return;
+  if ( bpR1<1 || bpR1+lR>(int)FASTA.size() ) return;
   
-  // find break points using projected referene to approximate ED
-  string F_qseq=get_qseq(bF2);
-  string F_qseq_ref=ref_projected_onto_qseq(bF2, FASTA);
-  string R_qseq=get_qseq(bR1);
-  string R_qseq_ref=ref_projected_onto_qseq(bR1, FASTA);
+  const uint8_t *fF=rF2.bflags(iF2);
+  const uint8_t *fR=rR1.bflags(iR1);
   
-  string concatinated_read=F_qseq.substr(0,p1)+R_qseq;
-  string projected_ref=F_qseq_ref.substr(0,p1)+R_qseq_ref;
-  
-  vector<int> ED0(bF2->core.l_qseq, 1000000); 
-  int br_beg=p1-1;
+  // mismatches of F2[0,p1) + R1 against projected reference, then the
+  // break point slides to the right, taking one more base from F2 each step
   int ndiff_F2R1=0;
-  for(size_t i=0; i<concatinated_read.size(); ++i) 
-    ndiff_F2R1 += ( projected_ref[i] != concatinated_read[i] ) ;
-  ED0[br_beg]=ndiff_F2R1;
-  int ndiff_imin=br_beg;
+  for(int i=0; i<p1; ++i) ndiff_F2R1 += readstore_basei(fF, i) & READSTORE_BASE_MM;
+  for(int i=0; i<lR; ++i) ndiff_F2R1 += readstore_basei(fR, i) & READSTORE_BASE_MM;
+  
+  int ndiff_first=ndiff_F2R1;
+  int ndiff_imin=p1-1;
   int ndiff_min=ndiff_F2R1;
-  int br_stop=min( (int)bF2->core.l_qseq, (int)concatinated_read.size() )-1;
+  int br_beg;
+  int br_stop=min(lF, p1+lR)-1;
   for( br_beg=p1; br_beg<br_stop; ++br_beg ) {
-    char br_base_qseq = F_qseq[br_beg];
-    char br_base_ref  = F_qseq_ref[br_beg];
-    
-    ndiff_F2R1 += ( br_base_qseq != br_base_ref )
-      - ( projected_ref[br_beg] != concatinated_read[br_beg] ) ;
-    
-    concatinated_read[br_beg] = br_base_qseq;
-    projected_ref[br_beg] = br_base_ref;
-    
-    ED0[br_beg]=ndiff_F2R1;
+    ndiff_F2R1 += ( readstore_basei(fF, br_beg) & READSTORE_BASE_MM ) 
+      - ( readstore_basei(fR, br_beg-p1) & READSTORE_BASE_MM );
     if ( ndiff_F2R1 < ndiff_min ) {
       ndiff_min = ndiff_F2R1 ;
       ndiff_imin = br_beg;
@@ -645,150 +665,163 @@ void get_break_points(const string& FASTA, bam1_t *bF2, bam1_t *bR1, int p1, vec
   }
   
   // get possible break points based on CIGAR
-  vector<int> F2_e_cigar(0), R1_e_cigar(0); 
-  expand_cigar(bF2, F2_e_cigar);
-  expand_cigar(bR1, R1_e_cigar);
-  // possible good break points
-  vector<int> F2_br(0);
-  // in ideal condition, break points should fall on M parts
-  string bptype="MM";
-  for(int q=p1-1, r=0; q<bF2->core.l_qseq && r<bR1->core.l_qseq; ++q,++r) {
-    if ( ( F2_e_cigar[q]==BAM_CMATCH || F2_e_cigar[q]==BAM_CEQUAL ) &&
-	 ( R1_e_cigar[r]==BAM_CMATCH || R1_e_cigar[r]==BAM_CEQUAL ) ) {
-      F2_br.push_back(q);
-    }
-  }
-  // if not any, find break points based on R1's  M parts
-  if ( F2_br.size()==0 ) {
-    bptype="SM";
-    for(int q=p1-1, r=0; q<bF2->core.l_qseq && r<bR1->core.l_qseq; ++q,++r) {
-      if ( ( R1_e_cigar[r]==BAM_CMATCH || R1_e_cigar[r]==BAM_CEQUAL ) ) {
-	F2_br.push_back(q);
-      }
+  // in ideal condition, break points should fall on M parts (MM),
+  // if not any, based on R1's M parts (SM), then F2's M parts (MS),
+  // if still not any, just the 1st and the middle (SS)
+  static const int bptype_need[3]={3, 2, 1};  // bit 0: M on F2, bit 1: M on R1
+  int need=0;
+  bool found=false;
+  for(int t=0; t<3 && !found; ++t) {
+    need=bptype_need[t];
+    for(int q=p1-1, r=0; q<lF && r<lR; ++q,++r) {
+      int m = bool( readstore_basei(fF, q) & READSTORE_BASE_M ) |
+	( bool( readstore_basei(fR, r) & READSTORE_BASE_M ) << 1 );
+      if ( (m & need) == need ) { found=true; break; }
     }
   }
-  // if still not any, find break points based on F2's M parts
-  if ( F2_br.size()==0 ) {
-    bptype="MS";
-    for(int q=p1-1, r=0; q<bF2->core.l_qseq && r<bR1->core.l_qseq; ++q,++r) {
-      if ( ( F2_e_cigar[q]==BAM_CMATCH || F2_e_cigar[q]==BAM_CEQUAL ) ) {
-	F2_br.push_back(q);
+  int ss_mid=(p1+min(p1+lR, lF))/2;
+  
+  // from minimum ED positions, get the first candidate
+  ndiff_F2R1=ndiff_first;
+  for( br_beg=p1-1; br_beg<max(br_stop, p1); ++br_beg ) {
+    if ( br_beg>=p1 ) 
+      ndiff_F2R1 += ( readstore_basei(fF, br_beg) & READSTORE_BASE_MM ) 
+	- ( readstore_basei(fR, br_beg-p1) & READSTORE_BASE_MM );
+    if ( ndiff_F2R1 > ndiff_min ) continue;
+    bool is_candidate=false;
+    if ( found ) {
+      int r=br_beg-p1+1;
+      if ( r<lR ) {
+	int m = bool( readstore_basei(fF, br_beg) & READSTORE_BASE_M ) |
+	  ( bool( readstore_basei(fR, r) & READSTORE_BASE_M ) << 1 );
+	is_candidate= ( (m & need) == need );
       }
     }
-  }
-  // if still not any, just the 1st and the middle
-  if ( F2_br.size()==0 ) {
-    bptype="SS";
-    F2_br.push_back(p1-1);
-    F2_br.push_back( (p1+min(p1+bR1->core.l_qseq,bF2->core.l_qseq))/2 );
-  }
-  // from minimum ED positions, get the first MM
-  for( br_beg=p1-1; br_beg<bF2->core.l_qseq; ++br_beg ) {
-    if ( ED0[br_beg] > ndiff_min ) continue;
-    std::vector<int>::iterator it;
-    it=find (F2_br.begin(), F2_br.end(), br_beg);
-    if ( it != F2_br.end() ) { 
+    else is_candidate= ( br_beg==p1-1 || br_beg==ss_mid );
+    if ( is_candidate ) { 
       ndiff_imin=br_beg;
       break;
     }
   }
   
   // whether or not the above code is useful, ndiff_imin is already calculated
-  F2=get_pos_for_base(bF2_m, ndiff_imin);
-  R1=get_pos_for_base(bR1_m, ndiff_imin-p1+1);
-  if ( F2 < 0 ) cerr << get_cigar(bF2) << "\t" << ndiff_imin << endl;
-  if ( R1 < 0 ) cerr << get_cigar(bR1) << "\t" << ndiff_imin << "\t" << p1+1 << endl;
+  F2=rF2.get_pos_for_base(iF2, ndiff_imin);
+  R1=rR1.get_pos_for_base(iR1, ndiff_imin-p1+1);
+  if ( F2 < 0 ) cerr << "F2 read " << iF2 << "\t" << ndiff_imin << endl;
+  if ( R1 < 0 ) cerr << "R1 read " << iR1 << "\t" << ndiff_imin << "\t" << p1+1 << endl;
   e_dis=ndiff_min;
   if ( msc::verbose>1 ) {
     cerr << "edit_distance  " 
-	 << bF2->core.pos << " " << get_cigar(bF2) << "\t"
-	 << bR1->core.pos << " " << get_cigar(bR1) << "\t"
+	 << rF2.pos[iF2] << "\t"
+	 << rR1.pos[iR1] << "\t"
 	 << e_dis << "\t" << p1 << "\t" << ndiff_imin << "\t" 
 	 << F2 << "\t" << R1
 	 << endl;
   }
-  /*
-  // find break points using edit_distance
-  int F_beg=get_pos_for_base(bF2_m, 0);
-  int R_end=get_pos_for_base(bR1_m, bR1->core.l_qseq-1);
-  string concatinated_ref=
-    FASTA.substr(F_beg, bpF2-F_beg+1)+
-    FASTA.substr(bpR1, R_end-bpR1+1);
-  
-  vector<int> ED( F2_br.size(), 1000000 );
-  for(int i=0; i<(int)F2_br.size(); ++i) {
-    // it should be enough just to check the first and last location
-    if ( i!=0 && i!=(int)F2_br.size()-1 ) continue;
-    int q=F2_br[i];
-    int r=q-p1+1;
-    for(int k=0; k<(int)p_err.size(); ++k) {
-      if ( p_err[k]<= q ) concatinated_read[p_err[k]]=F_qseq[p_err[k]];
+  
+  return;
+}
+
+//! account the buffers of ingest and halve the soft clipped reads if they
+//! do not fit in -M, false if the budget is still exceeded
+static bool fit_memory_budget(const refseq_st& FASTA, const pairset_st& pairs,
+			      readstore_st& r_MS, readstore_st& r_SM, int& step)
+{
+  mem_set(MEM_REFERENCE, FASTA.totalRAM());
+  mem_set(MEM_DEPTH, totalRAM(msc::rd));
+  mem_set(MEM_PAIRS, pairs.totalRAM());
+  mem_set(MEM_READS, r_MS.totalRAM()+r_SM.totalRAM());
+  if ( !mem_over_budget() ) return true;
+  if ( r_MS.size()+r_SM.size() < MEM_MIN_READS ) return false;
+  
+  size_t n=r_MS.thin()+r_SM.thin();
+  if ( n==0 ) return false;
+  metric_add(MC_READS_DOWNSAMPLED, n);
+  step*=2;
+  mem_region_step(step);
+  mem_set(MEM_READS, r_MS.totalRAM()+r_SM.totalRAM());
+  cerr << "memory budget reached, keeping 1 of " << step 
+       << " soft clipped reads" << endl;
+  return !mem_over_budget();
+}
+
+void add_read_depth(const bam1_t *b, vector<int32_t>& rd)
+{
+  POSCIGAR_st b_m;
+  resolve_cigar_pos(b, b_m, 0);
+  for(size_t i=0; i<b_m.nop.size(); ++i) {
+    int op=b_m.op[i];
+    if ( op == BAM_CMATCH || 
+	 op == BAM_CEQUAL || 
+	 op == BAM_CDIFF ) {
+      int r_beg=b_m.cop[i];
+      int r_end=b_m.cop[i]+b_m.nop[i]-1;
+      if ( r_beg>=0 && r_end<(int)rd.size() ) 
+	for(int k=r_beg; k<r_end; ++k) rd[k]+=1;
     }
-    bpF2=get_pos_for_base(bF2_m, q);
-    bpR1=get_pos_for_base(bR1_m, r);
-    concatinated_ref=
-      FASTA.substr(F_beg, bpF2-F_beg+1)+
-      FASTA.substr(bpR1, R_end-bpR1+1);
-    ED[i]=edit_distance(concatinated_read, concatinated_ref);
   }
-  int ir=0;
-  for(int i=0; i<(int)ED.size(); ++i) if ( ED[i]<ED[ir] ) ir=i;
-  
-  if ( msc::verbose >1 ) 
-    cerr << "edit_distance\t" 
-	 << ndiff_min << "\t" << ndiff_imin << "\t" 
-	 << e_dis << "\t" << F2_br[ir] << endl;
-  
-  int p_min= ED[ir] < ndiff_min ? F2_br[ir] : ndiff_imin ;
-  F2=get_pos_for_base(bF2_m, p_min);
-  R1=get_pos_for_base(bR1_m, p_min-p1+1);
-  e_dis=min( ED[ir], ndiff_min );
-  */
-  /*
-  if ( e_dis>p_err.size() ) {
-    cerr << "matcherr\t" << bF2->core.pos << "\t" << get_cigar(bF2) << "\t"
-	 << bR1->core.pos << "\t" << get_cigar(bR1) << "\t"
-	 << e_dis << "\t" << p1 << "\t" << p_min << endl;
-  }
-  */
-
   return;
 }
 
 void prepare_pairend_matchclip_data(int ref, int beg, int end, 
 				    int min_pair_length,
-				    string& FASTA,
-				    vector<intpair_st>& pairs,
-				    vector<bam1_t>& b_MS, vector<bam1_t>& b_SM) 
+				    const refseq_st& FASTA,
+				    pairset_st& pairs,
+				    readstore_st& r_MS, readstore_st& r_SM) 
 {
-  pairs.clear();
-  msc::bdata.clear();
-  msc::bdata.reserve(300000000);
-  b_MS.clear();
-  b_SM.clear();
+  pairs.reset();
+  r_MS.reset();
+  r_SM.reset();
   
+  // depth of the previous region must not leak into this one
   msc::rd.reserve(FASTA.size()+100);
-  msc::rd.resize(FASTA.size(),0);
+  msc::rd.assign(FASTA.size(),0);
 
-  vector<size_t> p_MS(0),p_SM(0);
-  
-  bam1_t *b=NULL; b = bam_init1();
-  bam_iter_t iter=0;
-  
-  bam1_t ibam;
   intpair_st ipair;
   
   double isize=0.0, isize2=0.0, isize_c=0, isize_sd=0.0;
+  int bam_beg=0, bam_end=0;
   
-  iter = bam_iter_query(msc::bamidx, ref, beg, end);
+  // with -ev the region is scanned once at the loosest filter and saved,
+  // later runs map it and apply their own filters in memory
+  evidence_st ev;
+  string evfile= msc::evidenceDir!="" ? evidence_file(ref, beg, end) : "";
+  bool scan=true;
+  if ( evfile!="" && evidence_load(evfile, ref, beg, end, min_pair_length, 
+				   ev, msc::rd, pairs, r_MS, r_SM) ) {
+    cerr << "evidence read from " << evfile << endl;
+    scan=false;
+    bam_beg=ev.bam_beg;
+    bam_end=ev.bam_end;
+    isize=ev.isize;
+    isize2=ev.isize2;
+    isize_c=ev.isize_c;
+  }
+  bool loose= scan && evfile!="";
+  int minq= loose ? 0 : msc::minMAPQ;
+  int mins= loose ? min(EVIDENCE_MIN_SNUM, msc::minSNum) : msc::minSNum;
+  int minpair= min_pair_length;
+  if ( loose ) 
+    minpair=max(1, min(min_pair_length, msc::bam_pe_insert+EVIDENCE_PAIR_SD*msc::bam_pe_insert_sd));
+  ev.min_snum=mins;
+  ev.min_pair=minpair;
+  
+  bam1_t *b=NULL; b = bam_init1();
+  region_iter_t iter=0;
+  
+  // over the -M budget only every step-th read of each store is kept
+  int step=1;
+  size_t n_MS=0, n_SM=0, nkept=0;
+  
+  if ( scan ) iter = region_query(ref, beg, end);
   size_t count=0;
-  int bam_beg=0, bam_end=0;
-  while( bam_iter_read(msc::fp_in->x.bam, iter, b)>0 ) {
+  while( scan && region_read(iter, b)>0 ) {
     if ( b->core.tid != msc::bam_ref ) break;
     if ( b->core.pos > end ) break;
     if ( count==0 ) bam_beg=b->core.pos;
     bam_end=b->core.pos;
     count++;
+    if ( count%4096==0 ) progress_reads(count, b->core.pos);
     if ( count%1000000==0 ) {
       cerr << "#processed " << commify(count) << " reads at pos " 
 	   << string(msc::fp_in->header->target_name[ref]) 
@@ -796,28 +829,20 @@ void prepare_pairend_matchclip_data(int ref, int beg, int end,
 	   << endl;
     }
     
-    if (  is_read_count_for_depth(b, 0) ) {
-      // get read depth
-      POSCIGAR_st b_m;
-      resolve_cigar_pos(b, b_m, 0);
-      for(size_t i=0; i<b_m.nop.size(); ++i) {
-	int op=b_m.op[i];
-	if ( op == BAM_CMATCH || 
-	     op == BAM_CEQUAL || 
-	     op == BAM_CDIFF ) {
-	  int r_beg=b_m.cop[i];
-	  int r_end=b_m.cop[i]+b_m.nop[i]-1;
-	  if ( r_beg>=0 && r_end<(int)FASTA.size() ) 
-	    for(int k=r_beg; k<r_end; ++k) msc::rd[k]+=1;
-	}
-      }
-    }
+    if (  is_read_count_for_depth(b, 0) ) add_read_depth(b, msc::rd);
     
     if ( b->core.mpos >= beg && b->core.mpos <= end &&
-	 abs(b->core.isize) >= min_pair_length && 
-	 is_read_count_for_pair(b) ) {
+	 abs(b->core.isize) >= minpair && 
+	 is_read_count_for_pair(b, minq) ) {
       check_inner_pair_ends(b, ipair.F2, ipair.F2_acurate, ipair.R1, ipair.R1_acurate);
-      if ( ipair.F2>0 && ipair.R1>0 ) pairs.push_back(ipair);
+      if ( ipair.F2>0 && ipair.R1>0 ) {
+	if ( loose ) {
+	  ev.pairs.push_back(ipair.F2, ipair.F2_acurate, ipair.R1, ipair.R1_acurate);
+	  ev.pair_isize.push_back( abs(b->core.isize) );
+	  ev.pair_mapq.push_back( b->core.qual );
+	}
+	else pairs.push_back(ipair.F2, ipair.F2_acurate, ipair.R1, ipair.R1_acurate);
+      }
     }
     
     // calculate insert and sd again
@@ -831,34 +856,39 @@ void prepare_pairend_matchclip_data(int ref, int beg, int end,
     }
     
     RSAI_st iread;
-    if (  is_keep_read(b, FASTA, iread) ) {
-      // save read in buffer
-      size_t p_pos=msc::bdata.size();
-      _save_read_in_vector(b, ibam, msc::bdata);
-      if ( iread.sbeg > iread.pos ) {
-	// type M...S    
-	b_MS.push_back(ibam);  // save bam_t
-	p_MS.push_back(p_pos); // save relative pointer to vector
-      }
-      else {
-	// type S...M
-	b_SM.push_back(ibam);  // save bam_t
-	p_SM.push_back(p_pos); // save relative pointer to vector
+    POSCIGAR_st bm;
+    if ( !is_keep_read_structure(b, FASTA, iread, bm, minq, mins) ) continue;
+    if ( loose ) ev.add_read(b, bm, iread, FASTA);
+    else if ( is_keep_read_threshold(iread) ) {
+      // save read with calibrated CIGAR
+      if ( iread.sbeg > iread.pos ) {   // type M...S
+	if ( n_MS++ % step == 0 ) r_MS.add(b, bm, FASTA);
       }
+      else if ( n_SM++ % step == 0 ) r_SM.add(b, bm, FASTA);  // type S...M
+      if ( ++nkept % 4096 == 0 ) fit_memory_budget(FASTA, pairs, r_MS, r_SM, step);
     }
   }
   bam_destroy1(b);
-  bam_iter_destroy(iter);
-  
-  // the reason to take the trouble is because address of vector may change due to
-  // change of size
-  for(size_t i=0; i<b_MS.size(); ++i) b_MS[i].data = &msc::bdata[ (size_t)b_MS[i].data ];
-  for(size_t i=0; i<b_SM.size(); ++i) b_SM[i].data = &msc::bdata[ (size_t)b_SM[i].data ];
+  if ( iter ) region_destroy(iter);
+  if ( scan ) progress_reads(count, bam_end);
+  
+  if ( loose ) {
+    ev.bam_beg=bam_beg;
+    ev.bam_end=bam_end;
+    ev.isize=isize;
+    ev.isize2=isize2;
+    ev.isize_c=isize_c;
+    if ( evidence_save(evfile, ref, beg, end, ev, msc::rd) ) 
+      cerr << "evidence saved to " << evfile << endl;
+    else cerr << "failed to write " << evfile << endl;
+    evidence_apply(ev, min_pair_length, pairs, r_MS, r_SM);
+    ev.clear();
+  }
   
   vector<bool> tokeep( pairs.size(), true );
   for(size_t i=0; i<pairs.size(); ++i) {
-    if ( pairs[i].F2<bam_beg || pairs[i].F2>bam_end ||
-	 pairs[i].R1<bam_beg || pairs[i].R1>bam_end ) tokeep[i]=false;
+    if ( pairs.F2[i]<bam_beg || pairs.F2[i]>bam_end ||
+	 pairs.R1[i]<bam_beg || pairs.R1[i]>bam_end ) tokeep[i]=false;
   }
   
   if ( isize_c>2 ) {
@@ -868,26 +898,34 @@ void prepare_pairend_matchclip_data(int ref, int beg, int end,
       cerr << "isize sd is too small " << isize_sd << " changed to 50" << endl;  
       isize_sd=50;
     }
-    if ( !msc::bam_pe_set_by_user ) {    
+    // the genome wide model is kept, a small contig keeps the shared model
+    if ( !msc::bam_pe_set_by_user && !msc::bam_pe_genome &&
+	 ( !msc::bam_pe_shared || isize_c>=PE_MIN_SAMPLES ) ) {    
       msc::bam_is_paired=true;
       msc::bam_pe_insert=(int)isize;
       msc::bam_pe_insert_sd=(int)isize_sd;
     }
   }
   
-  size_t k=0;
-  for(size_t i=0; i<pairs.size(); ++i) if ( tokeep[i] ) { pairs[k]=pairs[i]; ++k;}
-  if ( k<pairs.size() ) pairs.erase( pairs.begin()+k, pairs.end() );
+  pairs.filter(tokeep);
+  // halve until the reads fit or can not be halved any more
+  for(int last=0; last!=step; ) {
+    last=step;
+    if ( fit_memory_budget(FASTA, pairs, r_MS, r_SM, step) ) break;
+  }
+  if ( mem_over_budget() ) 
+    cerr << "memory budget exceeded by " << commify(mem_total()-msc::memBudget) 
+	 << " bytes" << endl;
   
   cerr << "data range " << string(msc::fp_in->header->target_name[ref]) 
        << ":" << commify(bam_beg) << "-" << commify(bam_end) << "\n"
-       << "MS:" << b_MS.size() << "  SM:" << b_SM.size() << "  CIGAR_SEQ:" << msc::bdata.size() 
+       << "MS:" << r_MS.size() << "  SM:" << r_SM.size() << "  CIGAR_SEQ:" << r_MS.data_size()+r_SM.data_size() 
        << "  AbnormalPairs:" << pairs.size() << "\n"
        << "Pair insert:" << (int)isize << " += " << (int)isize_sd << "\n"
        << "memory used by reads\t" 
-       << commify(totalRAM(b_MS)+totalRAM(b_SM)+totalRAM(msc::bdata)) << "\n"
+       << commify(r_MS.totalRAM()+r_SM.totalRAM()) << "\n"
        << "memory used by pairs\t" 
-       << commify( totalRAM(pairs) ) << "\n"
+       << commify( pairs.totalRAM() ) << "\n"
        << "memory used by read depth\t" 
        << commify( totalRAM(msc::rd) ) 
        << endl;  
@@ -927,13 +965,13 @@ void stat_region(pairinfo_st& ibp)
   return;
 }
 
-void stat_region(pairinfo_st& ibp, string& FASTA, int dx) 
+void stat_region(pairinfo_st& ibp, const refseq_st& FASTA, int dx) 
 {
   
   if ( ibp.tid == msc::bam_ref &&
        FASTA.size() == msc::fp_in->header->target_len[ibp.tid] ) {
     int dx_F2=0, dx_R1=0;
-    find_displacement(FASTA, ibp.F2, ibp.R1, dx_F2, dx_R1);
+    cached_find_displacement(FASTA, ibp.F2, ibp.R1, dx_F2, dx_R1);
     ibp.un=dx_F2+dx_R1;
   }
   
@@ -943,17 +981,17 @@ void stat_region(pairinfo_st& ibp, string& FASTA, int dx)
     if ( dx<msc::bam_l_qseq ) dx=msc::bam_l_qseq;
   }
   
-  check_cnv_readdepth(ibp.tid, ibp.F2, ibp.R1, dx, 
+  cached_check_cnv_readdepth(ibp.tid, ibp.F2, ibp.R1, dx, 
 		      ibp.F2_rd, ibp.R1_rd, ibp.rd);
   
-  check_cnv_readdepth_100(ibp.tid, ibp.F2, ibp.R1, 
+  cached_check_cnv_readdepth_100(ibp.tid, ibp.F2, ibp.R1, 
 			  ibp.F2_rd_100, ibp.rd_F2_100, 
 			  ibp.rd_R1_100, ibp.R1_rd_100);
   
   if ( msc::bam_is_paired && 
        ( ibp.R1-ibp.F2>msc::bam_pe_insert_sd*3 || 
 	 ibp.R1-ibp.F2<-msc::bam_l_qseq ) ) {
-    check_normal_and_abnormalpairs_cross_region(ibp.tid, ibp.F2, ibp.R1,
+    cached_check_normal_and_abnormalpairs_cross_region(ibp.tid, ibp.F2, ibp.R1,
 						ibp.F2_rp, ibp.R1_rp, 
 						ibp.FRrp);      
   }
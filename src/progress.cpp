@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "metrics.h"
+#include "progress.h"
+
+static string p_file="";
+static double p_t0=0;
+static double p_last=0;
+static int p_nregion=0;
+static double p_total=0;      // bases of all regions
+static double p_done=0;       // bases of finished regions
+static size_t p_reads=0;      // reads of finished regions
+
+static int p_region=-1;
+static string p_name="";
+static int p_beg=0;
+static double p_bases=0;
+static int p_stage=-1;
+static int p_pos=-1;          // last position of the current stage
+static int p_scanned=-1;      // last position read from the BAM
+static size_t p_nread=0;
+static size_t p_validated=0;
+static size_t p_candidates=0;
+
+static void progress_write(bool force, const char *state="running")
+{
+  if ( p_file=="" ) return;
+  double now=wall_time();
+  if ( !force && now-p_last<PROGRESS_INTERVAL ) return;
+  p_last=now;
+  
+  double elapsed=now-p_t0;
+  double done=p_done;
+  if ( p_scanned>=p_beg ) done+=min(p_bases, (double)(p_scanned-p_beg));
+  double eta= done>0 ? (p_total-done)*elapsed/done : -1;
+  size_t nread=p_reads+p_nread;
+  
+  string tmp=p_file+".tmp";
+  ofstream FOUT(tmp.c_str());
+  if ( !FOUT ) return;
+  FOUT.setf(ios::fixed);
+  FOUT.precision(1);
+  FOUT << "{\n"
+       << "  \"state\": \"" << state << "\",\n"
+       << "  \"pid\": " << getpid() << ",\n"
+       << "  \"updated\": " << (long)time(NULL) << ",\n"
+       << "  \"elapsed_seconds\": " << elapsed << ",\n"
+       << "  \"region\": " << json_string(p_name) << ",\n"
+       << "  \"region_index\": " << p_region+1 << ",\n"
+       << "  \"regions\": " << p_nregion << ",\n"
+       << "  \"stage\": " << json_string(p_stage<0 ? "" : metric_stage_name(p_stage)) << ",\n"
+       << "  \"position\": " << p_pos+1 << ",\n"
+       << "  \"reads\": " << nread << ",\n"
+       << "  \"reads_per_second\": " << ( elapsed>0 ? nread/elapsed : 0 ) << ",\n"
+       << "  \"candidates_validated\": " << p_validated << ",\n"
+       << "  \"candidates_total\": " << p_candidates << ",\n"
+       << "  \"bases_done\": " << (long)done << ",\n"
+       << "  \"bases_total\": " << (long)p_total << ",\n"
+       << "  \"eta_seconds\": " << eta << "\n"
+       << "}\n";
+  FOUT.close();
+  if ( rename(tmp.c_str(), p_file.c_str())!=0 ) 
+    cerr << "cannot write " << p_file << endl;
+  return;
+}
+
+void progress_open(const string& fn, int nregion, double total_bases)
+{
+  p_file=fn;
+  p_t0=wall_time();
+  p_nregion=nregion;
+  p_total=total_bases;
+  progress_write(true);
+  return;
+}
+
+void progress_region(int i, const string& name, int beg, double bases)
+{
+  p_done+=p_bases;
+  p_reads+=p_nread;
+  p_region=i;
+  p_name=name;
+  p_beg=beg;
+  p_bases=bases;
+  p_stage=-1;
+  p_pos=p_scanned=-1;
+  p_nread=0;
+  p_validated=p_candidates=0;
+  progress_write(true);
+  return;
+}
+
+void progress_stage(int stage)
+{
+  p_stage=stage;
+  p_validated=p_candidates=0;
+  progress_write(true);
+  return;
+}
+
+void progress_reads(size_t nread, int pos)
+{
+  p_nread=nread;
+  p_pos=p_scanned=pos;
+  progress_write(false);
+  return;
+}
+
+void progress_position(int pos)
+{
+  p_pos=pos;
+  progress_write(false);
+  return;
+}
+
+void progress_candidates(size_t done, size_t total)
+{
+  p_validated=done;
+  p_candidates=total;
+  progress_write(false);
+  return;
+}
+
+void progress_close()
+{
+  p_done+=p_bases;
+  p_reads+=p_nread;
+  p_bases=0;
+  p_nread=0;
+  progress_write(true, "done");
+  return;
+}
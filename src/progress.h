@@ -0,0 +1,39 @@
+#ifndef _PROGRESS_H
+#define _PROGRESS_H
+
+using namespace std;
+#include <string>
+
+//! the status file is rewritten at most once per PROGRESS_INTERVAL seconds
+#define PROGRESS_INTERVAL 2.0
+
+/*!
+  @abstract status file of a running job, written with -status FILE
+
+  FILE is a small JSON object rewritten through FILE.tmp and rename(), so
+  readers never see a partial file. it holds the region, stage, position,
+  reads per second, candidates validated and an ETA from the bases of the
+  regions left at the measured throughput. "updated" is the heartbeat.
+  the calls are cheap and return at once unless the interval has passed.
+*/
+
+//! total_bases is the length of all regions of the run
+void progress_open(const string& fn, int nregion, double total_bases);
+
+//! start region i of length bases beginning at beg, the previous one is done
+void progress_region(int i, const string& name, int beg, double bases);
+
+//! stage is a metric_stage, written at once
+void progress_stage(int stage);
+
+//! reads of the current region seen so far, pos is the last position
+void progress_reads(size_t nread, int pos);
+//! position reached by the matching of the calling thread
+void progress_position(int pos);
+//! candidates of the current stage validated so far
+void progress_candidates(size_t done, size_t total);
+
+//! write the final status
+void progress_close();
+
+#endif
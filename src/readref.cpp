@@ -1,26 +1,143 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <complex>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <cstdlib>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <pthread.h>
 using namespace std;
 
-bool read_fasta(string fastaFile, string chr, string& ref)
+/**** samtools headers ****/
+#include <faidx.h>
+#include <khash.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "ref2bit.h"
+
+// read base to 2 bit code, 4 for N and 5 for anything else
+static const uint8_t read_to_2bit[256] = {
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+  5,0,5,1,5,5,5,2,5,5,5,5,5,5,4,5, 5,5,5,5,3,5,5,5,5,5,5,5,5,5,5,5,
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+  5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5, 5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5
+};
+
+#define EVEN_BITS 0x5555555555555555ULL
+
+//! 32 packed bases starting at base p, the sidecar pads each contig
+//! so that reading past the last base is safe
+static inline uint64_t packed_word(const uint8_t *s, size_t p)
 {
-  if ( chr=="*" ) { 
-    cerr << "Warning\nWarning\nWarning\n"
-	 << chr << " not a valid RNAME\n"; 
-    ref="";
-    return false;
-  } 
+  uint64_t lo;
+  memcpy(&lo, s+(p>>2), 8);
+  int sh=(p&3)<<1;
+  if ( sh==0 ) return lo;
+  return (lo>>sh) | ( (uint64_t)s[(p>>2)+8] << (64-sh) );
+}
+
+//! 32 bits of the N mask starting at base p
+static inline uint32_t mask_word(const uint8_t *m, size_t p)
+{
+  uint64_t w;
+  memcpy(&w, m+(p>>3), 8);
+  return (uint32_t)( w >> (p&7) );
+}
+
+//! move bit i of x to bit 2i
+static inline uint64_t spread_bits(uint32_t x)
+{
+  uint64_t v=x;
+  v=(v|(v<<16)) & 0x0000FFFF0000FFFFULL;
+  v=(v|(v<<8))  & 0x00FF00FF00FF00FFULL;
+  v=(v|(v<<4))  & 0x0F0F0F0F0F0F0F0FULL;
+  v=(v|(v<<2))  & 0x3333333333333333ULL;
+  v=(v|(v<<1))  & EVEN_BITS;
+  return v;
+}
+
+//! bit 2i is set if base a+i differs from base b+i, N equals only N
+static inline uint64_t packed_diff(const uint8_t *pk, const uint8_t *nm, 
+				   size_t a, size_t b)
+{
+  uint64_t x=packed_word(pk, a) ^ packed_word(pk, b);
+  x=(x|(x>>1)) & EVEN_BITS;
+  uint64_t na=spread_bits( mask_word(nm, a) );
+  uint64_t nb=spread_bits( mask_word(nm, b) );
+  return ( x & ~(na|nb) ) | (na^nb);
+}
+
+//! keep the lowest w bases of a packed word
+static inline uint64_t low_bases(uint64_t x, size_t w)
+{
+  return w<32 ? x & ( ((uint64_t)1<<(w<<1))-1 ) : x;
+}
+
+refseq_st::refseq_st(): name(""), len(0), offset(0), linebases(1), linewidth(1),
+			base(NULL), flat(NULL), buf(NULL), 
+			pk(NULL), nm(NULL), gp(NULL), ng(0), map(NULL), maplen(0)
+{
+}
+
+refseq_st::~refseq_st()
+{
+  clear();
+}
+
+void refseq_st::clear()
+{
+  if ( map ) munmap(map, maplen);
+  if ( buf ) free(buf);
+  map=NULL;
+  maplen=0;
+  buf=NULL;
+  base=flat=NULL;
+  pk=nm=NULL;
+  gp=NULL;
+  ng=0;
+  name="";
+  len=offset=0;
+  linebases=linewidth=1;
+}
+
+KHASH_MAP_INIT_STR(fai, int)
+
+// guards the .fai and sidecar tables, contigs may be loaded ahead on 
+// another thread
+static pthread_mutex_t ref_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the .fai of one fasta file, names in the hash point into fai_list
+static string fai_fasta="";
+static vector<faientry_st> fai_list(0);
+static khash_t(fai) *fai_hash=NULL;
+
+const vector<faientry_st>& load_fai(const string& fastaFile)
+{
+  if ( fai_hash && fastaFile==fai_fasta ) return fai_list;
+  if ( fai_hash ) kh_destroy(fai, fai_hash);
+  fai_hash=kh_init(fai);
+  fai_fasta=fastaFile;
+  fai_list.clear();
   
   string faiFile=fastaFile+".fai";
-  ifstream FAI;
-  FAI.close();
-  FAI.clear();
-  FAI.open(faiFile.c_str(), ifstream::in);
+  ifstream FAI(faiFile.c_str());
+  if ( !FAI && file_exist(fastaFile) ) {
+    cerr << "[read_fasta] building " << faiFile << endl;
+    if ( fai_build(fastaFile.c_str())==0 ) FAI.open(faiFile.c_str());
+    FAI.clear();
+  }
+  // the index may be on a busy network file system
   int failcount=0;
   while ( !FAI && failcount<5 ) {
     usleep(3000000);
@@ -36,77 +153,295 @@ bool read_fasta(string fastaFile, string chr, string& ref)
     exit(0); 
   }
   
-  long i,k;
-  string ichr;
-  long len, offset, nbases, lwidth;
-  bool found=false;
-  while ( !FAI.eof() ) {
-    string tmps;
-    getline(FAI,tmps);
+  string tmps;
+  while ( getline(FAI, tmps) ) {
     istringstream iss(tmps);
-    iss >> ichr >> len >> offset >> nbases >> lwidth;
-    if ( ichr==chr ) { found=true; break; }
+    faientry_st e;
+    if ( iss >> e.name >> e.len >> e.offset >> e.linebases >> e.linewidth ) 
+      fai_list.push_back(e);
+  }
+  
+  for(size_t i=0; i<fai_list.size(); ++i) {
+    int absent;
+    khint_t k=kh_put(fai, fai_hash, fai_list[i].name.c_str(), &absent);
+    if ( absent ) kh_value(fai_hash, k)=i;
   }
-  //  FAI.close();
-  if ( !found ) { 
-    ref="";
+  return fai_list;
+}
+
+const faientry_st* find_fai(const string& fastaFile, const string& chr)
+{
+  pthread_mutex_lock(&ref_lock);
+  load_fai(fastaFile);
+  khint_t k=kh_get(fai, fai_hash, chr.c_str());
+  const faientry_st *e= k==kh_end(fai_hash) ? NULL : &fai_list[ kh_value(fai_hash, k) ];
+  pthread_mutex_unlock(&ref_lock);
+  return e;
+}
+
+bool refseq_st::load(const string& fastaFile, const string& chr)
+{
+  clear();
+  if ( chr=="*" ) { 
+    cerr << "Warning\nWarning\nWarning\n"
+	 << chr << " not a valid RNAME\n"; 
     return false;
   } 
   
-  ifstream FIN(fastaFile.c_str());
+  const faientry_st *e=find_fai(fastaFile, chr);
+  if ( e==NULL ) return false;
+  long l=e->len, o=e->offset, nbases=e->linebases, lwidth=e->linewidth;
+  if ( l<=0 ) {
+    name=chr;
+    return true;
+  }
+  if ( nbases<=0 || lwidth<nbases ) {
+    cerr << "[read_fasta] bad index line for " << chr << endl;
+    exit(0);
+  }
   
-  long flen;
-  flen=len+(len/nbases)*(lwidth-nbases);
-  ref.reserve(len+1);
-  ref.resize(len);
-  char *buffer = new char [flen+1];
-  FIN.seekg(offset, std::ios::beg);
-
-  //cerr << "seeking to offset " << offset << endl;
-  FIN.read(buffer,flen);
-  FIN.close();
-  buffer[flen]=0;
-  for(k=0,i=0; k<flen ;++k) 
-    if ( buffer[k] != '\n' ) { 
-      ref[i]=buffer[k];
-      ++i;
-    }
-  delete[] buffer;
-  if ( i!=len ) {
-    cerr << "Error reading the reference fasta\n"
-	 << "read " << i << " bases\n"
-	 << "expecting " << len << " bases"
-	 << endl;
+  int fd=open(fastaFile.c_str(), O_RDONLY);
+  if ( fd<0 ) {
+    cerr << "[read_fasta] Failed to open " << fastaFile << endl;
+    exit(0);
+  }
+  // the mapping starts at a page boundary
+  size_t flen=(l-1)/nbases*lwidth + (l-1)%nbases + 1;
+  size_t page=sysconf(_SC_PAGESIZE);
+  size_t mapbeg=o/page*page;
+  maplen=o-mapbeg+flen;
+  map=mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, mapbeg);
+  close(fd);
+  if ( map==MAP_FAILED ) {
+    map=NULL;
+    cerr << "[read_fasta] Failed to map " << fastaFile << " " << chr << endl;
     exit(0);
   }
+  madvise(map, maplen, MADV_SEQUENTIAL);
   
+  name=chr;
+  len=l;
+  offset=o;
+  linebases=nbases;
+  linewidth=lwidth;
+  base=(const char*)map + (o-mapbeg);
+  if ( len<=linebases || linebases==linewidth ) flat=base;
   return true;
 }
 
-void get_N_regions(string& fasta, vector<int>& beg, vector<int>& end)
+bool refseq_st::load_packed(const string& fastaFile, const string& chr)
 {
+  clear();
+  pthread_mutex_lock(&ref_lock);
+  const ref2bit_contig_st *c=ref2bit_find(fastaFile, chr);
   
-  beg.clear(); 
-  end.clear();
+  // build the sidecar once per run if it is missing or out of date; the
+  // build reads the fasta through find_fai(), which takes ref_lock
+  static string tried="";
+  if ( c==NULL && tried!=fastaFile ) {
+    tried=fastaFile;
+    pthread_mutex_unlock(&ref_lock);
+    cerr << "#building " << fastaFile << REF2BIT_SUFFIX << endl;
+    bool built=ref2bit_build(fastaFile);
+    if ( !built )
+      cerr << "#failed to write " << fastaFile << REF2BIT_SUFFIX 
+	   << ", reading " << fastaFile << endl;
+    pthread_mutex_lock(&ref_lock);
+    c=ref2bit_find(fastaFile, chr);
+  }
+  pthread_mutex_unlock(&ref_lock);
+  if ( c==NULL ) return load(fastaFile, chr);
   
-  for(int i=0; i<(int)fasta.size();++i) {
-    if( fasta[i]!='N' ) continue;
-    if ( end.size()==0 ) {
-      beg.push_back(i);
-      end.push_back(i);
-      continue;
+  name=chr;
+  len=c->len;
+  pk=c->seq;
+  nm=c->nmask;
+  gp=c->gap;
+  ng=c->ngap;
+  return true;
+}
+
+void refseq_st::materialise()
+{
+  if ( flat ) return;
+  buf=(char*) malloc(len+1);
+  if ( buf==NULL ) {
+    cerr << "[read_fasta] out of memory for " << name << endl;
+    exit(0);
+  }
+  if ( pk ) {
+    for(size_t p=0; p<len; ++p) buf[p]=(*this)[p];
+    buf[len]=0;
+    base=flat=buf;
+    return;
+  }
+  for(size_t p=0; p<len; ) {
+    size_t n;
+    const char *s=chunk(p, n);
+    memcpy(buf+p, s, n);
+    p+=n;
+  }
+  buf[len]=0;
+  // the de-lined copy replaces the mapping
+  munmap(map, maplen);
+  map=NULL;
+  maplen=0;
+  base=flat=buf;
+  linebases=linewidth=len;
+}
+
+size_t refseq_st::totalRAM() const
+{
+  size_t n=sizeof(*this)+maplen;
+  if ( buf ) n+=len+1;
+  else if ( pk ) n+=(len+3)/4+(len+7)/8;
+  return n;
+}
+
+void refseq_st::prefault() const
+{
+  size_t page=sysconf(_SC_PAGESIZE);
+  volatile char sink=0;
+  if ( pk ) {
+    for(size_t i=0; i<(len+3)/4; i+=page) sink^=pk[i];
+    for(size_t i=0; i<(len+7)/8; i+=page) sink^=nm[i];
+  }
+  else if ( map ) 
+    for(size_t i=0; i<maplen; i+=page) sink^=((const char*)map)[i];
+  (void)sink;
+}
+
+void refseq_st::swap(refseq_st& other)
+{
+  name.swap(other.name);
+  std::swap(len, other.len);
+  std::swap(offset, other.offset);
+  std::swap(linebases, other.linebases);
+  std::swap(linewidth, other.linewidth);
+  std::swap(base, other.base);
+  std::swap(flat, other.flat);
+  std::swap(buf, other.buf);
+  std::swap(pk, other.pk);
+  std::swap(nm, other.nm);
+  std::swap(gp, other.gp);
+  std::swap(ng, other.ng);
+  std::swap(map, other.map);
+  std::swap(maplen, other.maplen);
+}
+
+const char* refseq_st::chunk(size_t p, size_t& n) const
+{
+  if ( p>=len ) { n=0; return NULL; }
+  if ( flat ) { n=len-p; return flat+p; }
+  if ( pk ) {
+    cerr << "refseq_st::chunk() called on packed " << name << endl;
+    exit(0);
+  }
+  n=linebases-p%linebases;
+  if ( p+n>len ) n=len-p;
+  return base + p/linebases*linewidth + p%linebases;
+}
+
+string refseq_st::substr(size_t pos, size_t n) const
+{
+  string s;
+  if ( pos>=len ) return s;
+  if ( n>len-pos ) n=len-pos;
+  if ( flat ) return string(flat+pos, n);
+  s.reserve(n);
+  if ( pk ) {
+    for(size_t p=pos; p<pos+n; ++p) s+=(*this)[p];
+    return s;
+  }
+  while ( n>0 ) {
+    size_t k;
+    const char *c=chunk(pos, k);
+    if ( k>n ) k=n;
+    s.append(c, k);
+    pos+=k;
+    n-=k;
+  }
+  return s;
+}
+
+size_t refseq_st::match_forward(size_t a, size_t b, size_t n) const
+{
+  size_t k=0;
+  if ( is_packed() ) {
+    while ( k<n ) {
+      size_t w= n-k<32 ? n-k : 32;
+      uint64_t d=low_bases( packed_diff(pk, nm, a+k, b+k), w );
+      if ( d ) return k+__builtin_ctzll(d)/2;
+      k+=w;
+    }
+    return k;
+  }
+  while ( k<n && (*this)[a+k]==(*this)[b+k] ) ++k;
+  return k;
+}
+
+size_t refseq_st::match_backward(size_t a, size_t b, size_t n) const
+{
+  size_t k=0;
+  if ( is_packed() ) {
+    while ( k<n ) {
+      // window of w bases ending at a-k and b-k
+      size_t w= n-k<32 ? n-k : 32;
+      uint64_t d=low_bases( packed_diff(pk, nm, a-k-w+1, b-k-w+1), w );
+      if ( d ) return k + w-1 - (63-__builtin_clzll(d))/2;
+      k+=w;
     }
-    
-    if ( i==(end.back()+1) ) {
-      end.back()=i;
-      continue;
+    return k;
+  }
+  while ( k<n && (*this)[a-k]==(*this)[b-k] ) ++k;
+  return k;
+}
+
+size_t refseq_st::mismatches(size_t pos, const char *s, size_t n) const
+{
+  if ( pos>=len ) return 0;
+  if ( n>len-pos ) n=len-pos;
+  size_t m=0;
+  if ( is_packed() ) {
+    for(size_t k=0; k<n; k+=32) {
+      size_t w= n-k<32 ? n-k : 32;
+      uint64_t code=0, sn=0, sx=0;
+      for(size_t i=0; i<w; ++i) {
+	uint64_t c=read_to_2bit[ (uint8_t)s[k+i] ];
+	if ( c<4 ) code |= c << (i<<1);
+	else if ( c==4 ) sn |= (uint64_t)1 << (i<<1);
+	else sx |= (uint64_t)1 << (i<<1);
+      }
+      uint64_t x=packed_word(pk, pos+k) ^ code;
+      x=(x|(x>>1)) & EVEN_BITS;
+      uint64_t rn=spread_bits( mask_word(nm, pos+k) );
+      uint64_t d=( x & ~(rn|sn|sx) ) | (rn^sn) | sx;
+      m+=__builtin_popcountll( low_bases(d, w) );
     }
-    
-    beg.push_back(i);
-    end.push_back(i);
+    return m;
   }
+  if ( flat ) {
+    for(size_t i=0; i<n; ++i) m+= flat[pos+i]!=s[i];
+    return m;
+  }
+  for(size_t i=0; i<n; ++i) m+= (*this)[pos+i]!=s[i];
+  return m;
+}
+
+bool read_fasta(string fastaFile, string chr, string& ref)
+{
+  ref="";
+  refseq_st view;
+  if ( !view.load(fastaFile, chr) ) return false;
   
-  return;
+  ref.resize(view.size());
+  for(size_t p=0; p<view.size(); ) {
+    size_t n;
+    const char *s=view.chunk(p, n);
+    memcpy(&ref[p], s, n);
+    p+=n;
+  }
+  return true;
 }
 
 void load_reference(string fastaFile, string chr, string& ref)
@@ -136,3 +471,31 @@ void load_reference(string fastaFile, string chr, string& ref)
   
   return;
 }
+
+void load_reference(string fastaFile, string chr, refseq_st& ref, bool packed)
+{
+  
+  ref.clear();
+  if ( packed ? ref.load_packed(fastaFile, chr) : ref.load(fastaFile, chr) ) {
+    cerr << "#loaded " << chr << " from " << fastaFile << "\tlength=" 
+	 << ref.size() << endl;
+    return;
+  }
+  
+  string tmps=chr;
+  if ( chr.find("chr")==0 || chr.find("CHR")==0 ) chr=chr.substr(3); 
+  else  chr="chr"+chr;
+  if ( packed ? ref.load_packed(fastaFile, chr) : ref.load(fastaFile, chr) ) {
+    cerr << "#loading " << tmps << " failed\n"
+	 << "#loaded " << chr << " from " << fastaFile << "\tlength=" 
+	 << ref.size() 
+	 << endl;
+    return;
+  }
+  else {
+    cerr << "loading " << tmps << " failed" << endl
+	 << "loading " << chr << " failed" << endl;
+  }
+  
+  return;
+}
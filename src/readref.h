@@ -1,8 +1,126 @@
 #ifndef _READ_REF_H
 #define _READ_REF_H
 
+using namespace std;
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+/*!
+  @abstract one line of a .fai index
+  
+  @field  len        contig length
+  @field  offset     file offset of the first base
+  @field  linebases  bases per line
+  @field  linewidth  bytes per line, including the line terminator
+*/
+struct faientry_st {
+  string name;
+  long len;
+  long offset;
+  long linebases;
+  long linewidth;
+};
+
+//! entries of fastaFile.fai in file order. the index is read once per 
+//! run and hashed by name; it is built with samtools if it is missing.
+//! find_fai() and refseq_st loaders may be called from several threads,
+//! load_fai() only before threads are started
+const vector<faientry_st>& load_fai(const string& fastaFile);
+//! entry of chr in fastaFile.fai, NULL if chr is not in the index
+const faientry_st* find_fai(const string& fastaFile, const string& chr);
+
+/*!
+  @abstract read-only view of one contig of an indexed FASTA
+  
+  the contig is mmap'ed from the FASTA file and a 0-based position is
+  translated to a file offset with the line geometry in the .fai index,
+  so nothing is copied when the view is loaded. materialise() copies the
+  contig once into a de-lined buffer; a contig stored in a single line
+  is contiguous in the file and is never copied.
+  
+  load_packed() maps the contig from the 2-bit sidecar instead, see
+  ref2bit.h, where bases are upper case ACGTN. match_forward(), 
+  match_backward() and mismatches() compare 32 packed bases at a time.
+  
+  the view provides the parts of std::string used on reference sequences,
+  size(), operator[] and substr().
+  
+  @field  name       contig name as found in the .fai
+  @field  len        contig length
+  @field  offset     file offset of the first base
+  @field  linebases  bases per line
+  @field  linewidth  bytes per line, including the line terminator
+*/
+struct refseq_st {
+  string name;
+  size_t len;
+  size_t offset;
+  size_t linebases;
+  size_t linewidth;
+  
+  refseq_st();
+  ~refseq_st();
+  
+  //! map contig chr of fastaFile, false if chr is not in the .fai
+  bool load(const string& fastaFile, const string& chr);
+  //! map contig chr from fastaFile.mc2bit, which is built if needed
+  //! false if chr is not in the .fai or the sidecar can not be built
+  bool load_packed(const string& fastaFile, const string& chr);
+  //! copy the contig into a de-lined buffer, later access is a plain index
+  void materialise();
+  bool is_materialised() const { return flat!=NULL; }
+  bool is_packed() const { return pk!=NULL && flat==NULL; }
+  void clear();
+  //! read one byte of every page so that later access does not fault
+  void prefault() const;
+  //! bytes held for the contig, the copy or the mapped part
+  size_t totalRAM() const;
+  //! exchange two views, used to hand over a contig loaded by another thread
+  void swap(refseq_st& other);
+  
+  size_t size() const { return len; }
+  size_t length() const { return len; }
+  char operator[](size_t p) const {
+    if ( flat ) return flat[p];
+    if ( pk ) return (nm[p>>3]>>(p&7)) & 1 ? 'N' : "ACGT"[ (pk[p>>2]>>((p&3)<<1)) & 3 ];
+    return base[ p/linebases*linewidth + p%linebases ];
+  }
+  //! bases from p to the end of its line, n returns the number of bases
+  //! not available on a packed view
+  const char* chunk(size_t p, size_t& n) const;
+  //! same as std::string::substr
+  string substr(size_t pos, size_t n=string::npos) const;
+  
+  //! number of k<n with [a+k]==[b+k] for all of them, a+n and b+n <= size()
+  size_t match_forward(size_t a, size_t b, size_t n) const;
+  //! number of k<n with [a-k]==[b-k] for all of them, n <= a+1 and b+1
+  size_t match_backward(size_t a, size_t b, size_t n) const;
+  //! number of i<n with [pos+i]!=s[i], n is cut at size()
+  size_t mismatches(size_t pos, const char *s, size_t n) const;
+  
+  //! N runs saved in the packed sidecar, pairs of first and last base
+  size_t ngap() const { return ng; }
+  const uint32_t* gaps() const { return gp; }
+  
+ private:
+  const char *base;       // first base of the contig in the mapping
+  const char *flat;       // contiguous sequence, NULL if lines must be skipped
+  char *buf;              // de-lined copy made by materialise()
+  const uint8_t *pk;      // packed bases, owned by the sidecar mapping
+  const uint8_t *nm;      // N mask of packed bases
+  const uint32_t *gp;     // N runs of packed bases
+  size_t ng;
+  void *map;
+  size_t maplen;
+  
+  refseq_st(const refseq_st&);
+  refseq_st& operator=(const refseq_st&);
+};
+
 bool read_fasta(string fastaFile, string chr, string& ref);
-void get_N_regions(string& fasta, vector<int>& beg, vector<int>& end);
 void load_reference(string fastaFile, string chr, string& ref);
+void load_reference(string fastaFile, string chr, refseq_st& ref, bool packed=false);
 
 #endif
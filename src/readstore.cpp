@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "samfunctions.h"
+#include "readstore.h"
+
+// nt16 code to 2 bit code, 4 means the base can not be packed
+static const uint8_t nt16_to_2bit[16] = {
+  4, 0, 1, 4, 2, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4
+};
+static const char base_2bit[4] = { 'A', 'C', 'G', 'T' };
+static const uint8_t base_2bit_nt16[4] = { 1, 2, 4, 8 };
+
+readstore_st::readstore_st(): tid(-1), used(READSTORE_CHUNK), nbytes(0)
+{
+}
+
+readstore_st::~readstore_st()
+{
+  clear();
+}
+
+void readstore_st::clear()
+{
+  for(size_t i=0; i<chunks.size(); ++i) free(chunks[i]);
+  vector<uint8_t*> (0).swap(chunks);
+  vector<int32_t> (0).swap(pos);
+  vector<int32_t> (0).swap(sbeg);
+  vector<uint16_t> (0).swap(S);
+  vector<uint16_t> (0).swap(l_qseq);
+  vector<uint16_t> (0).swap(n_cigar);
+  vector<uint8_t> (0).swap(mapq);
+  vector<uint8_t> (0).swap(enc);
+  vector<uint32_t> (0).swap(off);
+  used=READSTORE_CHUNK;
+  nbytes=0;
+  tid=-1;
+}
+
+void readstore_st::reset()
+{
+  if ( chunks.size()>1 ) {
+    clear();
+    return;
+  }
+  pos.clear();
+  sbeg.clear();
+  S.clear();
+  l_qseq.clear();
+  n_cigar.clear();
+  mapq.clear();
+  enc.clear();
+  off.clear();
+  used= chunks.size()>0 ? 0 : READSTORE_CHUNK;
+  nbytes=0;
+  tid=-1;
+}
+
+//! reserve len bytes, 4-byte aligned, in the last chunk or a new one
+//! o returns the record offset in 4-byte units
+uint8_t* readstore_st::allocate(size_t len, uint32_t& o)
+{
+  len=(len+3) & ~(size_t)3;
+  if ( used+len > READSTORE_CHUNK ) {
+    if ( (chunks.size()+1) >> (32-(READSTORE_CHUNK_BITS-2)) ) {
+      cerr << "readstore: too many reads to be saved" << endl;
+      exit(0);
+    }
+    uint8_t *p=(uint8_t*) malloc(READSTORE_CHUNK);
+    if ( p==NULL ) {
+      cerr << "readstore: out of memory after " << nbytes << " bytes" << endl;
+      exit(0);
+    }
+    chunks.push_back(p);
+    used=0;
+  }
+  o = ( (uint32_t)(chunks.size()-1) << (READSTORE_CHUNK_BITS-2) ) | (uint32_t)(used>>2);
+  uint8_t *p=chunks.back()+used;
+  used+=len;
+  nbytes+=len;
+  return p;
+}
+
+bool readstore_st::add(const bam1_t *b, const POSCIGAR_st& m, const refseq_st& FASTA)
+{
+  if ( m.op.size()<1 || m.op.size()>0xffff ) return false;
+  if ( b->core.l_qseq<=0 || b->core.l_qseq>0xffff ) return false;
+
+  int l=b->core.l_qseq;
+  uint8_t *s=bam1_seq(b);
+  bool packable=true;
+  for(int i=0; i<l && packable; ++i) packable = nt16_to_2bit[bam1_seqi(s, i)]<4;
+
+  int ncigar=m.op.size();
+  int lseq= packable ? (l+3)/4 : (l+1)/2;
+  int lflag=(l+3)/4;
+  uint32_t o;
+  uint8_t *p=allocate(ncigar*4+lseq+lflag, o);
+
+  uint32_t *cigar=(uint32_t*) p;
+  for(int k=0; k<ncigar; ++k) cigar[k]=bam_cigar_gen(m.nop[k], m.op[k]);
+
+  uint8_t *q=p+ncigar*4;
+  if ( packable ) {
+    memset(q, 0, lseq);
+    for(int i=0; i<l; ++i)
+      q[i>>2] |= nt16_to_2bit[bam1_seqi(s, i)] << ((i&3)<<1);
+  }
+  else memcpy(q, s, lseq);
+
+  if ( tid<0 ) tid=b->core.tid;
+  pos.push_back( m.anchor>=0 && m.pos>=m.base ? m.pos-m.base : b->core.pos );
+  sbeg.push_back( m.iclip>=0 ? m.cop[m.iclip]-m.base : -1 );
+  S.push_back( m.iclip>=0 ? m.nop[m.iclip] : 0 );
+  l_qseq.push_back(l);
+  n_cigar.push_back(ncigar);
+  mapq.push_back(b->core.qual);
+  enc.push_back( packable ? READSTORE_SEQ_2BIT : READSTORE_SEQ_4BIT );
+  off.push_back(o);
+
+  // reference projected onto the stored (calibrated) read and its
+  // expanded CIGAR, exactly as ref_projected_onto_qseq() and expand_cigar()
+  size_t i=size()-1;
+  bam1_t view;
+  vector<uint8_t> buf(0);
+  get_bam(i, view, buf);
+  string qseq=get_qseq(i);
+  string qref=ref_projected_onto_qseq(&view, FASTA);
+  vector<int> e_cigar(0);
+  expand_cigar(&view, e_cigar);
+  uint8_t *f=p+ncigar*4+lseq;
+  memset(f, 0, lflag);
+  for(int k=0; k<l; ++k) {
+    int flag=0;
+    if ( k>=(int)qref.size() || qref[k]!=qseq[k] ) flag |= READSTORE_BASE_MM;
+    if ( k<(int)e_cigar.size() && 
+	 ( e_cigar[k]==BAM_CMATCH || e_cigar[k]==BAM_CEQUAL ) ) flag |= READSTORE_BASE_M;
+    f[k>>2] |= flag << ((k&3)<<1);
+  }
+
+  return true;
+}
+
+bool readstore_st::add(const bam1_t *b, const refseq_st& FASTA)
+{
+  POSCIGAR_st m;
+  resolve_cigar_pos(b, m, 0);
+  if ( m.op.size()<1 ) return false;
+  string SEQ=::get_qseq(b);
+  calibrate_resolved_cigar_pos(FASTA, SEQ, m);
+  return add(b, m, FASTA);
+}
+
+void readstore_st::add_raw(int32_t p, int32_t sb, uint16_t s, uint16_t l, uint16_t nc, 
+			   uint8_t q, uint8_t e, const uint8_t *data)
+{
+  size_t len=raw_size(nc, l, e);
+  uint32_t o;
+  memcpy(allocate(len, o), data, len);
+  pos.push_back(p);
+  sbeg.push_back(sb);
+  S.push_back(s);
+  l_qseq.push_back(l);
+  n_cigar.push_back(nc);
+  mapq.push_back(q);
+  enc.push_back(e);
+  off.push_back(o);
+}
+
+void readstore_st::add_raw(const readstore_st& src, size_t i)
+{
+  if ( tid<0 ) tid=src.tid;
+  add_raw(src.pos[i], src.sbeg[i], src.S[i], src.l_qseq[i], src.n_cigar[i],
+	  src.mapq[i], src.enc[i], src.raw(i));
+}
+
+//! walk the CIGAR the same way as resolve_cigar_pos() and get_pos_for_base()
+//! without building a POSCIGAR_st
+int readstore_st::get_pos_for_base(size_t i, int p) const
+{
+  const uint32_t *cigar=this->cigar(i);
+  int ncigar=n_cigar[i];
+
+  int anchor=-1;
+  for(int k=0; k<ncigar; ++k) {
+    int op=bam_cigar_op(cigar[k]);
+    if ( op == BAM_CMATCH || op == BAM_CDEL || 
+	 op == BAM_CEQUAL || op == BAM_CDIFF ) { anchor=k; break; }
+  }
+  if ( anchor<0 ) return -1;
+
+  // reference position of the anchor is pos, ops before it are walked back
+  int cop=pos[i];
+  for(int k=anchor-1; k>=0; --k) {
+    int op=bam_cigar_op(cigar[k]);
+    if ( op == BAM_CMATCH || op == BAM_CDEL || 
+	 op == BAM_CREF_SKIP || op == BAM_CSOFT_CLIP ) cop-=bam_cigar_oplen(cigar[k]);
+  }
+
+  int qop=0;
+  for(int k=0; k<ncigar; ++k) {
+    int op=bam_cigar_op(cigar[k]);
+    int l=bam_cigar_oplen(cigar[k]);
+    bool onqseq= ( op == BAM_CMATCH || op == BAM_CINS || op == BAM_CSOFT_CLIP || 
+		   op == BAM_CEQUAL || op == BAM_CDIFF );
+    if ( onqseq && qop<=p && qop+l>p ) return cop+p-qop;
+    if ( onqseq ) qop+=l;
+    if ( op == BAM_CMATCH || op == BAM_CDEL || 
+	 op == BAM_CREF_SKIP || op == BAM_CSOFT_CLIP ) cop+=l;
+  }
+
+  cerr << "get_pos_for_base(): Error finding the position " 
+       << p << " in read " << i << endl;
+  return -1;
+}
+
+void readstore_st::get_qseq(size_t i, string& s) const
+{
+  int l=l_qseq[i];
+  const uint8_t *q=seq(i);
+  s.resize(l);
+  if ( enc[i]==READSTORE_SEQ_2BIT )
+    for(int k=0; k<l; ++k) s[k]=base_2bit[ (q[k>>2]>>((k&3)<<1)) & 3 ];
+  else
+    for(int k=0; k<l; ++k) s[k]=bam_nt16_rev_table[bam1_seqi(q, k)];
+  return;
+}
+string readstore_st::get_qseq(size_t i) const
+{
+  string s;
+  get_qseq(i, s);
+  return s;
+}
+
+void readstore_st::get_bam(size_t i, bam1_t& b, vector<uint8_t>& buf) const
+{
+  memset(&b, 0, sizeof(bam1_t));
+  b.core.tid=tid;
+  b.core.pos=pos[i];
+  b.core.qual=mapq[i];
+  b.core.n_cigar=n_cigar[i];
+  b.core.l_qseq=l_qseq[i];
+  b.core.mtid=-1;
+  b.core.mpos=-1;
+  b.data_len=n_cigar[i]*4 + (l_qseq[i]+1)/2;
+  b.m_data=b.data_len;
+
+  if ( enc[i]==READSTORE_SEQ_4BIT ) {
+    b.data=(uint8_t*) record(i);
+    return;
+  }
+
+  // expand 2 bit sequence to nt16
+  buf.resize(b.data_len);
+  memcpy(&buf[0], record(i), n_cigar[i]*4);
+  uint8_t *s=&buf[0]+n_cigar[i]*4;
+  const uint8_t *q=seq(i);
+  int l=l_qseq[i];
+  memset(s, 0, (l+1)/2);
+  for(int k=0; k<l; ++k) {
+    uint8_t c=base_2bit_nt16[ (q[k>>2]>>((k&3)<<1)) & 3 ];
+    s[k>>1] |= c << ((~k&1)<<2);
+  }
+  b.data=&buf[0];
+  return;
+}
+
+size_t readstore_st::thin()
+{
+  size_t n=size();
+  if ( n<2 ) return 0;
+  // records are packed in the order they were added, so the packed kept
+  // ones never pass the record being read and can be moved in place
+  size_t w=0, wused=0, k=0;
+  nbytes=0;
+  for(size_t i=0; i<n; i+=2, ++k) {
+    size_t len=(raw_size(i)+3) & ~(size_t)3;
+    if ( wused+len > READSTORE_CHUNK ) {
+      ++w;
+      wused=0;
+    }
+    memmove(chunks[w]+wused, record(i), len);
+    pos[k]=pos[i];
+    sbeg[k]=sbeg[i];
+    S[k]=S[i];
+    l_qseq[k]=l_qseq[i];
+    n_cigar[k]=n_cigar[i];
+    mapq[k]=mapq[i];
+    enc[k]=enc[i];
+    off[k]= ( (uint32_t)w << (READSTORE_CHUNK_BITS-2) ) | (uint32_t)(wused>>2);
+    wused+=len;
+    nbytes+=len;
+  }
+  for(size_t c=w+1; c<chunks.size(); ++c) free(chunks[c]);
+  chunks.resize(w+1);
+  used=wused;
+  pos.resize(k);
+  sbeg.resize(k);
+  S.resize(k);
+  l_qseq.resize(k);
+  n_cigar.resize(k);
+  mapq.resize(k);
+  enc.resize(k);
+  off.resize(k);
+  return n-k;
+}
+
+size_t readstore_st::totalRAM() const
+{
+  return sizeof(*this)
+    + pos.capacity()*sizeof(int32_t)
+    + sbeg.capacity()*sizeof(int32_t)
+    + S.capacity()*sizeof(uint16_t)
+    + l_qseq.capacity()*sizeof(uint16_t)
+    + n_cigar.capacity()*sizeof(uint16_t)
+    + mapq.capacity() + enc.capacity()
+    + off.capacity()*sizeof(uint32_t)
+    + chunks.capacity()*sizeof(uint8_t*)
+    + chunks.size()*(size_t)READSTORE_CHUNK;
+}
@@ -0,0 +1,124 @@
+#ifndef _READSTORE_H
+#define _READSTORE_H
+
+using namespace std;
+#include <string>
+#include <vector>
+#include <bam.h>
+#include "samfunctions.h"
+
+//! size of one arena chunk, records never cross chunks and chunks never move
+#define READSTORE_CHUNK_BITS 23
+#define READSTORE_CHUNK (1<<READSTORE_CHUNK_BITS)
+
+//! sequence encoding of a record
+#define READSTORE_SEQ_2BIT 1   // ACGT only, 4 bases per byte
+#define READSTORE_SEQ_4BIT 2   // bam nt16 layout, 2 bases per byte
+
+//! per base flags, 2 bits per base, 4 bases per byte
+#define READSTORE_BASE_MM 1    // base differs from reference projected onto read
+#define READSTORE_BASE_M  2    // base is on a M or = CIGAR operation
+#define readstore_basei(f, i) ( ( (f)[(i)>>2] >> (((i)&3)<<1) ) & 3 )
+
+/*!
+  @abstract compact store for the reads used in soft clip matching
+
+  per read fields are kept as structure of arrays, CIGAR and sequence of
+  each read are appended to fixed size chunks that are never relocated,
+  so no pointer patching is needed while the store is growing.
+
+  reads are stored after CIGAR calibration (calibrate_resolved_cigar_pos),
+  hence calibration is done only once at ingest. the reference projected
+  onto each read (ref_projected_onto_qseq) and the expanded CIGAR are also
+  resolved at ingest and saved as per base flags after the sequence.
+
+  @field  tid     target id shared by all reads in the store
+  @field  pos     0-based position of the calibrated anchor
+  @field  sbeg    0-based reference position of the longest S part, -1 if none
+  @field  S       length of the longest S part
+  @field  l_qseq  length of read
+  @field  n_cigar number of calibrated CIGAR operations
+  @field  mapq    mapping quality
+  @field  enc     sequence encoding, READSTORE_SEQ_2BIT or READSTORE_SEQ_4BIT
+  @field  off     record offset, chunk index and 4-byte units within chunk
+*/
+struct readstore_st {
+  int tid;
+  vector<int32_t> pos;
+  vector<int32_t> sbeg;
+  vector<uint16_t> S;
+  vector<uint16_t> l_qseq;
+  vector<uint16_t> n_cigar;
+  vector<uint8_t> mapq;
+  vector<uint8_t> enc;
+  vector<uint32_t> off;
+
+  readstore_st();
+  ~readstore_st();
+
+  size_t size() const { return pos.size(); }
+  void clear();
+  //! drop all reads but keep the buffers of a store that fits in one chunk,
+  //! so the store can be refilled for the next small contig without malloc
+  void reset();
+
+  //! add a read whose CIGAR is already resolved and calibrated
+  bool add(const bam1_t *b, const POSCIGAR_st& m, const refseq_st& FASTA);
+  //! resolve and calibrate the CIGAR of b against FASTA, then add it
+  bool add(const bam1_t *b, const refseq_st& FASTA);
+
+  const uint32_t* cigar(size_t i) const {
+    return (const uint32_t*) record(i);
+  }
+  const uint8_t* seq(size_t i) const {
+    return record(i) + n_cigar[i]*4;
+  }
+  //! per base flags READSTORE_BASE_MM and READSTORE_BASE_M
+  const uint8_t* bflags(size_t i) const {
+    return seq(i) + ( enc[i]==READSTORE_SEQ_2BIT ? (l_qseq[i]+3)/4 : (l_qseq[i]+1)/2 );
+  }
+  //! 0-based reference position of base p of read i, same as get_pos_for_base()
+  int get_pos_for_base(size_t i, int p) const;
+
+  void get_qseq(size_t i, string& s) const;
+  string get_qseq(size_t i) const;
+
+  //! fill b as a read-only bam1_t view of read i without qname and aux
+  //! buf is used only if the sequence has to be expanded to nt16
+  void get_bam(size_t i, bam1_t& b, vector<uint8_t>& buf) const;
+
+  //! record of read i, CIGAR, sequence and base flags as laid out by add()
+  const uint8_t* raw(size_t i) const { return record(i); }
+  size_t raw_size(size_t i) const { return raw_size(n_cigar[i], l_qseq[i], enc[i]); }
+  static size_t raw_size(int n_cigar, int l_qseq, int enc) {
+    return n_cigar*4 + ( enc==READSTORE_SEQ_2BIT ? (l_qseq+3)/4 : (l_qseq+1)/2 ) + (l_qseq+3)/4;
+  }
+  //! add a read saved by another store, data is raw_size() bytes of raw()
+  void add_raw(int32_t p, int32_t sb, uint16_t s, uint16_t l, uint16_t nc, 
+	       uint8_t q, uint8_t e, const uint8_t *data);
+  //! add read i of src
+  void add_raw(const readstore_st& src, size_t i);
+
+  //! keep reads 0, 2, 4, ... in place and free the chunks left empty
+  //! returns the number of reads dropped
+  size_t thin();
+
+  size_t data_size() const { return nbytes; }
+  size_t totalRAM() const;
+
+ private:
+  vector<uint8_t*> chunks;
+  size_t used;           // bytes used in the last chunk
+  size_t nbytes;         // total bytes of records
+
+  const uint8_t* record(size_t i) const {
+    return chunks[ off[i]>>(READSTORE_CHUNK_BITS-2) ] +
+      ( ( off[i] & ((1<<(READSTORE_CHUNK_BITS-2))-1) ) << 2 );
+  }
+  uint8_t* allocate(size_t len, uint32_t& o);
+
+  readstore_st(const readstore_st&);
+  readstore_st& operator=(const readstore_st&);
+};
+
+#endif
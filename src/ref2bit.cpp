@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+using namespace std;
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "ref2bit.h"
+
+/*
+  file layout, all integers little endian, blocks 8-byte aligned
+
+  header   char magic[8], char stamp[40] (file_stamp of the fasta),
+           uint32 ncontig, uint32 0, uint64 directory offset
+  data     per contig: seq, nmask, gap
+  directory per contig: uint32 namelen, name padded to 8 bytes,
+           uint32 len, uint32 ngap, uint64 seq, nmask and gap offsets
+*/
+#define REF2BIT_HEADER 64
+#define REF2BIT_STAMP 40
+
+static const uint8_t base_to_2bit[256] = {
+  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,0,4,1,4,4,4,2,4,4,4,4,4,4,4,4, 4,4,4,4,3,4,4,4,4,4,4,4,4,4,4,4,
+  4,0,4,1,4,4,4,2,4,4,4,4,4,4,4,4, 4,4,4,4,3,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4
+};
+
+static size_t align8(size_t n) { return (n+7) & ~(size_t)7; }
+
+//! write n bytes and pad to 8 bytes, off returns where they start
+static bool write_block(FILE *fp, const void *p, size_t n, uint64_t& off)
+{
+  static const char zero[8]={0};
+  long o=ftell(fp);
+  if ( o<0 ) return false;
+  off=o;
+  if ( n>0 && fwrite(p, 1, n, fp)!=n ) return false;
+  size_t pad=align8(n)-n;
+  return pad==0 || fwrite(zero, 1, pad, fp)==pad;
+}
+
+bool ref2bit_build(const string& fastaFile)
+{
+  string stamp=file_stamp(fastaFile);
+  if ( stamp=="" || stamp.size()>=REF2BIT_STAMP ) return false;
+  
+  const vector<faientry_st>& fai=load_fai(fastaFile);
+  vector<string> names(0);
+  for(size_t i=0; i<fai.size(); ++i) names.push_back(fai[i].name);
+  
+  string fn=fastaFile+REF2BIT_SUFFIX;
+  ostringstream tmpfn;
+  tmpfn << fn << "." << getpid();
+  FILE *fp=fopen(tmpfn.str().c_str(), "wb");
+  if ( fp==NULL ) return false;
+  
+  char header[REF2BIT_HEADER];
+  memset(header, 0, REF2BIT_HEADER);
+  bool ok= fwrite(header, 1, REF2BIT_HEADER, fp)==REF2BIT_HEADER;
+  
+  vector<ref2bit_contig_st> dir(0);
+  vector<uint64_t> offs(0);
+  for(size_t c=0; c<names.size() && ok; ++c) {
+    refseq_st view;
+    if ( !view.load(fastaFile, names[c]) ) continue;
+    size_t len=view.size();
+    if ( len>0xffffffffUL ) { ok=false; break; }
+    
+    vector<uint8_t> seq( (len+3)/4+8, 0 ), nmask( (len+7)/8+8, 0 );
+    vector<uint32_t> gap(0);
+    for(size_t p=0; p<len; ) {
+      size_t n;
+      const char *s=view.chunk(p, n);
+      for(size_t k=0; k<n; ++k, ++p) {
+	uint8_t b=base_to_2bit[ (uint8_t)s[k] ];
+	if ( b<4 ) { seq[p>>2] |= b << ((p&3)<<1); continue; }
+	nmask[p>>3] |= 1 << (p&7);
+	if ( gap.size()>0 && gap.back()+1==p ) gap.back()=p;
+	else { gap.push_back(p); gap.push_back(p); }
+      }
+    }
+    
+    ref2bit_contig_st d;
+    d.name=names[c];
+    d.len=len;
+    d.ngap=gap.size()/2;
+    uint64_t o[3];
+    ok = write_block(fp, &seq[0], seq.size(), o[0]) &&
+      write_block(fp, &nmask[0], nmask.size(), o[1]) &&
+      write_block(fp, gap.size()>0 ? &gap[0] : NULL, gap.size()*4, o[2]);
+    dir.push_back(d);
+    offs.insert(offs.end(), o, o+3);
+  }
+  
+  uint64_t diroff=0;
+  long o=ftell(fp);
+  if ( o<0 ) ok=false;
+  diroff=o;
+  for(size_t c=0; c<dir.size() && ok; ++c) {
+    uint32_t namelen=dir[c].name.size();
+    uint32_t v[2]={ dir[c].len, dir[c].ngap };
+    uint64_t tmp;
+    ok = fwrite(&namelen, 4, 1, fp)==1 &&
+      write_block(fp, dir[c].name.c_str(), namelen, tmp) &&
+      fwrite(v, 4, 2, fp)==2 &&
+      fwrite(&offs[c*3], 8, 3, fp)==3;
+  }
+  
+  memcpy(header, REF2BIT_MAGIC, strlen(REF2BIT_MAGIC));
+  memcpy(header+8, stamp.c_str(), stamp.size());
+  uint32_t ncontig=dir.size();
+  memcpy(header+8+REF2BIT_STAMP, &ncontig, 4);
+  memcpy(header+8+REF2BIT_STAMP+8, &diroff, 8);
+  if ( ok ) ok = fseek(fp, 0, SEEK_SET)==0 && fwrite(header, 1, REF2BIT_HEADER, fp)==REF2BIT_HEADER;
+  if ( fclose(fp)!=0 ) ok=false;
+  
+  if ( ok ) ok = rename(tmpfn.str().c_str(), fn.c_str())==0;
+  if ( !ok ) remove(tmpfn.str().c_str());
+  return ok;
+}
+
+// the sidecar of one fasta file, mapped once and kept until exit
+static string r2b_fasta="";
+static const uint8_t *r2b_map=NULL;
+static size_t r2b_maplen=0;
+static map<string, ref2bit_contig_st> r2b_dir;
+
+// directories of the sidecars opened before, their mappings are never
+// unmapped so that contigs and views handed out stay valid
+static list<map<string, ref2bit_contig_st> > r2b_retired;
+
+//! map the sidecar and read its directory, false if it can not be used
+static bool ref2bit_open(const string& fastaFile)
+{
+  if ( r2b_map ) {
+    r2b_retired.push_back( map<string, ref2bit_contig_st>() );
+    r2b_retired.back().swap(r2b_dir);
+  }
+  r2b_map=NULL;
+  r2b_maplen=0;
+  r2b_dir.clear();
+  r2b_fasta=fastaFile;
+  
+  string stamp=file_stamp(fastaFile);
+  int fd=open( (fastaFile+REF2BIT_SUFFIX).c_str(), O_RDONLY );
+  if ( fd<0 ) return false;
+  off_t flen=lseek(fd, 0, SEEK_END);
+  if ( flen<REF2BIT_HEADER ) { close(fd); return false; }
+  void *m=mmap(NULL, flen, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( m==MAP_FAILED ) return false;
+  r2b_map=(const uint8_t*)m;
+  r2b_maplen=flen;
+  
+  const uint8_t *h=r2b_map;
+  char hstamp[REF2BIT_STAMP+1];
+  memcpy(hstamp, h+8, REF2BIT_STAMP);
+  hstamp[REF2BIT_STAMP]=0;
+  uint32_t ncontig;
+  uint64_t diroff;
+  memcpy(&ncontig, h+8+REF2BIT_STAMP, 4);
+  memcpy(&diroff, h+8+REF2BIT_STAMP+8, 8);
+  bool ok = memcmp(h, REF2BIT_MAGIC, strlen(REF2BIT_MAGIC))==0 && 
+    stamp==hstamp && diroff<=r2b_maplen;
+  
+  size_t o=diroff;
+  for(uint32_t c=0; c<ncontig && ok; ++c) {
+    uint32_t namelen, v[2];
+    uint64_t off[3];
+    if ( o+4>r2b_maplen ) { ok=false; break; }
+    memcpy(&namelen, r2b_map+o, 4);
+    o+=4;
+    if ( o+align8(namelen)+8+24>r2b_maplen ) { ok=false; break; }
+    ref2bit_contig_st d;
+    d.name.assign((const char*)r2b_map+o, namelen);
+    o+=align8(namelen);
+    memcpy(v, r2b_map+o, 8);
+    memcpy(off, r2b_map+o+8, 24);
+    o+=32;
+    d.len=v[0];
+    d.ngap=v[1];
+    if ( off[0]+(d.len+3)/4+8>r2b_maplen || off[1]+(d.len+7)/8+8>r2b_maplen ||
+	 off[2]+(uint64_t)d.ngap*8>r2b_maplen ) { ok=false; break; }
+    d.seq=r2b_map+off[0];
+    d.nmask=r2b_map+off[1];
+    d.gap=(const uint32_t*)(r2b_map+off[2]);
+    r2b_dir[d.name]=d;
+  }
+  
+  if ( !ok ) {
+    munmap((void*)r2b_map, r2b_maplen);
+    r2b_map=NULL;
+    r2b_maplen=0;
+    r2b_dir.clear();
+  }
+  return ok;
+}
+
+const ref2bit_contig_st* ref2bit_find(const string& fastaFile, const string& chr)
+{
+  if ( fastaFile!=r2b_fasta || r2b_map==NULL ) 
+    if ( !ref2bit_open(fastaFile) ) return NULL;
+  map<string, ref2bit_contig_st>::const_iterator it=r2b_dir.find(chr);
+  if ( it==r2b_dir.end() ) return NULL;
+  return &it->second;
+}
@@ -0,0 +1,43 @@
+#ifndef _REF2BIT_H
+#define _REF2BIT_H
+
+using namespace std;
+#include <string>
+#include <inttypes.h>
+
+//! packed reference sidecar, fastaFile+REF2BIT_SUFFIX
+#define REF2BIT_SUFFIX ".mc2bit"
+#define REF2BIT_MAGIC  "MC2BIT1"
+
+/*!
+  @abstract one contig of a packed reference, pointers are into the
+            read-only mapping of the sidecar and stay valid until exit
+
+  bases are folded to upper case and any base other than ACGT is N.
+  
+  @field  seq    2 bits per base, A=0 C=1 G=2 T=3, base i at bits 2*(i&3) 
+                 of byte i>>2, N is saved as A; 8 bytes of padding follow
+  @field  nmask  1 bit per base at bit i&7 of byte i>>3, set for N; 8 bytes 
+                 of padding follow
+  @field  gap    ngap pairs, 0-based first and last base of each N run
+*/
+struct ref2bit_contig_st {
+  string name;
+  uint32_t len;
+  uint32_t ngap;
+  const uint8_t *seq;
+  const uint8_t *nmask;
+  const uint32_t *gap;
+};
+
+//! pack every contig of fastaFile into fastaFile.mc2bit
+//! return false if the sidecar can not be written
+bool ref2bit_build(const string& fastaFile);
+
+//! contig chr of the packed sidecar of fastaFile
+//! NULL if the sidecar is missing, made from another version of fastaFile,
+//! or has no contig chr; the sidecar of another fastaFile, or one rebuilt,
+//! is mapped next to the earlier ones, whose contigs stay valid
+const ref2bit_contig_st* ref2bit_find(const string& fastaFile, const string& chr);
+
+#endif
@@ -0,0 +1,179 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <map>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "readstore.h"
+#include "pairset.h"
+#include "preprocess.h"
+#include "pairguide.h"
+
+#include "regioncache.h"
+
+static const char* regioncache_name[RC_NUM_KINDS] = {
+  "displacement", "readdepth", "readdepth100", "pairs"
+};
+
+static pthread_mutex_t rc_lock = PTHREAD_MUTEX_INITIALIZER;
+static map<regionkey_st, regionval_st> rc_map;
+static size_t rc_calls[RC_NUM_KINDS] = {0};
+static size_t rc_hits[RC_NUM_KINDS] = {0};
+static size_t rc_calls_total[RC_NUM_KINDS] = {0};
+static size_t rc_hits_total[RC_NUM_KINDS] = {0};
+
+//! look up key, return true and fill val on hit
+static bool regioncache_get(const regionkey_st& key, regionval_st& val)
+{
+  bool found=false;
+  pthread_mutex_lock(&rc_lock);
+  ++rc_calls[key.kind];
+  map<regionkey_st, regionval_st>::iterator it=rc_map.find(key);
+  if ( it!=rc_map.end() ) {
+    val=it->second;
+    ++rc_hits[key.kind];
+    found=true;
+  }
+  pthread_mutex_unlock(&rc_lock);
+  return found;
+}
+
+static void regioncache_put(const regionkey_st& key, const regionval_st& val)
+{
+  pthread_mutex_lock(&rc_lock);
+  rc_map[key]=val;
+  pthread_mutex_unlock(&rc_lock);
+}
+
+static regionkey_st regioncache_key(int kind, int tid, int F2, int R1,
+				    int a, int b)
+{
+  regionkey_st key;
+  key.kind=kind;
+  key.tid=tid;
+  key.F2=F2;
+  key.R1=R1;
+  key.a=a;
+  key.b=b;
+  return key;
+}
+
+void regioncache_clear()
+{
+  pthread_mutex_lock(&rc_lock);
+  rc_map.clear();
+  for(int k=0; k<RC_NUM_KINDS; ++k) {
+    rc_calls_total[k]+=rc_calls[k];
+    rc_hits_total[k]+=rc_hits[k];
+    rc_calls[k]=rc_hits[k]=0;
+  }
+  pthread_mutex_unlock(&rc_lock);
+}
+
+void regioncache_report(const string& region)
+{
+  pthread_mutex_lock(&rc_lock);
+  bool total=(region=="");
+  cerr << "region statistics cache\t" << (total ? "all regions" : region) << "\n";
+  for(int k=0; k<RC_NUM_KINDS; ++k) {
+    size_t calls= total ? rc_calls_total[k]+rc_calls[k] : rc_calls[k];
+    size_t hits= total ? rc_hits_total[k]+rc_hits[k] : rc_hits[k];
+    cerr << "  " << setw(14) << left << regioncache_name[k] << right
+	 << "calls " << setw(10) << commify(calls)
+	 << "  hits " << setw(10) << commify(hits)
+	 << "  rate " << fixed << setprecision(1)
+	 << ( calls>0 ? 100.0*hits/calls : 0.0 ) << "%\n";
+  }
+  cerr.unsetf(ios::fixed);
+  cerr << setprecision(6) << flush;
+  pthread_mutex_unlock(&rc_lock);
+}
+
+//! FASTA is the sequence of msc::bam_ref
+void cached_find_displacement(const refseq_st& FASTA, int F2, int R1,
+			      int& dx_F2, int& dx_R1)
+{
+  regionkey_st key=regioncache_key(RC_DISPLACEMENT, msc::bam_ref, F2, R1,
+				   (int)FASTA.size(), 0);
+  regionval_st val;
+  if ( regioncache_get(key, val) ) {
+    dx_F2=val.v[0];
+    dx_R1=val.v[1];
+    return;
+  }
+  find_displacement(FASTA, F2, R1, dx_F2, dx_R1);
+  val.v[0]=dx_F2;
+  val.v[1]=dx_R1;
+  val.v[2]=val.v[3]=0;
+  regioncache_put(key, val);
+}
+
+void cached_check_cnv_readdepth(int ref, int beg, int end, int dx,
+				int& d1, int& d2, int& din)
+{
+  regionkey_st key=regioncache_key(RC_READDEPTH, ref, beg, end, dx, 0);
+  regionval_st val;
+  if ( regioncache_get(key, val) ) {
+    d1=val.v[0];
+    d2=val.v[1];
+    din=val.v[2];
+    return;
+  }
+  check_cnv_readdepth(ref, beg, end, dx, d1, d2, din);
+  val.v[0]=d1;
+  val.v[1]=d2;
+  val.v[2]=din;
+  val.v[3]=0;
+  regioncache_put(key, val);
+}
+
+void cached_check_cnv_readdepth_100(int ref, int beg, int end,
+				    int& d1, int& din1, int& din2, int& d2)
+{
+  regionkey_st key=regioncache_key(RC_READDEPTH_100, ref, beg, end, 100, 0);
+  regionval_st val;
+  if ( regioncache_get(key, val) ) {
+    d1=val.v[0];
+    din1=val.v[1];
+    din2=val.v[2];
+    d2=val.v[3];
+    return;
+  }
+  check_cnv_readdepth_100(ref, beg, end, d1, din1, din2, d2);
+  val.v[0]=d1;
+  val.v[1]=din1;
+  val.v[2]=din2;
+  val.v[3]=d2;
+  regioncache_put(key, val);
+}
+
+//! the result depends on the insert size model, which is part of the key
+void cached_check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
+							int& p_F2, int& p_R1, int& p_F2R1)
+{
+  regionkey_st key=regioncache_key(RC_PAIRS, ref, F2, R1,
+				   msc::bam_pe_insert, msc::bam_pe_insert_sd);
+  regionval_st val;
+  if ( regioncache_get(key, val) ) {
+    p_F2=val.v[0];
+    p_R1=val.v[1];
+    p_F2R1=val.v[2];
+    return;
+  }
+  check_normal_and_abnormalpairs_cross_region(ref, F2, R1, p_F2, p_R1, p_F2R1);
+  val.v[0]=p_F2;
+  val.v[1]=p_R1;
+  val.v[2]=p_F2R1;
+  val.v[3]=0;
+  regioncache_put(key, val);
+}
@@ -0,0 +1,59 @@
+#ifndef _REGIONCACHE_H
+#define _REGIONCACHE_H
+
+//! memo cache for the region statistics used by stat_region and
+//! check_pair_group. the same (tid, F2, R1) is often evaluated several
+//! times within a region (before and after match_reads_for_pairs, with
+//! a different dx in pair-guided refinement, duplicated candidates in
+//! finalize_output), while the underlying data (msc::rd, FASTA, bam)
+//! do not change until the next region is loaded.
+
+enum regioncache_kind_t {
+  RC_DISPLACEMENT=0,
+  RC_READDEPTH,
+  RC_READDEPTH_100,
+  RC_PAIRS,
+  RC_NUM_KINDS
+};
+
+struct regionkey_st {
+  int kind;
+  int tid;
+  int F2;
+  int R1;
+  int a;  // dx for read depth, insert size for pairs
+  int b;  // insert size sd for pairs
+  bool operator<(const regionkey_st& o) const {
+    if ( kind!=o.kind ) return kind<o.kind;
+    if ( tid!=o.tid ) return tid<o.tid;
+    if ( F2!=o.F2 ) return F2<o.F2;
+    if ( R1!=o.R1 ) return R1<o.R1;
+    if ( a!=o.a ) return a<o.a;
+    return b<o.b;
+  }
+};
+
+struct regionval_st {
+  int v[4];
+};
+
+//! drop all cached results, must be called whenever msc::rd, FASTA or
+//! the bam region change
+void regioncache_clear();
+
+//! print calls and hit rates per statistic to cerr
+void regioncache_report(const string& region);
+
+void cached_find_displacement(const refseq_st& FASTA, int F2, int R1,
+			      int& dx_F2, int& dx_R1);
+
+void cached_check_cnv_readdepth(int ref, int beg, int end, int dx,
+				int& d1, int& d2, int& din);
+
+void cached_check_cnv_readdepth_100(int ref, int beg, int end,
+				    int& d1, int& din1, int& din2, int& d2);
+
+void cached_check_normal_and_abnormalpairs_cross_region(int ref, int F2, int R1,
+							int& p_F2, int& p_R1, int& p_F2R1);
+
+#endif
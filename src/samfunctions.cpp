@@ -520,7 +520,7 @@ void expand_pos(const bam1_t *b, vector<int>& e_pos)
 //! reference projected onto read, taking bases from expanded_pos
 //! CINS CPADS are taken from read
 //! CDEL CREF_SKIP CHARD_CLIPS are ignored
-string ref_projected_onto_qseq(const bam1_t *b, const string& FASTA)
+string ref_projected_onto_qseq(const bam1_t *b, const refseq_st& FASTA)
 {
   string e_ref="";
   
@@ -547,7 +547,7 @@ string ref_projected_onto_qseq(const bam1_t *b, const string& FASTA)
   return e_ref;
 }
 
-string qseq_projected_onto_ref(const bam1_t *b, const string& FASTA)
+string qseq_projected_onto_ref(const bam1_t *b, const refseq_st& FASTA)
 {
   string e_ref="";
   
@@ -592,7 +592,7 @@ string qseq_projected_onto_ref(const bam1_t *b, const string& FASTA)
   @return m.cop  reference position of operators, 1-based
   @return m.qop  position of operators on seq, 0-based
 */
-int calibrate_resolved_cigar_pos(string& FASTA, string& SEQ, POSCIGAR_st& m)
+int calibrate_resolved_cigar_pos(const refseq_st& FASTA, string& SEQ, POSCIGAR_st& m)
 {
   int nChanged=0;
   if ( m.op.size()<=1 ) return nChanged;
@@ -688,7 +688,7 @@ int calibrate_resolved_cigar_pos(string& FASTA, string& SEQ, POSCIGAR_st& m)
   return nChanged;
 }
 
-int calibrate_cigar_pos(const string& FASTA, bam1_t *b)
+int calibrate_cigar_pos(const refseq_st& FASTA, bam1_t *b)
 {
   int nChanged=0;
   if ( b->core.n_cigar<=0 || b->core.pos<0 ) return nChanged;
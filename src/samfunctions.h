@@ -7,6 +7,7 @@ using namespace std;
 #include <vector>
 #include <bam.h>
 #include <sam.h>
+#include "readref.h"
 
 #define POS_BAM_CINS -1
 #define POS_BAM_CPAD -2
@@ -74,10 +75,10 @@ void resolve_cigar_pos(const bam1_t *b,  POSCIGAR_st& m, int base);
 void resolve_cigar_pos(const bam1_t *b,  POSCIGAR_st& m);
 void resolve_cigar_pos(int POS, string& CIGAR, POSCIGAR_st& m);
 
-int calibrate_resolved_cigar_pos(string& FASTA, string& SEQ, POSCIGAR_st& m);
-int calibrate_resolved_cigar_pos(string& FASTA, const bam1_t *b, POSCIGAR_st& m);
+int calibrate_resolved_cigar_pos(const refseq_st& FASTA, string& SEQ, POSCIGAR_st& m);
+int calibrate_resolved_cigar_pos(const refseq_st& FASTA, const bam1_t *b, POSCIGAR_st& m);
 
-int calibrate_cigar_pos(const string& FASTA, bam1_t *b);
+int calibrate_cigar_pos(const refseq_st& FASTA, bam1_t *b);
 
 void get_cigar(const bam1_t *b,  string& cigar);  
 string get_cigar(const bam1_t *b);
@@ -94,7 +95,7 @@ void expand_cigar(const bam1_t *b, vector<int>& e_cigar );
 void expand_pos(const bam1_t *b, vector<int>& e_pos);
 void expand_pos(const POSCIGAR_st& m, vector<int>& e_pos);
 
-string ref_projected_onto_qseq(const bam1_t *b, const string& FASTA);
+string ref_projected_onto_qseq(const bam1_t *b, const refseq_st& FASTA);
 
 int get_pos_for_base(const POSCIGAR_st& m, int p);
 int get_pos_for_base(const bam1_t *b , int p);
@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "readref.h"
+#include "matchreads.h"
+#include "nregion.h"
+#include "shard.h"
+#include "writer.h"
+
+//! pseudo bin of the BAI holding the read counts of a target
+#define BAI_COUNT_BIN 37450
+#define BAI_LINEAR_SHIFT 14
+
+//! what the BAI tells about one target
+struct baitarget_st {
+  bool has_count;
+  uint64_t n_mapped;
+  vector<uint64_t> coff;  // compressed offset of each 16kb window
+  baitarget_st(): has_count(false), n_mapped(0) {};
+};
+
+//! read counts and linear index of the BAI, false if there is none
+static bool read_bai(const string& bamFile, vector<baitarget_st>& targets)
+{
+  targets.clear();
+  FILE *fp=fopen( (bamFile+".bai").c_str(), "rb" );
+  if ( fp==NULL && bamFile.size()>4 && bamFile.substr(bamFile.size()-4)==".bam" )
+    fp=fopen( (bamFile.substr(0, bamFile.size()-4)+".bai").c_str(), "rb" );
+  if ( fp==NULL ) return false;
+
+  char magic[4];
+  int32_t n_ref=0;
+  bool ok= fread(magic, 1, 4, fp)==4 && memcmp(magic, "BAI\1", 4)==0 &&
+    fread(&n_ref, 4, 1, fp)==1 && n_ref>=0;
+  if ( ok ) targets.resize(n_ref);
+  for(int t=0; ok && t<n_ref; ++t) {
+    int32_t n_bin=0;
+    ok= fread(&n_bin, 4, 1, fp)==1;
+    for(int k=0; ok && k<n_bin; ++k) {
+      uint32_t bin=0;
+      int32_t n_chunk=0;
+      ok= fread(&bin, 4, 1, fp)==1 && fread(&n_chunk, 4, 1, fp)==1;
+      if ( !ok ) break;
+      if ( bin==BAI_COUNT_BIN && n_chunk==2 ) {
+	uint64_t v[4];
+	ok= fread(v, 8, 4, fp)==4;
+	targets[t].has_count=true;
+	targets[t].n_mapped=v[2];
+      }
+      else ok= fseek(fp, 16L*n_chunk, SEEK_CUR)==0;
+    }
+    int32_t n_intv=0;
+    ok= ok && fread(&n_intv, 4, 1, fp)==1;
+    if ( !ok ) break;
+    targets[t].coff.resize(n_intv);
+    ok= fread(n_intv ? &targets[t].coff[0] : NULL, 8, n_intv, fp)==(size_t)n_intv;
+    // compressed offsets, made non decreasing over empty windows
+    uint64_t last=0;
+    for(int w=0; ok && w<n_intv; ++w) {
+      targets[t].coff[w]>>=16;
+      if ( targets[t].coff[w]<last ) targets[t].coff[w]=last;
+      last=targets[t].coff[w];
+    }
+  }
+  fclose(fp);
+  if ( !ok ) targets.clear();
+  return ok;
+}
+
+//! compressed bytes before pos
+static double bai_bytes(const baitarget_st& t, int pos)
+{
+  if ( t.coff.size()==0 ) return 0;
+  size_t w=(size_t)pos >> BAI_LINEAR_SHIFT;
+  if ( w>=t.coff.size() ) w=t.coff.size()-1;
+  return (double)t.coff[w];
+}
+
+bool parse_shard(const string& s, int& i, int& n)
+{
+  i=n=0;
+  size_t k=s.find('/');
+  if ( k==string::npos ) return false;
+  i=atoi(s.substr(0, k).c_str());
+  n=atoi(s.substr(k+1).c_str());
+  if ( s!=to_string(i)+"/"+to_string(n) ) return false;
+  return n>=1 && i>=1 && i<=n;
+}
+
+//! middle of each N gap of at least SHARD_MIN_GAP bases inside (beg, end)
+static void gap_cuts(const nregion_st& nr, int beg, int end, vector<int>& cuts)
+{
+  cuts.clear();
+  for(size_t k=nr.first_end_ge(beg+1); k<nr.size() && nr.end[k]<end-1; ++k) {
+    if ( nr.beg[k]<=beg || nr.end[k]-nr.beg[k]+1<SHARD_MIN_GAP ) continue;
+    cuts.push_back( nr.beg[k]+(nr.end[k]-nr.beg[k])/2 );
+  }
+  return;
+}
+
+static bool sort_unit_weight(const shardunit_st& a, const shardunit_st& b)
+{
+  if ( a.weight!=b.weight ) return a.weight>b.weight;
+  if ( a.region!=b.region ) return a.region<b.region;
+  return a.piece<b.piece;
+}
+
+static bool sort_unit_order(const shardunit_st& a, const shardunit_st& b)
+{
+  if ( a.region!=b.region ) return a.region<b.region;
+  return a.piece<b.piece;
+}
+
+void make_shard_units(int nshard, vector<shardunit_st>& units)
+{
+  units.clear();
+  vector<baitarget_st> bai(0);
+  bool has_bai= !msc::bamStream && read_bai(msc::bamFile, bai);
+  if ( !has_bai ) cerr << "no BAM index to weigh regions, region lengths are used" << endl;
+
+  // weight of each region
+  vector<shardunit_st> regions(0);
+  double total=0;
+  for(int r=0; r<(int)msc::bamRegion.size(); ++r) {
+    if ( msc::bamRegion[r]=="NA" ) continue;
+    shardunit_st u;
+    int ref=-1, beg=0, end=0x7fffffff;
+    if ( bam_parse_region(msc::fp_in->header, msc::bamRegion[r].c_str(), &ref, &beg, &end)<0 ||
+	 ref<0 || ref>=msc::fp_in->header->n_targets ) continue;
+    u.region=r;
+    u.tid=ref;
+    u.beg=beg;
+    u.end=min(end, (int)msc::fp_in->header->target_len[ref]);
+    u.query=msc::bamRegion[r];
+    u.weight=u.end-u.beg;
+    if ( has_bai && ref<(int)bai.size() ) {
+      const baitarget_st& t=bai[ref];
+      double bytes=bai_bytes(t, u.end)-bai_bytes(t, u.beg);
+      double all=bai_bytes(t, 0x7fffffff);
+      if ( t.has_count ) u.weight= all>0 ? t.n_mapped*bytes/all : 0;
+      else u.weight=bytes;
+      if ( u.weight<=0 ) u.weight=t.has_count ? t.n_mapped : 0;
+    }
+    total+=u.weight;
+    regions.push_back(u);
+  }
+
+  // cut regions heavier than a shard at equal weight
+  double share=total/nshard;
+  int margin=max(SHARD_MARGIN, msc::maxDistance);
+  for(size_t r=0; r<regions.size(); ++r) {
+    const shardunit_st& R=regions[r];
+    int k= share>0 ? (int)(R.weight/share+0.999999) : 1;
+    if ( k<=1 || R.end-R.beg < 2*margin ) {
+      units.push_back(R);
+      continue;
+    }
+    // no read maps in an N gap, cut elsewhere a call could be split
+    nregion_st nr;
+    if ( !load_N_regions(msc::refFile, msc::bam_target_name[R.tid], refseq_st(), nr) )
+      nr=nregion_st();
+    vector<int> gaps(0);
+    gap_cuts(nr, R.beg, R.end, gaps);
+    if ( gaps.empty() ) {
+      cerr << "no N gap to cut " << R.query << ", kept whole" << endl;
+      units.push_back(R);
+      continue;
+    }
+    vector<int> cut(1, R.beg);
+    const baitarget_st *t= has_bai && R.tid<(int)bai.size() ? &bai[R.tid] : NULL;
+    double b0= t ? bai_bytes(*t, R.beg) : 0;
+    double b1= t ? bai_bytes(*t, R.end) : 0;
+    for(int j=1; j<k; ++j) {
+      int pos=R.beg+(int)( (double)(R.end-R.beg)*j/k );
+      if ( b1>b0 ) {
+	// first window holding the j-th share of the bytes
+	double target=b0+(b1-b0)*j/k;
+	size_t w=(size_t)R.beg >> BAI_LINEAR_SHIFT;
+	while ( w<t->coff.size() && (double)t->coff[w]<target ) ++w;
+	pos=(int)(w << BAI_LINEAR_SHIFT);
+      }
+      // the gap nearest the equal weight position
+      vector<int>::iterator g=lower_bound(gaps.begin(), gaps.end(), pos);
+      if ( g==gaps.end() || ( g!=gaps.begin() && pos-*(g-1) < *g-pos ) ) --g;
+      if ( *g>cut.back() ) cut.push_back(*g);
+    }
+    cut.push_back(R.end);
+
+    int npiece=cut.size()-1;
+    for(int p=0; p<npiece; ++p) {
+      shardunit_st u=R;
+      u.piece=p;
+      u.npiece=npiece;
+      u.beg=cut[p];
+      u.end=cut[p+1];
+      u.weight=R.weight*(b1>b0 ?
+			 (bai_bytes(*t, u.end)-bai_bytes(*t, u.beg))/(b1-b0) :
+			 (double)(u.end-u.beg)/(R.end-R.beg));
+      int qbeg=max(R.beg, u.beg-margin);
+      int qend=min(R.end, u.end+margin);
+      if ( p>0 ) cerr << "cut\t" << msc::bam_target_name[u.tid] << ":" << u.beg+1 << endl;
+      u.query=msc::bam_target_name[u.tid]+":"+to_string(qbeg+1)+"-"+to_string(qend);
+      units.push_back(u);
+    }
+  }
+
+  // heaviest unit first, to the lightest shard
+  sort(units.begin(), units.end(), sort_unit_weight);
+  vector<double> load(nshard, 0);
+  for(size_t i=0; i<units.size(); ++i) {
+    int s=min_element(load.begin(), load.end())-load.begin();
+    units[i].shard=s+1;
+    load[s]+=units[i].weight;
+  }
+  sort(units.begin(), units.end(), sort_unit_order);
+
+  for(int s=0; s<nshard; ++s)
+    cerr << "shard " << s+1 << "/" << nshard << "\treads " << commify((long)load[s]) << endl;
+  return;
+}
+
+//! all fields of a call, in the order of pairinfo_st
+static string pairinfo_line(const pairinfo_st& b)
+{
+  ostringstream oss;
+  oss << b.tid << "\t" << b.F2 << "\t" << b.F2_rp << "\t" << b.F2_rd << "\t"
+      << b.F2_rd_100 << "\t" << b.F2_acurate << "\t" << b.R1 << "\t" << b.R1_rp << "\t"
+      << b.R1_rd << "\t" << b.R1_rd_100 << "\t" << b.R1_acurate << "\t" << b.un << "\t"
+      << b.MS_F2 << "\t" << b.MS_F2_rd << "\t" << b.MS_R1 << "\t" << b.MS_R1_rd << "\t"
+      << b.MS_ED << "\t" << b.MS_ED_count << "\t" << b.MS_S_count << "\t"
+      << b.F2_sr << "\t" << b.R1_sr << "\t" << b.sr_ed << "\t" << b.sr_count << "\t"
+      << b.rpscore << "\t" << b.rdscore << "\t" << b.ddscore << "\t" << b.srscore << "\t"
+      << b.FRrp << "\t" << b.rd << "\t" << b.rd_F2_100 << "\t" << b.rd_R1_100 << "\t"
+      << b.Q0 << "\t" << b.Q10;
+  return oss.str();
+}
+
+static bool pairinfo_parse(const string& line, pairinfo_st& b)
+{
+  istringstream iss(line);
+  iss >> b.tid >> b.F2 >> b.F2_rp >> b.F2_rd >> b.F2_rd_100 >> b.F2_acurate
+      >> b.R1 >> b.R1_rp >> b.R1_rd >> b.R1_rd_100 >> b.R1_acurate >> b.un
+      >> b.MS_F2 >> b.MS_F2_rd >> b.MS_R1 >> b.MS_R1_rd
+      >> b.MS_ED >> b.MS_ED_count >> b.MS_S_count
+      >> b.F2_sr >> b.R1_sr >> b.sr_ed >> b.sr_count
+      >> b.rpscore >> b.rdscore >> b.ddscore >> b.srscore
+      >> b.FRrp >> b.rd >> b.rd_F2_100 >> b.rd_R1_100
+      >> b.Q0 >> b.Q10;
+  return !iss.fail();
+}
+
+static vector<string> shard_files(0);
+
+//! create fn with its header on the first call
+static void open_shard_file(const string& fn, int ishard, int nshard, ofstream& FOUT)
+{
+  if ( find(shard_files.begin(), shard_files.end(), fn)!=shard_files.end() ) {
+    FOUT.open(fn.c_str(), std::ofstream::app);
+    return;
+  }
+  shard_files.push_back(fn);
+  FOUT.open(fn.c_str());
+  FOUT << SHARD_MAGIC << "\t" << ishard << "\t" << nshard << "\n"
+       << "##Command Line: " << msc::mycommand << "\n";
+  return;
+}
+
+void write_shard_unit(const string& fn, int ishard, int nshard,
+		      const shardunit_st& u, const vector<pairinfo_st>& bp)
+{
+  ofstream FOUT;
+  open_shard_file(fn, ishard, nshard, FOUT);
+  if ( !FOUT ) {
+    cerr << "cannot write " << fn << endl;
+    exit(0);
+  }
+  FOUT << "#unit\t" << u.region << "\t" << u.piece << "\t" << u.npiece << "\t"
+       << u.tid << "\t" << msc::bam_target_name[u.tid] << "\t"
+       << u.beg << "\t" << u.end << "\t"
+       << msc::bam_l_qseq << "\t" << msc::bam_is_paired << "\t"
+       << msc::bam_pe_insert << "\t" << msc::bam_pe_insert_sd << "\t"
+       << msc::minOverlap << "\t" << msc::minSNum << "\t" << bp.size() << "\n";
+  for(size_t i=0; i<bp.size(); ++i) FOUT << pairinfo_line(bp[i]) << "\n";
+  FOUT.close();
+  return;
+}
+
+void close_shard_file(const string& fn, int ishard, int nshard)
+{
+  ofstream FOUT;
+  open_shard_file(fn, ishard, nshard, FOUT);
+  FOUT << "##done\t" << ishard << "\t" << nshard << "\n";
+  FOUT.close();
+  if ( !FOUT ) {
+    cerr << "cannot write " << fn << endl;
+    exit(0);
+  }
+  return;
+}
+
+//! the units of one region of the original run
+struct shardregion_st {
+  string name;
+  int tid;
+  int l_qseq, insert, insert_sd, minOverlap, minSNum;
+  bool is_paired;
+  map<int, vector<pairinfo_st> > pieces;
+};
+
+static int usage_merge_shards(int argc, char* argv[])
+{
+  cerr << "Usage:\n"
+       << "  matchclips merge -o OUTFILE [-oz] [-vcf] SHARDFILE ...\n"
+       << "\n"
+       << "  SHARDFILEs are the -o files of all shards of a --shard i/N run.\n"
+       << "  OUTFILE and OUTFILE.weak are written as by a single run, -oz and\n"
+       << "  -vcf as for matchclips.\n"
+       << endl;
+  return 0;
+}
+
+void merge_shards(int argc, char* argv[])
+{
+  msc::mycommand=argv[0];
+  for(int i=1; i<argc; ++i) msc::mycommand+=" "+string(argv[i]);
+
+  string outFile="STDOUT";
+  vector<string> files(0);
+  for(int i=1; i<argc; ++i) {
+    string arg=argv[i];
+    if ( arg=="-o" && i+1<argc ) { outFile=argv[++i]; continue; }
+    if ( arg=="-oz" ) { msc::outCompress=true; continue; }
+    if ( arg=="-vcf" ) { msc::outVcf=true; continue; }
+    if ( arg[0]=='-' ) {
+      cerr << "unknown argument:\t" << arg << endl;
+      exit( usage_merge_shards(argc, argv) );
+    }
+    files.push_back(arg);
+  }
+  if ( files.size()==0 ) exit( usage_merge_shards(argc, argv) );
+  if ( (msc::outCompress || msc::outVcf) && outFile=="STDOUT" ) {
+    cerr << "Need -o for -oz and -vcf" << endl;
+    exit( usage_merge_shards(argc, argv) );
+  }
+  msc::outFile=outFile;
+
+  // read all shards, each of 1..N exactly once and complete
+  int nshard=-1;
+  vector<int> seen(0);
+  map<int, shardregion_st> regions;
+  for(size_t f=0; f<files.size(); ++f) {
+    ifstream FIN(files[f].c_str());
+    if ( !FIN ) {
+      cerr << files[f] << " not found!" << endl;
+      exit(0);
+    }
+    string line, tag;
+    int ishard=0, n=0;
+    getline(FIN, line);
+    if ( line.find(SHARD_MAGIC)!=0 ||
+	 !(istringstream(line.substr(strlen(SHARD_MAGIC))) >> ishard >> n) ) {
+      cerr << files[f] << " is not a shard file" << endl;
+      exit(0);
+    }
+    if ( nshard<0 ) { nshard=n; seen.assign(n+1, 0); }
+    if ( n!=nshard || ishard<1 || ishard>n || seen[ishard] ) {
+      cerr << files[f] << " is shard " << ishard << "/" << n
+	   << ", which does not fit the other files" << endl;
+      exit(0);
+    }
+    seen[ishard]=1;
+
+    bool done=false;
+    vector<pairinfo_st> *calls=NULL;
+    while ( getline(FIN, line) ) {
+      if ( line.find("##done")==0 ) { done=true; break; }
+      if ( line.find("##")==0 ) continue;
+      if ( line.find("#unit\t")==0 ) {
+	istringstream iss(line.substr(6));
+	int r, piece, npiece;
+	size_t ncall;
+	shardregion_st u;
+	iss >> r >> piece >> npiece >> u.tid >> u.name >> tag >> tag
+	    >> u.l_qseq >> u.is_paired >> u.insert >> u.insert_sd
+	    >> u.minOverlap >> u.minSNum >> ncall;
+	if ( iss.fail() ) break;
+	if ( regions.count(r)==0 ) regions[r]=u;
+	calls=&regions[r].pieces[piece];
+	calls->reserve(ncall);
+	continue;
+      }
+      pairinfo_st b;
+      if ( calls==NULL || !pairinfo_parse(line, b) ) break;
+      calls->push_back(b);
+    }
+    if ( !done ) {
+      cerr << files[f] << " is incomplete" << endl;
+      exit(0);
+    }
+  }
+  for(int i=1; i<=nshard; ++i)
+    if ( !seen[i] ) {
+      cerr << "shard " << i << "/" << nshard << " is missing" << endl;
+      exit(0);
+    }
+
+  // finalize each region of the original run as it would have been
+  for(map<int, shardregion_st>::iterator it=regions.begin(); it!=regions.end(); ++it) {
+    shardregion_st& R=it->second;
+    if ( R.tid>=(int)msc::bam_target_name.size() ) msc::bam_target_name.resize(R.tid+1);
+    msc::bam_target_name[R.tid]=R.name;
+    msc::bam_ref=R.tid;
+    msc::bam_l_qseq=R.l_qseq;
+    msc::bam_is_paired=R.is_paired;
+    msc::bam_pe_insert=R.insert;
+    msc::bam_pe_insert_sd=R.insert_sd;
+    msc::minOverlap=R.minOverlap;
+    msc::minSNum=R.minSNum;
+
+    vector<pairinfo_st> bp(0);
+    for(map<int, vector<pairinfo_st> >::iterator p=R.pieces.begin(); p!=R.pieces.end(); ++p)
+      bp.insert(bp.end(), p->second.begin(), p->second.end());
+    // pieces are sorted, keep their order among equal breakpoints
+    if ( R.pieces.size()>1 ) stable_sort(bp.begin(), bp.end(), sort_pair_info);
+
+    vector<pairinfo_st> strong, weak;
+    finalize_output(bp, strong, weak);
+    sort(strong.begin(), strong.end(), sort_pair_info_output);
+    sort(weak.begin(), weak.end(), sort_pair_info_output);
+    write_cnv_to_file(strong, outFile);
+    write_cnv_to_file(weak, string(outFile+".weak"));
+  }
+  close_cnv_files();
+  cerr << "merged " << nshard << " shards, " << regions.size() << " regions" << endl;
+  return;
+}
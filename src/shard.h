@@ -0,0 +1,80 @@
+#ifndef _SHARD_H
+#define _SHARD_H
+
+using namespace std;
+#include <string>
+#include <vector>
+
+//! pieces of a split region are read at least this far into their
+//! neighbours, the default -L, and as far as a longer -L
+#define SHARD_MARGIN 1000000
+//! regions are only cut in the middle of N gaps this long or longer
+#define SHARD_MIN_GAP 10000
+//! shard files start with this line, followed by "i N"
+#define SHARD_MAGIC "##matchclips shard"
+
+/*!
+  @abstract one unit of work of --shard i/N
+
+  a region heavier than 1/N of the genome is cut into pieces of about
+  equal read counts, only in the middle of N gaps of SHARD_MIN_GAP bases
+  or more; a region without one is kept whole. no read maps in the gap,
+  so no soft clipped read or read depth is split by the cut, and each
+  piece is read max(SHARD_MARGIN, -L) into its neighbours for pairs
+  across the gap. calls belong to the piece that contains their left
+  end, [beg, end).
+
+  @field  region  index of the region in msc::bamRegion
+  @field  piece   index of the piece within the region
+  @field  npiece  number of pieces of the region
+  @field  beg     first base owned, 0 based
+  @field  end     one past the last base owned
+  @field  weight  reads, estimated from the BAM index
+  @field  shard   shard processing the unit, 1 based
+  @field  query   region string given to the main loop
+*/
+struct shardunit_st {
+  int region;
+  int piece;
+  int npiece;
+  int tid;
+  int beg;
+  int end;
+  double weight;
+  int shard;
+  string query;
+  shardunit_st(): region(-1), piece(0), npiece(1), tid(-1), beg(0), end(0),
+		  weight(0), shard(0), query("") {};
+};
+
+//! "i/N" with 1<=i<=N
+bool parse_shard(const string& s, int& i, int& n);
+
+/*!
+  @abstract  cut msc::bamRegion into units and assign them to nshard shards
+
+  weights come from the read counts and the linear index of the BAI, the
+  heaviest unit goes to the lightest shard first. regions marked "NA"
+  are skipped. the assignment only depends on the BAM index, every shard
+  of a run computes the same one.
+*/
+void make_shard_units(int nshard, vector<shardunit_st>& units);
+
+/*!
+  @abstract  append the calls of one unit to the shard file fn
+
+  bp are the calls of the unit as given to finalize_output(), sorted and
+  with N regions removed, restricted to those owned by the unit. the
+  model of the region is saved with them so merge can redo
+  finalize_output() without the BAM.
+*/
+void write_shard_unit(const string& fn, int ishard, int nshard,
+		      const shardunit_st& u, const vector<pairinfo_st>& bp);
+
+//! mark the shard file complete
+void close_shard_file(const string& fn, int ishard, int nshard);
+
+//! matchclips merge -o OUT SHARDFILE...
+void merge_shards(int argc, char* argv[]);
+
+#endif
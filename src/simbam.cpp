@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "readref.h"
+
+#include "mcbench.h"
+#include "simbam.h"
+
+//! a piece of the donor contig copied from reference [rbeg, rend)
+struct simseg_st {
+  int rbeg;
+  int rend;
+  int dbeg;
+};
+
+//! splitmix64, errors of a read are drawn from its id so that they do
+//! not depend on the order the reads are written
+static inline uint64_t sim_hash(uint64_t x)
+{
+  x+=0x9e3779b97f4a7c15ULL;
+  x=(x^(x>>30))*0xbf58476d1ce4e5b9ULL;
+  x=(x^(x>>27))*0x94d049bb133111ebULL;
+  return x^(x>>31);
+}
+
+static bool sort_simsv(const simsv_st& a, const simsv_st& b)
+{
+  if ( a.tid!=b.tid ) return a.tid<b.tid;
+  return a.beg<b.beg;
+}
+
+static bool sort_simread(const simread_st& a, const simread_st& b)
+{
+  if ( a.pos!=b.pos ) return a.pos<b.pos;
+  if ( a.id!=b.id ) return a.id<b.id;
+  return a.flag<b.flag;
+}
+
+//! random contig of ACGT with a run of N at a third of its length
+static void random_contig(int len, string& seq)
+{
+  seq.resize(len);
+  for(int i=0; i<len; ++i) seq[i]="ACGT"[ (int)(unifrand()*4) & 3 ];
+  int ngap= len>=1000000 ? 10000 : 0;
+  for(int i=len/3; i<len/3+ngap; ++i) seq[i]='N';
+  return;
+}
+
+//! write seqs as fn and its .fai, 60 bases per line
+static void write_fasta(const string& fn, const vector<string>& names,
+			const vector<string>& seqs)
+{
+  ofstream FOUT(fn.c_str());
+  ofstream FAI( (fn+".fai").c_str() );
+  if ( !FOUT || !FAI ) {
+    cerr << "cannot write " << fn << endl;
+    exit(0);
+  }
+  long offset=0;
+  for(size_t t=0; t<names.size(); ++t) {
+    offset+=names[t].size()+2;
+    FAI << names[t] << "\t" << seqs[t].size() << "\t" << offset << "\t60\t61\n";
+    FOUT << ">" << names[t] << "\n";
+    for(size_t i=0; i<seqs[t].size(); i+=60) {
+      size_t n=min((size_t)60, seqs[t].size()-i);
+      FOUT.write(seqs[t].data()+i, n);
+      FOUT << "\n";
+      offset+=n+1;
+    }
+  }
+  FOUT.close();
+  FAI.close();
+  return;
+}
+
+/*!
+  @abstract  place ndel deletions and ndup duplications on contig tid
+
+  lengths are log uniform in [minlen, maxlen]. variations are kept apart
+  by margin bases from each other, from the contig ends and from N.
+*/
+static void place_svs(int tid, const string& seq, int ndel, int ndup,
+		      int minlen, int maxlen, int margin, vector<simsv_st>& svs)
+{
+  vector<simsv_st> placed(0);
+  int len=seq.size();
+  for(int k=0; k<ndel+ndup; ++k) {
+    for(int attempt=0; attempt<1000; ++attempt) {
+      int l=(int)exp( log((double)minlen) + unifrand()*( log((double)maxlen)-log((double)minlen) ) );
+      if ( len-2*margin-l <= 0 ) continue;
+      simsv_st sv;
+      sv.tid=tid;
+      sv.beg=margin+(int)( unifrand()*(len-2*margin-l) );
+      sv.end=sv.beg+l;
+      sv.type= k<ndel ? "DEL" : "DUP";
+      bool ok=true;
+      for(size_t j=0; j<placed.size() && ok; ++j)
+	ok = sv.end+margin<placed[j].beg || placed[j].end+margin<sv.beg;
+      for(int p=max(0, sv.beg-margin); p<min(len, sv.end+margin) && ok; ++p)
+	ok = seq[p]!='N';
+      if ( !ok ) continue;
+      placed.push_back(sv);
+      break;
+    }
+  }
+  sort(placed.begin(), placed.end(), sort_simsv);
+  svs.insert(svs.end(), placed.begin(), placed.end());
+  return;
+}
+
+//! the donor contig with the variations of svs applied, svs are sorted
+static void make_donor(const string& ref, const vector<simsv_st>& svs,
+		       string& donor, vector<simseg_st>& segs)
+{
+  donor.clear();
+  segs.clear();
+  int cur=0;
+  for(size_t i=0; i<=svs.size(); ++i) {
+    simseg_st s;
+    s.rbeg=cur;
+    s.rend= i<svs.size() ? ( svs[i].type=="DEL" ? svs[i].beg : svs[i].end ) : (int)ref.size();
+    s.dbeg=donor.size();
+    donor.append(ref, s.rbeg, s.rend-s.rbeg);
+    segs.push_back(s);
+    if ( i<svs.size() ) cur= svs[i].type=="DEL" ? svs[i].end : svs[i].beg;
+  }
+  return;
+}
+
+//! align donor [a, b) to the reference piece it overlaps most, the rest
+//! of the read is soft clipped as an aligner would do
+static void map_read(const vector<simseg_st>& segs, int a, int b, simread_st& r)
+{
+  int best=-1;
+  for(size_t i=0; i<segs.size(); ++i) {
+    int lo=max(a, segs[i].dbeg);
+    int hi=min(b, segs[i].dbeg+segs[i].rend-segs[i].rbeg);
+    if ( hi-lo<=best ) continue;
+    best=hi-lo;
+    r.qs=lo-a;
+    r.ln=hi-lo;
+    r.pos=segs[i].rbeg+lo-segs[i].dbeg;
+  }
+  r.dstart=a;
+  return;
+}
+
+//! fill b with read r of length l, bases are taken from donor
+static void make_bam1(bam1_t *b, int tid, const simread_st& r, const string& donor,
+		      int l, double err)
+{
+  char qname[32];
+  snprintf(qname, sizeof(qname), "r%u", r.id);
+  uint32_t cigar[3];
+  int nc=0;
+  if ( r.qs>0 ) cigar[nc++]=r.qs<<BAM_CIGAR_SHIFT | BAM_CSOFT_CLIP;
+  cigar[nc++]=r.ln<<BAM_CIGAR_SHIFT | BAM_CMATCH;
+  if ( r.qs+r.ln<l ) cigar[nc++]=(l-r.qs-r.ln)<<BAM_CIGAR_SHIFT | BAM_CSOFT_CLIP;
+
+  bam1_core_t *c=&b->core;
+  c->tid=tid;
+  c->pos=r.pos;
+  c->qual=60;
+  c->l_qname=strlen(qname)+1;
+  c->flag=r.flag;
+  c->n_cigar=nc;
+  c->l_qseq=l;
+  c->mtid=tid;
+  c->mpos=r.mpos;
+  c->isize=r.tlen;
+  c->bin=bam_reg2bin(r.pos, bam_calend(c, cigar));
+
+  b->l_aux=7;
+  b->data_len=c->l_qname+nc*4+(l+1)/2+l+b->l_aux;
+  if ( b->m_data<b->data_len ) {
+    b->m_data=b->data_len;
+    kroundup32(b->m_data);
+    b->data=(uint8_t*)realloc(b->data, b->m_data);
+  }
+  uint8_t *p=b->data;
+  memcpy(p, qname, c->l_qname); p+=c->l_qname;
+  memcpy(p, cigar, nc*4); p+=nc*4;
+  memset(p, 0, (l+1)/2);
+  uint64_t h=sim_hash( ((uint64_t)r.id<<1) | bool(r.flag & BAM_FREAD2) );
+  for(int i=0; i<l; ++i) {
+    char base=donor[r.dstart+i];
+    h=sim_hash(h);
+    if ( (h>>11)*(1.0/9007199254740992.0) < err ) {
+      // one of the three other bases
+      const char *p3=strchr("ACGTACG", base);
+      if ( p3 ) base=p3[1+(h&0xff)%3];
+    }
+    p[i>>1] |= bam_nt16_table[(int)base] << ((~i&1)<<2);
+  }
+  p+=(l+1)/2;
+  memset(p, 30, l); p+=l;
+  memcpy(p, "RGZrg1", 7);
+  return;
+}
+
+int usage_bench_simbam(int argc, char* argv[]) {
+  cerr << "This subroutine writes a coordinate sorted, indexed BAM of paired\n"
+       << "reads with known deletions and tandem duplications, aligned the way\n"
+       << "an aligner would: reads across a break point are soft clipped.\n"
+       << "The reference is simulated, or taken from -f.\n"
+       << "\nUsage:\n"
+       << "  " << argv[0] << " " << argv[1] << " <options>\n"
+       << "\nOptions:\n"
+       << "  -o  STR  output prefix, default sim, writes STR.bam, STR.bam.bai,\n"
+       << "           STR.truth.txt and, without -f, STR.fa and STR.fa.fai\n"
+       << "  -f  STR  reference FASTA with a .fai, default a simulated one\n"
+       << "  -n  INT  contigs of the simulated reference, default 2\n"
+       << "  -L  INT  length of the simulated contigs, default 5000000\n"
+       << "  -c  INT  coverage, default 30\n"
+       << "  -l  INT  read length, default 100\n"
+       << "  -i  INT  insert size, default 400\n"
+       << "  -s  INT  s.d. of insert size, default 40\n"
+       << "  -d  INT  deletions per contig, default 20\n"
+       << "  -u  INT  duplications per contig, default 10\n"
+       << "  -m  INT  minimum variation length, default 50\n"
+       << "  -M  INT  maximum variation length, default 10000\n"
+       << "  -e  FLT  base error rate, default 0.002\n"
+       << "  -S  INT  random seed, default 137\n"
+       << "\nExamples:\n"
+       << "  " << argv[0] <<  " " << argv[1] << " -c 50 -o sim50\n"
+       << "  " << argv[0] <<  " " << argv[1] << " -f hg19.fasta -n 1 -o hg19sim\n"
+       << endl;
+
+  return(0);
+}
+
+int bench_simbam(int argc, char* argv[])
+{
+  string prefix="sim", fastaFile="";
+  int ncontig=2, contiglen=5000000, cov=30, l=100, ins=400, sd=40;
+  int ndel=20, ndup=10, minlen=50, maxlen=10000;
+  double err=0.002;
+  long seed=msc::seed;
+
+  for(int i=2; i<argc; ++i) {
+    string a=argv[i];
+    if ( i+1>=argc ) exit( usage_bench_simbam(argc, argv) );
+    if ( a=="-o" ) prefix=argv[++i];
+    else if ( a=="-f" ) fastaFile=argv[++i];
+    else if ( a=="-n" ) ncontig=atoi(argv[++i]);
+    else if ( a=="-L" ) contiglen=atoi(argv[++i]);
+    else if ( a=="-c" ) cov=atoi(argv[++i]);
+    else if ( a=="-l" ) l=atoi(argv[++i]);
+    else if ( a=="-i" ) ins=atoi(argv[++i]);
+    else if ( a=="-s" ) sd=atoi(argv[++i]);
+    else if ( a=="-d" ) ndel=atoi(argv[++i]);
+    else if ( a=="-u" ) ndup=atoi(argv[++i]);
+    else if ( a=="-m" ) minlen=atoi(argv[++i]);
+    else if ( a=="-M" ) maxlen=atoi(argv[++i]);
+    else if ( a=="-e" ) err=atof(argv[++i]);
+    else if ( a=="-S" ) seed=atol(argv[++i]);
+    else exit( usage_bench_simbam(argc, argv) );
+  }
+  if ( ncontig<1 || cov<1 || l<30 || l>1000 || ins<l+10 || sd<0 ||
+       minlen<1 || maxlen<minlen ) exit( usage_bench_simbam(argc, argv) );
+  srand(seed);
+
+  // reference, the contigs of -f are used in the order of the .fai
+  vector<string> names(0), seqs(0);
+  if ( fastaFile!="" ) {
+    const vector<faientry_st>& fai=load_fai(fastaFile);
+    for(size_t t=0; t<fai.size() && (int)t<ncontig; ++t) {
+      refseq_st r;
+      if ( !r.load(fastaFile, fai[t].name) ) {
+	cerr << fai[t].name << " not found in " << fastaFile << endl;
+	exit(0);
+      }
+      names.push_back(fai[t].name);
+      seqs.push_back( r.substr(0) );
+      string& s=seqs.back();
+      for(size_t i=0; i<s.size(); ++i) s[i]=toupper(s[i]);
+    }
+  }
+  else {
+    fastaFile=prefix+".fa";
+    for(int t=0; t<ncontig; ++t) {
+      names.push_back("sim"+to_string(t+1));
+      seqs.push_back("");
+      random_contig(contiglen, seqs.back());
+    }
+    write_fasta(fastaFile, names, seqs);
+  }
+  if ( names.empty() ) {
+    cerr << "no contig in " << fastaFile << endl;
+    exit(0);
+  }
+
+  // variations, kept away from each other so that each has its own pairs
+  int margin=ins+6*sd+2*l;
+  vector<simsv_st> svs(0);
+  for(size_t t=0; t<names.size(); ++t)
+    place_svs(t, seqs[t], ndel, ndup, minlen, maxlen, margin, svs);
+
+  bam_header_t *h=bam_header_init();
+  h->n_targets=names.size();
+  h->target_name=(char**)calloc(names.size(), sizeof(char*));
+  h->target_len=(uint32_t*)calloc(names.size(), sizeof(uint32_t));
+  string text="@HD\tVN:1.0\tSO:coordinate\n";
+  for(size_t t=0; t<names.size(); ++t) {
+    h->target_name[t]=strdup(names[t].c_str());
+    h->target_len[t]=seqs[t].size();
+    text+="@SQ\tSN:"+names[t]+"\tLN:"+to_string(seqs[t].size())+"\n";
+  }
+  text+="@RG\tID:rg1\tSM:sim\n";
+  h->l_text=text.size();
+  h->text=strdup(text.c_str());
+
+  string bamFile=prefix+".bam";
+  samfile_t *fp=samopen(bamFile.c_str(), "wb", h);
+  if ( !fp ) {
+    cerr << "cannot write " << bamFile << endl;
+    exit(0);
+  }
+
+  // one contig at a time: pairs are drawn from the donor, mapped back to
+  // the reference and sorted by position before they are written
+  bam1_t *b=bam_init1();
+  size_t nread=0;
+  uint32_t id=0;
+  for(size_t t=0; t<names.size(); ++t) {
+    vector<simsv_st> tsv(0);
+    for(size_t i=0; i<svs.size(); ++i) if ( svs[i].tid==(int)t ) tsv.push_back(svs[i]);
+    string donor;
+    vector<simseg_st> segs;
+    make_donor(seqs[t], tsv, donor, segs);
+
+    size_t npairs=(size_t)( (double)donor.size()*cov/(2.0*l) );
+    vector<simread_st> reads(0);
+    reads.reserve(npairs*2);
+    for(size_t k=0; k<npairs; ++k) {
+      int isize=(int)( ins+sd*ran_normal()+0.5 );
+      if ( isize<l+10 || isize>=(int)donor.size() ) continue;
+      int st=(int)( unifrand()*(donor.size()-isize) );
+      if ( memchr(donor.data()+st, 'N', l) ||
+	   memchr(donor.data()+st+isize-l, 'N', l) ) continue;
+      ++id;
+      simread_st r1, r2;
+      map_read(segs, st, st+l, r1);
+      map_read(segs, st+isize-l, st+isize, r2);
+      int left=min(r1.pos, r2.pos);
+      int right=max(r1.pos+r1.ln, r2.pos+r2.ln);
+      int tlen=right-left;
+      bool proper= r1.pos<=r2.pos && abs(tlen-ins)<6*sd;
+      r1.id=r2.id=id;
+      r1.flag=BAM_FPAIRED | BAM_FREAD1 | BAM_FMREVERSE | ( proper ? BAM_FPROPER_PAIR : 0 );
+      r2.flag=BAM_FPAIRED | BAM_FREAD2 | BAM_FREVERSE | ( proper ? BAM_FPROPER_PAIR : 0 );
+      r1.mpos=r2.pos;
+      r2.mpos=r1.pos;
+      r1.tlen= r1.pos<=r2.pos ? tlen : -tlen;
+      r2.tlen=-r1.tlen;
+      reads.push_back(r1);
+      reads.push_back(r2);
+    }
+    sort(reads.begin(), reads.end(), sort_simread);
+    for(size_t i=0; i<reads.size(); ++i) {
+      make_bam1(b, t, reads[i], donor, l, err);
+      samwrite(fp, b);
+    }
+    nread+=reads.size();
+    cerr << names[t] << "\t" << commify(seqs[t].size()) << " bases\t"
+	 << tsv.size() << " variations\t" << commify(reads.size()) << " reads" << endl;
+  }
+  bam_destroy1(b);
+  samclose(fp);
+  bam_header_destroy(h);
+  bam_index_build(bamFile.c_str());
+
+  // truth in the coordinates of the output, 1 based: the bases around a
+  // deletion and the first and last base of a duplication
+  string truthFile=prefix+".truth.txt";
+  ofstream FOUT(truthFile.c_str());
+  FOUT << "#reference\t" << fastaFile << "\n"
+       << "#reads\t" << nread << "\n";
+  for(size_t i=0; i<svs.size(); ++i) {
+    bool del= svs[i].type=="DEL";
+    FOUT << names[svs[i].tid] << "\t" 
+	 << ( del ? svs[i].beg : svs[i].beg+1 ) << "\t" 
+	 << ( del ? svs[i].end+1 : svs[i].end ) << "\t"
+	 << svs[i].type << "\t" << svs[i].end-svs[i].beg << "\n";
+  }
+  FOUT.close();
+
+  cerr << "written " << bamFile << " with " << commify(nread) << " reads and "
+       << truthFile << " with " << svs.size() << " variations" << endl;
+  return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef _SIMBAM_H
+#define _SIMBAM_H
+
+using namespace std;
+#include <string>
+#include <vector>
+
+/*!
+  @abstract a simulated structure variation
+
+  @field  type  "DEL" or "DUP", a DUP is a tandem copy of [beg, end)
+  @field  beg   first base of the variation, 0 based
+  @field  end   one past the last base
+*/
+struct simsv_st {
+  int tid;
+  int beg;
+  int end;
+  string type;
+};
+
+/*!
+  @abstract one simulated read, the sequence is made again when written
+
+  @field  pos     0-based position of the first M base
+  @field  dstart  first base of the read on the donor contig
+  @field  qs      bases soft clipped before the M part
+  @field  ln      length of the M part, the rest is soft clipped after it
+*/
+struct simread_st {
+  int32_t pos;
+  int32_t mpos;
+  int32_t tlen;
+  int32_t dstart;
+  uint32_t id;
+  uint16_t flag;
+  uint16_t qs;
+  uint16_t ln;
+};
+
+int bench_simbam(int argc, char* argv[]);
+
+#endif
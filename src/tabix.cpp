@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bgzf.h>
+
+/**** user headers ****/
+#include "tabix.h"
+
+#define TABIX_LINEAR_SHIFT 14
+#define TABIX_MAX_POS (1<<29)
+
+typedef pair<uint64_t, uint64_t> chunk_t;
+
+//! bins and linear index of one sequence
+struct tabixref_st {
+  map<uint32_t, vector<chunk_t> > bins;
+  vector<uint64_t> ioff;
+};
+
+//! smallest bin holding [beg, end), as bam_reg2bin()
+static inline uint32_t reg2bin(uint32_t beg, uint32_t end)
+{
+  --end;
+  if ( beg>>14 == end>>14 ) return 4681 + (beg>>14);
+  if ( beg>>17 == end>>17 ) return  585 + (beg>>17);
+  if ( beg>>20 == end>>20 ) return   73 + (beg>>20);
+  if ( beg>>23 == end>>23 ) return    9 + (beg>>23);
+  if ( beg>>26 == end>>26 ) return    1 + (beg>>26);
+  return 0;
+}
+
+//! all bins that may hold records overlapping [beg, end)
+static void reg2bins(uint32_t beg, uint32_t end, vector<uint32_t>& list)
+{
+  list.clear();
+  --end;
+  list.push_back(0);
+  for(uint32_t k=   1 + (beg>>26); k<=   1 + (end>>26); ++k) list.push_back(k);
+  for(uint32_t k=   9 + (beg>>23); k<=   9 + (end>>23); ++k) list.push_back(k);
+  for(uint32_t k=  73 + (beg>>20); k<=  73 + (end>>20); ++k) list.push_back(k);
+  for(uint32_t k= 585 + (beg>>17); k<= 585 + (end>>17); ++k) list.push_back(k);
+  for(uint32_t k=4681 + (beg>>14); k<=4681 + (end>>14); ++k) list.push_back(k);
+  return;
+}
+
+bool sort_tabixline(const tabixline_st& a, const tabixline_st& b)
+{
+  if ( a.tid!=b.tid ) return a.tid<b.tid;
+  if ( a.beg!=b.beg ) return a.beg<b.beg;
+  return a.end<b.end;
+}
+
+static inline void put32(BGZF *fp, int32_t v) { bgzf_write(fp, &v, 4); }
+
+static inline bool get32(BGZF *fp, int32_t& v) { return bgzf_read(fp, &v, 4)==4; }
+
+void write_bgzf_tabix(const string& fn, const string& header,
+		      const vector<string>& names, vector<tabixline_st>& lines,
+		      int preset)
+{
+  stable_sort(lines.begin(), lines.end(), sort_tabixline);
+
+  BGZF *fp=bgzf_open(fn.c_str(), "w");
+  if ( fp==NULL ) {
+    cerr << "cannot write " << fn << endl;
+    exit(0);
+  }
+  bgzf_write(fp, header.data(), header.size());
+
+  // sequences in the order they appear in the file
+  vector<string> seqs(0);
+  vector<tabixref_st> refs(0);
+  int last_tid=-1;
+  for(size_t i=0; i<lines.size(); ++i) {
+    const tabixline_st& L=lines[i];
+    if ( L.tid!=last_tid ) {
+      last_tid=L.tid;
+      seqs.push_back( L.tid>=0 && L.tid<(int)names.size() ? names[L.tid] : "chr" );
+      refs.push_back(tabixref_st());
+    }
+    uint32_t beg=max(L.beg, 0);
+    uint32_t end=min(max(L.end, L.beg+1), TABIX_MAX_POS);
+    if ( beg>=end ) beg=end-1;
+
+    uint64_t off0=bgzf_tell(fp);
+    bgzf_write(fp, L.line.data(), L.line.size());
+    bgzf_write(fp, "\n", 1);
+    uint64_t off1=bgzf_tell(fp);
+
+    tabixref_st& R=refs.back();
+    vector<chunk_t>& chunks=R.bins[ reg2bin(beg, end) ];
+    if ( !chunks.empty() && chunks.back().second==off0 ) chunks.back().second=off1;
+    else chunks.push_back( chunk_t(off0, off1) );
+
+    uint32_t w0=beg >> TABIX_LINEAR_SHIFT;
+    uint32_t w1=(end-1) >> TABIX_LINEAR_SHIFT;
+    if ( w1>=R.ioff.size() ) R.ioff.resize(w1+1, 0);
+    for(uint32_t w=w0; w<=w1; ++w) if ( R.ioff[w]==0 ) R.ioff[w]=off0;
+  }
+  if ( bgzf_close(fp)!=0 ) {
+    cerr << "failed to write " << fn << endl;
+    exit(0);
+  }
+
+  string idxfn=fn+".tbi";
+  fp=bgzf_open(idxfn.c_str(), "w");
+  if ( fp==NULL ) {
+    cerr << "cannot write " << idxfn << endl;
+    exit(0);
+  }
+  bgzf_write(fp, "TBI\1", 4);
+  put32(fp, seqs.size());
+  put32(fp, preset);
+  put32(fp, 1);                             // sequence column
+  put32(fp, 2);                             // begin column
+  put32(fp, preset==TABIX_VCF ? 0 : 3);     // end column
+  put32(fp, '#');
+  put32(fp, 0);
+  string nm="";
+  for(size_t i=0; i<seqs.size(); ++i) nm+=seqs[i]+'\0';
+  put32(fp, nm.size());
+  bgzf_write(fp, nm.data(), nm.size());
+  for(size_t r=0; r<refs.size(); ++r) {
+    tabixref_st& R=refs[r];
+    put32(fp, R.bins.size());
+    for(map<uint32_t, vector<chunk_t> >::iterator it=R.bins.begin(); it!=R.bins.end(); ++it) {
+      put32(fp, it->first);
+      put32(fp, it->second.size());
+      for(size_t k=0; k<it->second.size(); ++k) {
+	bgzf_write(fp, &it->second[k].first, 8);
+	bgzf_write(fp, &it->second[k].second, 8);
+      }
+    }
+    // windows nothing overlaps point to the last one before them
+    for(size_t w=1; w<R.ioff.size(); ++w) if ( R.ioff[w]==0 ) R.ioff[w]=R.ioff[w-1];
+    put32(fp, R.ioff.size());
+    if ( R.ioff.size() ) bgzf_write(fp, &R.ioff[0], 8*R.ioff.size());
+  }
+  if ( bgzf_close(fp)!=0 ) {
+    cerr << "failed to write " << idxfn << endl;
+    exit(0);
+  }
+  return;
+}
+
+//! the index of sequence name in fn.tbi
+static bool load_tabix(const string& fn, const string& name, int32_t *conf,
+		       tabixref_st& R, bool& found)
+{
+  found=false;
+  // bgzf_open() reports a missing file, plain text has no index
+  if ( access((fn+".tbi").c_str(), R_OK)!=0 ) return false;
+  BGZF *fp=bgzf_open((fn+".tbi").c_str(), "r");
+  if ( fp==NULL ) return false;
+
+  char magic[4];
+  int32_t n_ref=0, l_nm=0;
+  bool ok= bgzf_read(fp, magic, 4)==4 && memcmp(magic, "TBI\1", 4)==0 && get32(fp, n_ref);
+  for(int k=0; ok && k<6; ++k) ok=get32(fp, conf[k]);
+  ok= ok && get32(fp, l_nm) && l_nm>=0;
+  vector<char> nm(l_nm+1, '\0');
+  ok= ok && bgzf_read(fp, &nm[0], l_nm)==l_nm;
+  int target=-1, t=0;
+  for(int32_t k=0; ok && k<l_nm; k+=strlen(&nm[k])+1, ++t)
+    if ( name==&nm[k] ) target=t;
+
+  for(int r=0; ok && r<n_ref && r<=target; ++r) {
+    int32_t n_bin=0, n_intv=0;
+    ok=get32(fp, n_bin);
+    for(int b=0; ok && b<n_bin; ++b) {
+      int32_t bin=0, n_chunk=0;
+      ok= get32(fp, bin) && get32(fp, n_chunk) && n_chunk>=0;
+      if ( !ok ) break;
+      vector<chunk_t> chunks(n_chunk);
+      for(int c=0; ok && c<n_chunk; ++c)
+	ok= bgzf_read(fp, &chunks[c].first, 8)==8 && bgzf_read(fp, &chunks[c].second, 8)==8;
+      if ( r==target ) R.bins[bin]=chunks;
+    }
+    ok= ok && get32(fp, n_intv) && n_intv>=0;
+    if ( !ok ) break;
+    vector<uint64_t> ioff(n_intv);
+    ok= bgzf_read(fp, n_intv ? &ioff[0] : NULL, 8*n_intv)==8*n_intv;
+    if ( r==target ) R.ioff=ioff;
+  }
+  bgzf_close(fp);
+  if ( !ok ) {
+    cerr << fn << ".tbi is not a tabix index" << endl;
+    exit(0);
+  }
+  found= target>=0;
+  return true;
+}
+
+//! the interval of a line, by the columns of the index
+static bool line_interval(const string& line, const int32_t *conf,
+			  string& seq, int& beg, int& end)
+{
+  int preset=conf[0] & 0xffff;
+  vector<string> col(0);
+  size_t p=0;
+  for(;;) {
+    size_t q=line.find('\t', p);
+    col.push_back( line.substr(p, q==string::npos ? string::npos : q-p) );
+    if ( q==string::npos ) break;
+    p=q+1;
+  }
+  int sc=conf[1], bc=conf[2], ec=conf[3];
+  if ( sc<1 || bc<1 || (int)col.size()<max(sc, bc) ) return false;
+  seq=col[sc-1];
+  beg=atoi(col[bc-1].c_str())-1;
+  end=beg+1;
+  if ( preset==TABIX_VCF ) {
+    if ( col.size()>3 ) end=beg+col[3].size();
+    if ( col.size()>7 ) {
+      size_t k= col[7].find("END=")==0 ? 0 : col[7].find(";END=");
+      if ( k!=string::npos ) end=atoi(col[7].c_str()+k+(k==0 ? 4 : 5));
+    }
+  }
+  else if ( ec>0 && ec<=(int)col.size() ) end=atoi(col[ec-1].c_str());
+  if ( end<=beg ) end=beg+1;
+  return true;
+}
+
+bool tabix_query(const string& fn, const string& name, int beg, int end,
+		 vector<string>& lines)
+{
+  lines.clear();
+  int32_t conf[6];
+  tabixref_st R;
+  bool found=false;
+  if ( !load_tabix(fn, name, conf, R, found) ) return false;
+  if ( !found ) return true;
+
+  beg=max(beg, 0);
+  end=min(max(end, beg+1), TABIX_MAX_POS);
+  uint64_t min_off=0;
+  if ( R.ioff.size() ) {
+    size_t w=(size_t)beg >> TABIX_LINEAR_SHIFT;
+    min_off= R.ioff[ min(w, R.ioff.size()-1) ];
+  }
+
+  vector<uint32_t> bins;
+  reg2bins(beg, end, bins);
+  vector<chunk_t> chunks(0);
+  for(size_t i=0; i<bins.size(); ++i) {
+    map<uint32_t, vector<chunk_t> >::iterator it=R.bins.find(bins[i]);
+    if ( it==R.bins.end() ) continue;
+    for(size_t k=0; k<it->second.size(); ++k)
+      if ( it->second[k].second>min_off ) chunks.push_back(it->second[k]);
+  }
+  sort(chunks.begin(), chunks.end());
+  size_t n=0;
+  for(size_t i=0; i<chunks.size(); ++i) {
+    if ( n>0 && chunks[i].first<=chunks[n-1].second )
+      chunks[n-1].second=max(chunks[n-1].second, chunks[i].second);
+    else chunks[n++]=chunks[i];
+  }
+  chunks.resize(n);
+
+  BGZF *fp=bgzf_open(fn.c_str(), "r");
+  if ( fp==NULL ) {
+    cerr << fn << " not found" << endl;
+    exit(0);
+  }
+  kstring_t str={0, 0, NULL};
+  for(size_t i=0; i<chunks.size(); ++i) {
+    if ( bgzf_seek(fp, chunks[i].first, SEEK_SET)<0 ) break;
+    while ( (uint64_t)bgzf_tell(fp)<chunks[i].second && bgzf_getline(fp, '\n', &str)>=0 ) {
+      string line(str.s, str.l);
+      string seq;
+      int b, e;
+      if ( line.size()==0 || line[0]==(char)conf[4] ) continue;
+      if ( !line_interval(line, conf, seq, b, e) || seq!=name ) continue;
+      if ( b>=end || e<=beg ) continue;
+      lines.push_back(line);
+    }
+  }
+  free(str.s);
+  bgzf_close(fp);
+  return true;
+}
+
+struct textfile_st {
+  BGZF *bgzf;
+  ifstream *fin;
+  kstring_t str;
+};
+
+textfile_t text_open(const string& fn)
+{
+  textfile_t fp=new textfile_st;
+  fp->bgzf=NULL;
+  fp->fin=NULL;
+  fp->str.l=fp->str.m=0;
+  fp->str.s=NULL;
+  if ( bgzf_is_bgzf(fn.c_str()) ) fp->bgzf=bgzf_open(fn.c_str(), "r");
+  else {
+    fp->fin=new ifstream(fn.c_str());
+    if ( !*fp->fin ) {
+      delete fp->fin;
+      fp->fin=NULL;
+    }
+  }
+  if ( fp->bgzf==NULL && fp->fin==NULL ) {
+    delete fp;
+    return NULL;
+  }
+  return fp;
+}
+
+bool text_getline(textfile_t fp, string& line)
+{
+  if ( fp==NULL ) return false;
+  if ( fp->fin ) return (bool)getline(*fp->fin, line);
+  if ( bgzf_getline(fp->bgzf, '\n', &fp->str)<0 ) return false;
+  line.assign(fp->str.s, fp->str.l);
+  return true;
+}
+
+void text_close(textfile_t fp)
+{
+  if ( fp==NULL ) return;
+  if ( fp->bgzf ) bgzf_close(fp->bgzf);
+  delete fp->fin;
+  free(fp->str.s);
+  delete fp;
+  return;
+}
@@ -0,0 +1,63 @@
+#ifndef _TABIX_H
+#define _TABIX_H
+
+using namespace std;
+#include <string>
+#include <vector>
+
+//! tabix presets, as the format field of a .tbi
+#define TABIX_GENERIC 0
+#define TABIX_VCF 2
+
+/*!
+  @abstract one line of a position sorted, indexed file
+
+  @field  tid   index of the sequence in the names given to the writer
+  @field  beg   first base, 0 based
+  @field  end   one past the last base
+  @field  line  the text, without the newline
+*/
+struct tabixline_st {
+  int tid;
+  int beg;
+  int end;
+  string line;
+};
+
+//! by tid, beg and end
+bool sort_tabixline(const tabixline_st& a, const tabixline_st& b);
+
+/*!
+  @abstract  write lines to the BGZF file fn and its tabix index fn.tbi
+
+  header is written first as is, its lines must start with '#'. lines
+  are sorted by tid, beg and end. TABIX_GENERIC files hold the sequence,
+  begin and end in columns 1, 2 and 3, 1 based and closed, TABIX_VCF
+  files are VCF with END in INFO. the index can be read by tabix.
+*/
+void write_bgzf_tabix(const string& fn, const string& header,
+		      const vector<string>& names, vector<tabixline_st>& lines,
+		      int preset);
+
+/*!
+  @abstract  lines of the indexed BGZF file fn overlapping name:[beg, end)
+
+  @return    false if fn has no tabix index
+*/
+bool tabix_query(const string& fn, const string& name, int beg, int end,
+		 vector<string>& lines);
+
+//! a plain text or BGZF file read one line at a time
+struct textfile_st;
+typedef textfile_st* textfile_t;
+
+//! NULL if fn can not be opened
+textfile_t text_open(const string& fn);
+
+//! the next line of fp without the newline, false at the end
+bool text_getline(textfile_t fp, string& line);
+
+//! close fp, NULL is ignored
+void text_close(textfile_t fp);
+
+#endif
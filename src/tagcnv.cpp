@@ -15,7 +15,9 @@ using namespace std;
 /**** user headers ****/
 #include "functions.h"
 #include "readref.h"
+#include "nregion.h"
 #include "samfunctions.h"
+#include "insertsize.h"
 #include "tagcnv.h"
 
 int chrom2int(string RNAME)
@@ -90,14 +92,15 @@ int check_noseq_regions(int argc, char* argv[])
   
   bool NOSEQ=false;
   string mycommand="";
-  size_t i, k;
+  size_t i;
   string QNAME,FLAG,RNAME,POS,MAPQ,CIGAR,MRNM,MPOS,ISIZE,SEQ,QUAL,OPT;
   int POS1,POS2;
   string POS1S,POS2S;
   string CIGAR1,SEQ1,QUAL1,OPT1;
   
   string cnvFile="",fastaFile="",outputFile="STDOUT";
-  string FASTA="",fastaname="";
+  string fastaname="";
+  nregion_st nr;
   vector<string> inputArgv;
   
   for(i=0;i<(size_t) argc;++i) inputArgv.push_back(string(argv[i]));
@@ -169,22 +172,19 @@ int check_noseq_regions(int argc, char* argv[])
     }
     
     if ( RNAME != fastaname ) {
-      string RNAMEtmp=RNAME;
-      read_fasta(fastaFile,RNAMEtmp,FASTA);
+      if ( !load_N_regions(fastaFile, RNAME, refseq_st(), nr) ) nr=nregion_st();
       fastaname=RNAME;
       cerr << fastaFile << "\t"
 	   << fastaname << "\t"
-	   << FASTA.size() << endl;
+	   << nr.len << endl;
     }
     NOSEQ=false;
     size_t p1=POS1;
     size_t p2=POS2;
     if ( p1>p2 ) swap(p1,p2); 
     if (p1==0) p1=1;
-    if ( p1>=FASTA.length() || p2>=FASTA.length() ) NOSEQ=true;
-    else {
-      for(k=p1-1;k<p2;++k) if ( FASTA[k]=='N' ) { NOSEQ=true; break; }
-    }
+    if ( p1>=(size_t)nr.len || p2>=(size_t)nr.len ) NOSEQ=true;
+    else NOSEQ=nr.has_N(p1-1, p2-1);
     
     cout << tmps << "\t" << FILTER[ NOSEQ ] << endl; 
   }
@@ -788,8 +788,7 @@ int check_het(int argc, char* argv[])
   ifstream FIN(cnvFile.c_str());
   if ( !FIN ) { cerr << "Can't open file " << outputFile << endl; exit(0); }
   
-  vector<int> vbeg(0);
-  vector<int> vend(0);
+  nregion_st nr;
   string region="";
   i=0;
   while ( !FIN.eof() ) {
@@ -963,25 +962,20 @@ int check_het(int argc, char* argv[])
     if ( RNAME != fastaname ) {
       string RNAMEtmp=RNAME;
       if ( ci_find(RNAME,"chr") != string::npos ) RNAMEtmp=RNAME.substr(3); 
-      read_fasta(fastaFile,RNAMEtmp,FASTA);
-      get_N_regions(FASTA, vbeg, vend);
+      if ( !load_N_regions(fastaFile, RNAMEtmp, refseq_st(), nr) ) nr=nregion_st();
       
       fastaname=RNAME;
       cerr << fastaFile << "\t"
 	   << fastaname << "\t"
-	   << FASTA.size() << endl;
+	   << nr.len << endl;
       
       cerr << "N regions:\n";
-      for(int k=0;k<(int)vbeg.size();++k)
-	cerr << fastaname << "\t" << vbeg[k] << "\t" << vend[k] << endl;
+      for(int k=0;k<(int)nr.size();++k)
+	cerr << fastaname << "\t" << nr.beg[k] << "\t" << nr.end[k] << endl;
     }
     bool NOSEQ=false;
-    if ( POS1>=(int)FASTA.length() || POS2>=(int)FASTA.length() ) NOSEQ=true;
-    else {
-      //for(int k=POS1;k<=POS2;++k) if ( FASTA[k]=='N' ) { NOSEQ=true; break; }
-      for(int k=0;k<(int)vbeg.size();++k) 
-	if ( POS1<=(vend[k]+1) && POS2>=(vbeg[k]+1) ) { NOSEQ=true; break; }
-    }
+    if ( POS1>=nr.len || POS2>=nr.len ) NOSEQ=true;
+    else NOSEQ=nr.has_N(POS1-1, POS2-1);
     
     string tagN= NOSEQ ? "N":"P";
     
@@ -2310,6 +2304,7 @@ int usage_check_pairs(int argc, char* argv[]) {
        << "  " << argv[0] << " " << argv[1] << " <options> -b BAMFILE -v CNVFILE \n"
        << "\nOptions:\n"
        << "  -d  INT  check reads INT before and after a CNV, INT=1000 \n"
+       << "  -d  auto insert+3*sd of the widest library, see matchclips\n"
        << "  -o  STR  outputfile, STR=STDOUT \n"
        << "   *       all other options are passed to samtools \n" 
        << "\nExamples :\n"
@@ -2330,6 +2325,7 @@ int check_pairs(int argc, char* argv[])
   int FLAG,POS,MAPQ,MPOS,ISIZE;
   char TYPE;
   int POS1,POS2,UN,DIS=1000;
+  bool DISauto=false;
   string POS1S,POS2S;
   string CIGAR1,SEQ1,QUAL1,OPT1;
   
@@ -2354,6 +2350,7 @@ int check_pairs(int argc, char* argv[])
       continue;
     }
     if ( inputArgv[i]=="-d" ) {  // input bam file
+      DISauto = inputArgv[i+1]=="auto";
       DIS=atoi(inputArgv[i+1].c_str());
       inputArgv[i]="";
       inputArgv[i+1]="";
@@ -2374,6 +2371,19 @@ int check_pairs(int argc, char* argv[])
   if ( ! file_exist(bamFile) ) { cerr << bamFile << " not found\n"; exit(0); }
   if ( ! file_exist(cnvFile) ) { cerr << cnvFile << " not found\n"; exit(0); }
   
+  // same models as matchclips, minimum mapq 10 and read from the sidecar
+  if ( DISauto ) {
+    vector<insertmodel_st> models;
+    if ( !load_insert_models(bamFile, NULL, NULL, 10, 1, models) ) {
+      cerr << "insert size of " << bamFile << " can not be estimated" << endl;
+      exit(0);
+    }
+    const insertmodel_st& m=widest_insert_model(models, 3);
+    DIS= m.n>0 ? m.upper(3) : 1000;
+    cerr << "#Insert    : " << m.insert << " += " << m.insert_sd 
+	 << " read group " << m.rg << ", -d " << DIS << endl;
+  }
+  
   cerr << "#CommandL  : " << mycommand << "\n"
        << "#CNV file  : " << cnvFile << "\n"
        << "#BAM file  : " << bamFile << "\n"
@@ -0,0 +1,119 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "metrics.h"
+#include "trace.h"
+
+struct traceevent_st {
+  const char *name;
+  const char *cat;
+  double t0;
+  double t1;
+  string detail;
+};
+
+bool trace_enabled=false;
+
+static string trace_file="";
+static double trace_t0=0;
+static vector<traceevent_st> lanes[TRACE_LANES];
+static __thread int my_lane=TRACE_LANE_MAIN;
+
+void trace_open(const string& fn)
+{
+  trace_file=fn;
+  trace_t0=wall_time();
+  trace_enabled=true;
+  return;
+}
+
+void trace_lane(int lane)
+{
+  my_lane= lane>=0 && lane<TRACE_LANES ? lane : TRACE_LANE_MAIN;
+  return;
+}
+
+void trace_span(const char *name, const char *cat, double t0, double t1,
+		const string& detail)
+{
+  if ( !trace_enabled ) return;
+  traceevent_st e;
+  e.name=name;
+  e.cat=cat;
+  e.t0=t0;
+  e.t1=t1;
+  e.detail=detail;
+  lanes[my_lane].push_back(e);
+  return;
+}
+
+void trace_lock(pthread_mutex_t *m, const char *name)
+{
+  if ( !trace_enabled ) {
+    pthread_mutex_lock(m);
+    return;
+  }
+  double t0=wall_time();
+  pthread_mutex_lock(m);
+  double t1=wall_time();
+  if ( t1-t0>=TRACE_MIN_WAIT ) trace_span(name, "lock", t0, t1);
+  return;
+}
+
+static string lane_name(int lane)
+{
+  if ( lane==TRACE_LANE_MAIN ) return "main";
+  if ( lane==TRACE_LANE_PREFETCH ) return "prefetch";
+  if ( lane==TRACE_LANE_WRITER ) return "writer";
+  return "matching "+to_string(lane-1);
+}
+
+void trace_close()
+{
+  if ( !trace_enabled ) return;
+  trace_enabled=false;
+
+  ofstream FOUT(trace_file.c_str());
+  if ( !FOUT ) {
+    cerr << "cannot write " << trace_file << endl;
+    return;
+  }
+  FOUT.setf(ios::fixed);
+  FOUT.precision(1);
+  FOUT << "{\"traceEvents\":[\n";
+  FOUT << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":"
+       << json_string(msc::mycommand) << "}}";
+  size_t n=0;
+  for(int l=0; l<TRACE_LANES; ++l) {
+    if ( lanes[l].empty() ) continue;
+    FOUT << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << l
+	 << ",\"args\":{\"name\":\"" << lane_name(l) << "\"}}";
+    for(size_t i=0; i<lanes[l].size(); ++i) {
+      const traceevent_st& e=lanes[l][i];
+      FOUT << ",\n{\"name\":" << json_string(e.name) << ",\"cat\":\"" << e.cat
+	   << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << l
+	   << ",\"ts\":" << (e.t0-trace_t0)*1e6 << ",\"dur\":" << (e.t1-e.t0)*1e6;
+      if ( e.detail!="" ) FOUT << ",\"args\":{\"detail\":" << json_string(e.detail) << "}";
+      FOUT << "}";
+    }
+    n+=lanes[l].size();
+    vector<traceevent_st>().swap(lanes[l]);
+  }
+  FOUT << "\n]}\n";
+  FOUT.close();
+  cerr << "trace of " << n << " spans written to " << trace_file << endl;
+  return;
+}
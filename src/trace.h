@@ -0,0 +1,54 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+using namespace std;
+#include <pthread.h>
+#include <string>
+#include "functions.h"
+
+//! lanes of the timeline: main thread, matching threads 1..MAX_THREADS,
+//! then the prefetch and the writer threads
+#define TRACE_LANE_MAIN 0
+#define TRACE_LANE_PREFETCH (MAX_THREADS+1)
+#define TRACE_LANE_WRITER (MAX_THREADS+2)
+#define TRACE_LANES (MAX_THREADS+3)
+//! lock waits shorter than this are not recorded, in seconds
+#define TRACE_MIN_WAIT 1e-5
+
+extern bool trace_enabled;
+
+inline bool trace_on() { return trace_enabled; }
+
+//! start recording, the timeline is written to fn by trace_close()
+void trace_open(const string& fn);
+
+//! spans of the calling thread go to lane, until it is set again
+void trace_lane(int lane);
+
+/*!
+  @abstract  record a span of the calling thread from t0 to t1
+
+  times are from wall_time(). each lane has its own buffer, used by one
+  thread at a time, so recording takes no lock.
+*/
+void trace_span(const char *name, const char *cat, double t0, double t1,
+		const string& detail="");
+
+//! pthread_mutex_lock(), recording the wait if it is long
+void trace_lock(pthread_mutex_t *m, const char *name);
+
+//! write all lanes as Chrome trace events, once all threads are joined
+void trace_close();
+
+//! a span from construction to the end of the scope
+struct tracespan_st {
+  const char *name;
+  const char *cat;
+  string detail;
+  double t0;
+  tracespan_st(const char *n, const char *c, const string& d=""):
+    name(n), cat(c), detail(d), t0( trace_on() ? wall_time() : 0 ) {};
+  ~tracespan_st() { if ( trace_on() ) trace_span(name, cat, t0, wall_time(), detail); }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unistd.h>
+using namespace std;
+
+/**** samtools headers ****/
+#include <bam.h>
+#include <sam.h>
+
+/**** user headers ****/
+#include "functions.h"
+#include "matchreads.h"
+#include "writer.h"
+#include "trace.h"
+
+//! fp and name are copied from the stream while w_lock is held, the
+//! writer thread does not read w_files or w_names unlocked
+struct writejob_st {
+  int stream;
+  FILE *fp;
+  string name;
+  string *buf;
+};
+
+//! everything below is guarded by w_lock
+static pthread_mutex_t w_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t w_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t w_free = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t w_idle = PTHREAD_COND_INITIALIZER;
+static vector<string> w_names(0);
+static vector<FILE*> w_files(0);
+static vector<string> w_reopen(0);
+static bool w_writing=false;
+static deque<writejob_st> w_jobs;
+static vector<string*> w_pool(0);
+static bool w_running=false;
+static bool w_stop=false;
+static pthread_t w_thread;
+
+static void* writer_thread(void *arg)
+{
+  trace_lane(TRACE_LANE_WRITER);
+  pthread_mutex_lock(&w_lock);
+  for(;;) {
+    while ( w_jobs.empty() && !w_stop ) pthread_cond_wait(&w_queued, &w_lock);
+    if ( w_jobs.empty() ) break;
+    writejob_st job=w_jobs.front();
+    w_jobs.pop_front();
+    w_writing=true;
+    pthread_mutex_unlock(&w_lock);
+
+    double t0=wall_time();
+    if ( fwrite(job.buf->data(), 1, job.buf->size(), job.fp)!=job.buf->size() )
+      cerr << "failed to write " << job.name << endl;
+    if ( trace_on() ) trace_span("write", "io", t0, wall_time(), job.name);
+    job.buf->clear();
+
+    pthread_mutex_lock(&w_lock);
+    w_writing=false;
+    w_pool.push_back(job.buf);
+    pthread_cond_signal(&w_free);
+    if ( w_jobs.empty() ) pthread_cond_broadcast(&w_idle);
+  }
+  pthread_mutex_unlock(&w_lock);
+  pthread_exit((void*) 0);
+}
+
+//! called with w_lock held
+static void writer_start()
+{
+  for(int i=0; i<WRITER_BUFFERS; ++i) {
+    w_pool.push_back(new string);
+    w_pool.back()->reserve(WRITER_BUFFER_SIZE);
+  }
+  w_stop=false;
+  int rc=pthread_create(&w_thread, NULL, writer_thread, NULL);
+  if ( rc ) {
+    cerr << "ERROR; return code from pthread_create() is " << rc << endl;
+    exit(-1);
+  }
+  w_running=true;
+  atexit(writer_close);
+  return;
+}
+
+int writer_stream(const string& fn, const string& header)
+{
+  pthread_mutex_lock(&w_lock);
+  int id=-1;
+  for(size_t i=0; i<w_names.size(); ++i) if ( w_names[i]==fn ) id=i;
+  if ( id<0 ) {
+    bool append=false;
+    for(size_t i=0; i<w_reopen.size(); ++i) if ( w_reopen[i]==fn ) append=true;
+    FILE *fp= fn=="STDOUT" ? stdout : fopen(fn.c_str(), append ? "a" : "w");
+    if ( fp==NULL ) {
+      cerr << "cannot write " << fn << endl;
+      exit(0);
+    }
+    if ( !w_running ) writer_start();
+    id=w_names.size();
+    w_names.push_back(fn);
+    w_files.push_back(fp);
+    if ( append ) fseek(fp, 0, SEEK_END);
+    else fputs(header.c_str(), fp);
+  }
+  pthread_mutex_unlock(&w_lock);
+  return id;
+}
+
+string* writer_buffer()
+{
+  pthread_mutex_lock(&w_lock);
+  while ( w_pool.empty() ) pthread_cond_wait(&w_free, &w_lock);
+  string *buf=w_pool.back();
+  w_pool.pop_back();
+  pthread_mutex_unlock(&w_lock);
+  return buf;
+}
+
+void writer_push(int stream, string* buf)
+{
+  writejob_st job;
+  job.stream=stream;
+  job.buf=buf;
+  pthread_mutex_lock(&w_lock);
+  job.fp=w_files[stream];
+  job.name=w_names[stream];
+  w_jobs.push_back(job);
+  pthread_cond_signal(&w_queued);
+  pthread_mutex_unlock(&w_lock);
+  return;
+}
+
+void writer_reopen(const string& fn)
+{
+  pthread_mutex_lock(&w_lock);
+  w_reopen.push_back(fn);
+  pthread_mutex_unlock(&w_lock);
+  return;
+}
+
+void writer_sync()
+{
+  pthread_mutex_lock(&w_lock);
+  while ( !w_jobs.empty() || w_writing ) pthread_cond_wait(&w_idle, &w_lock);
+  for(size_t i=0; i<w_files.size(); ++i) {
+    if ( fflush(w_files[i])!=0 ) cerr << "failed to write " << w_names[i] << endl;
+    if ( w_files[i]!=stdout ) fsync(fileno(w_files[i]));
+  }
+  pthread_mutex_unlock(&w_lock);
+  return;
+}
+
+long writer_tell(const string& fn)
+{
+  long p=-1;
+  pthread_mutex_lock(&w_lock);
+  for(size_t i=0; i<w_names.size(); ++i) 
+    if ( w_names[i]==fn && w_files[i]!=stdout ) p=ftell(w_files[i]);
+  pthread_mutex_unlock(&w_lock);
+  return p;
+}
+
+void writer_close()
+{
+  pthread_mutex_lock(&w_lock);
+  if ( !w_running ) {
+    pthread_mutex_unlock(&w_lock);
+    return;
+  }
+  w_stop=true;
+  pthread_cond_signal(&w_queued);
+  pthread_mutex_unlock(&w_lock);
+  pthread_join(w_thread, NULL);
+
+  pthread_mutex_lock(&w_lock);
+  w_running=false;
+  for(size_t i=0; i<w_files.size(); ++i) {
+    if ( w_files[i]==stdout ) fflush(stdout);
+    else if ( fclose(w_files[i])!=0 ) cerr << "failed to write " << w_names[i] << endl;
+  }
+  w_names.clear();
+  w_files.clear();
+  for(size_t i=0; i<w_pool.size(); ++i) delete w_pool[i];
+  w_pool.clear();
+  pthread_mutex_unlock(&w_lock);
+  return;
+}
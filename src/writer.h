@@ -0,0 +1,52 @@
+#ifndef _WRITER_H
+#define _WRITER_H
+
+using namespace std;
+#include <string>
+
+//! buffers handed to the writer thread, reused once written
+#define WRITER_BUFFERS 8
+#define WRITER_BUFFER_SIZE (1<<20)
+
+/*!
+  @abstract  output stream of fn, opened on the first call
+
+  every output file has one handle held by the writer thread for the
+  whole run, "STDOUT" is stdout. header is written when the file is
+  created. the writer thread is started by the first call and stopped at
+  exit, or by writer_close().
+
+  @return    id of the stream for writer_push()
+*/
+int writer_stream(const string& fn, const string& header);
+
+//! an empty buffer, waits while all are queued
+string* writer_buffer();
+
+//! queue buf to be written to stream, buf belongs to the writer afterwards
+void writer_push(int stream, string* buf);
+
+//! the next writer_stream(fn) appends to fn and does not write the header
+void writer_reopen(const string& fn);
+
+//! wait until everything queued is written, then flush all streams to disk
+void writer_sync();
+
+//! bytes in fn so far, -1 if fn is not open; exact only after writer_sync()
+long writer_tell(const string& fn);
+
+//! write everything queued, close all streams and stop the thread
+void writer_close();
+
+//! append v in decimal, as ostream << v does
+inline void append_int(string& s, long v)
+{
+  char tmp[24];
+  int k=24;
+  unsigned long u= v<0 ? -(unsigned long)v : v;
+  do { tmp[--k]='0'+u%10; u/=10; } while ( u>0 );
+  if ( v<0 ) tmp[--k]='-';
+  s.append(tmp+k, 24-k);
+}
+
+#endif